@@ -0,0 +1,20 @@
+precision mediump float;
+varying vec2 vTexcoord;
+uniform sampler2D s_tex;
+uniform float direction;
+
+/* mean luma of the column at vTexcoord.x, or of the row there if
+ * direction is 1 */
+void main()
+{
+   float sum = 0.0;
+
+   for (int i = 0; i < 64; i++) {
+      float t = (float(i) + 0.5) / 64.0;
+      vec2 pos = mix(vec2(vTexcoord.x, t), vec2(t, vTexcoord.x), direction);
+
+      sum += dot(texture2D(s_tex, pos).rgb, vec3(0.299, 0.587, 0.114));
+   }
+
+   gl_FragColor = vec4(sum / 64.0, 0.0, 0.0, 1.0);
+}
@@ -0,0 +1,57 @@
+#version 310 es
+precision mediump float;
+layout(local_size_x = 8, local_size_y = 8) in;
+layout(binding = 0) uniform mediump sampler2D s_ytex;
+layout(binding = 1) uniform mediump sampler2D s_uvtex;
+layout(binding = 0, rgba8) writeonly uniform mediump image2D rgb;
+layout(location = 0) uniform ivec4 rect;
+/* privacy mask texture, masked is 1.0 if it is in use, block is the
+ * pixelation block size in pixels */
+layout(binding = 5) uniform mediump sampler2D s_mask;
+layout(location = 1) uniform float masked;
+layout(location = 2) uniform int block;
+
+void main()
+{
+   float y, u, v;
+   vec2 uv;
+   float r, g, b;
+   ivec2 size = textureSize(s_ytex, 0);
+   ivec2 pos = rect.xy + ivec2(gl_GlobalInvocationID.xy);
+   ivec2 dst = ivec2(pos.x, size.y - 1 - pos.y);
+   ivec2 pos_2;
+   ivec2 cpos, cpos_2;
+
+   if (pos.x >= rect.x + rect.z || pos.y >= rect.y + rect.w)
+      return;
+
+   /* privacy masks fill with black or sample the center of their block */
+   if (masked > 0.5) {
+      float mask = texelFetch(s_mask, pos, 0).r;
+
+      if (mask > 0.75) {
+         imageStore(rgb, dst, vec4(0.0, 0.0, 0.0, 1.0));
+         return;
+      }
+      if (mask > 0.25)
+         pos = min(pos / block * block + block / 2, size - 1);
+   }
+
+   /* the lines the fragment shaders sample, clamped to the edge */
+   pos_2 = ivec2(pos.x, min(pos.y + 1, size.y - 1));
+   cpos = pos / 2;
+   cpos_2 = ivec2(cpos.x, min((pos.y + 2) / 2, size.y / 2 - 1));
+
+   y = mix(texelFetch(s_ytex, pos, 0).r, texelFetch(s_ytex, pos_2, 0).r, 0.5);
+   uv = mix(texelFetch(s_uvtex, cpos, 0).rg, texelFetch(s_uvtex, cpos_2, 0).rg,
+            0.5);
+
+   y = 1.1643 * (y - 0.0625);
+   u = uv.r - 0.5;
+   v = uv.g - 0.5;
+
+   r = y + 1.5958 * v;
+   g = y - 0.39173 * u - 0.81290 * v;
+   b = y + 2.017 * u;
+   imageStore(rgb, dst, vec4(r, g, b, 1.0));
+}
@@ -0,0 +1,22 @@
+precision mediump float;
+varying vec2 vTexcoord;
+uniform sampler2D s_tex;
+uniform sampler2D s_mask;
+uniform vec2 grid;
+uniform vec2 edge;
+
+/* the scaled frame with outlines around the cells flagged in the mask,
+ * edge is the outline width in cells */
+void main()
+{
+   vec3 rgb = texture2D(s_tex, vTexcoord).rgb;
+   vec2 cell = vTexcoord * grid;
+   vec2 inner = fract(cell);
+   float moving = texture2D(s_mask, (floor(cell) + 0.5) / grid).r;
+
+   if (moving > 0.5 &&
+       (any(lessThan(inner, edge)) || any(greaterThan(inner, 1.0 - edge))))
+      rgb = vec3(1.0, 0.25, 0.0);
+
+   gl_FragColor = vec4(rgb, 1.0);
+}
@@ -4,6 +4,11 @@ uniform sampler2D s_ytex;
 uniform sampler2D s_utex;
 uniform sampler2D s_vtex;
 uniform float line_height;
+/* privacy mask texture, masked is 1.0 if it is in use, block is the
+ * pixelation block size in texture coordinates */
+uniform sampler2D s_mask;
+uniform float masked;
+uniform vec2 block;
 
 void main()
 {
@@ -13,16 +18,27 @@ void main()
    vec2 tmpcoord;
    vec2 tmpcoord_2;
 
-   tmpcoord.x = vTexcoord.x;
-   tmpcoord.y = vTexcoord.y + line_height;
-   tmpcoord_2.x = vTexcoord.x;
-   tmpcoord_2.y = vTexcoord.y + line_height*2.0;
+   vec2 coord = vTexcoord;
+   float mask = masked > 0.5 ? texture2D(s_mask, vTexcoord).r : 0.0;
 
-   y1 = texture2D(s_ytex, vTexcoord).r;
+   /* privacy masks fill with black or sample the center of their block */
+   if (mask > 0.75) {
+      gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+      return;
+   }
+   if (mask > 0.25)
+      coord = (floor(vTexcoord / block) + 0.5) * block;
+
+   tmpcoord.x = coord.x;
+   tmpcoord.y = coord.y + line_height;
+   tmpcoord_2.x = coord.x;
+   tmpcoord_2.y = coord.y + line_height*2.0;
+
+   y1 = texture2D(s_ytex, coord).r;
    y2 = texture2D(s_ytex, tmpcoord).r;
-   u1 = texture2D(s_utex, vTexcoord).r;
+   u1 = texture2D(s_utex, coord).r;
    u2 = texture2D(s_utex, tmpcoord_2).r;
-   v1 = texture2D(s_vtex, vTexcoord).r;
+   v1 = texture2D(s_vtex, coord).r;
    v2 = texture2D(s_vtex, tmpcoord_2).r;
 
    y = mix (y1, y2, 0.5);
@@ -0,0 +1,54 @@
+precision mediump float;
+varying vec2 vTexcoord;
+uniform sampler2D s_ytex;
+uniform sampler2D s_uvtex;
+uniform float line_height;
+/* privacy mask texture, masked is 1.0 if it is in use, block is the
+ * pixelation block size in texture coordinates */
+uniform sampler2D s_mask;
+uniform float masked;
+uniform vec2 block;
+
+void main()
+{
+   float y, u, v;
+   float y1, y2;
+   vec2 uv1, uv2;
+   float r, g, b;
+   vec2 tmpcoord;
+   vec2 tmpcoord_2;
+
+   vec2 coord = vTexcoord;
+   float mask = masked > 0.5 ? texture2D(s_mask, vTexcoord).r : 0.0;
+
+   /* privacy masks fill with black or sample the center of their block */
+   if (mask > 0.75) {
+      gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+      return;
+   }
+   if (mask > 0.25)
+      coord = (floor(vTexcoord / block) + 0.5) * block;
+
+   tmpcoord.x = coord.x;
+   tmpcoord.y = coord.y + line_height;
+   tmpcoord_2.x = coord.x;
+   tmpcoord_2.y = coord.y + line_height*2.0;
+
+   y1 = texture2D(s_ytex, coord).r;
+   y2 = texture2D(s_ytex, tmpcoord).r;
+   uv1 = texture2D(s_uvtex, coord).rg;
+   uv2 = texture2D(s_uvtex, tmpcoord_2).rg;
+
+   y = mix (y1, y2, 0.5);
+   u = mix (uv1.r, uv2.r, 0.5);
+   v = mix (uv1.g, uv2.g, 0.5);
+
+   y = 1.1643 * (y - 0.0625);
+   u = u - 0.5;
+   v = v - 0.5;
+
+   r = y + 1.5958 * v;
+   g = y - 0.39173 * u - 0.81290 * v;
+   b = y + 2.017 * u;
+   gl_FragColor = vec4(r, g, b, 1.0);
+}
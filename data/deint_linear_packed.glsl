@@ -0,0 +1,80 @@
+#ifdef GL_FRAGMENT_PRECISION_HIGH
+precision highp float;
+#else
+precision mediump float;
+#endif
+varying vec2 vTexcoord;
+uniform sampler2D s_tex;
+uniform float line_height;
+/* privacy mask texture, masked is 1.0 if it is in use, block is the
+ * pixelation block size in texture coordinates */
+uniform sampler2D s_mask;
+uniform float masked;
+uniform vec2 block;
+/* visible frame size in pixels */
+uniform vec2 size;
+/* size of the packed texture in texels, the luma rows followed by the
+ * u and v planes with two chroma rows per texture row */
+uniform vec2 tex_size;
+
+vec2 luma_coord(vec2 coord)
+{
+   /* stay clear of the chroma rows below the last line */
+   return vec2(coord.x * size.x / tex_size.x,
+               min(coord.y * size.y, size.y - 0.5) / tex_size.y);
+}
+
+vec2 chroma_coord(vec2 coord, float plane)
+{
+   float cy = floor(min(coord.y, 1.0) * size.y * 0.5);
+   float row = size.y * (1.0 + plane * 0.25) + floor(cy * 0.5);
+   float col = mod(cy, 2.0) * tex_size.x * 0.5 +
+               min(coord.x * size.x * 0.5, size.x * 0.5 - 0.5);
+
+   return vec2(col / tex_size.x, (row + 0.5) / tex_size.y);
+}
+
+void main()
+{
+   float y, u, v;
+   float y1, y2, u1, u2, v1, v2;
+   float r, g, b;
+   vec2 tmpcoord;
+   vec2 tmpcoord_2;
+
+   vec2 coord = vTexcoord;
+   float mask = masked > 0.5 ? texture2D(s_mask, vTexcoord).r : 0.0;
+
+   /* privacy masks fill with black or sample the center of their block */
+   if (mask > 0.75) {
+      gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+      return;
+   }
+   if (mask > 0.25)
+      coord = (floor(vTexcoord / block) + 0.5) * block;
+
+   tmpcoord.x = coord.x;
+   tmpcoord.y = coord.y + line_height;
+   tmpcoord_2.x = coord.x;
+   tmpcoord_2.y = coord.y + line_height*2.0;
+
+   y1 = texture2D(s_tex, luma_coord(coord)).r;
+   y2 = texture2D(s_tex, luma_coord(tmpcoord)).r;
+   u1 = texture2D(s_tex, chroma_coord(coord, 0.0)).r;
+   u2 = texture2D(s_tex, chroma_coord(tmpcoord_2, 0.0)).r;
+   v1 = texture2D(s_tex, chroma_coord(coord, 1.0)).r;
+   v2 = texture2D(s_tex, chroma_coord(tmpcoord_2, 1.0)).r;
+
+   y = mix (y1, y2, 0.5);
+   u = mix (u1, u2, 0.5);
+   v = mix (v1, v2, 0.5);
+
+   y = 1.1643 * (y - 0.0625);
+   u = u - 0.5;
+   v = v - 0.5;
+
+   r = y + 1.5958 * v;
+   g = y - 0.39173 * u - 0.81290 * v;
+   b = y + 2.017 * u;
+   gl_FragColor = vec4(r, g, b, 1.0);
+}
@@ -0,0 +1,25 @@
+precision mediump float;
+varying vec2 vTexcoord;
+uniform sampler2D s_tex;
+uniform sampler2D s_history;
+uniform vec2 grid;
+
+/* mean absolute luma difference of the cell at vTexcoord from the frame
+ * before, sampled at the texel centers of the history */
+void main()
+{
+   vec3 weights = vec3(0.299, 0.587, 0.114);
+   vec2 origin = floor(vTexcoord * grid) / grid;
+   float sum = 0.0;
+
+   for (int y = 0; y < 8; y++) {
+      for (int x = 0; x < 8; x++) {
+         vec2 pos = origin + (vec2(float(x), float(y)) + 0.5) / (grid * 8.0);
+
+         sum += abs(dot(texture2D(s_tex, pos).rgb, weights) -
+                    dot(texture2D(s_history, pos).rgb, weights));
+      }
+   }
+
+   gl_FragColor = vec4(sum / 64.0, 0.0, 0.0, 1.0);
+}
@@ -0,0 +1,55 @@
+#version 310 es
+precision highp float;
+precision highp int;
+layout(local_size_x = 16, local_size_y = 16) in;
+layout(binding = 0) uniform highp sampler2D s_tex;
+
+/* histogram of the frame, then luma sum and sum of squares per group */
+layout(std430, binding = 0) buffer Reduction {
+   uint histogram[256];
+   uvec2 partial[];
+};
+
+shared uint hist[256];
+shared uint sum[256];
+shared uint sum_sq[256];
+
+void main()
+{
+   uint i = gl_LocalInvocationIndex;
+   ivec2 size = textureSize(s_tex, 0);
+   ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+   bool inside = all(lessThan(pos, size));
+   uint luma = 0u;
+   uint s;
+
+   hist[i] = 0u;
+   memoryBarrierShared();
+   barrier();
+
+   if (inside) {
+      vec3 rgb = clamp(texelFetch(s_tex, pos, 0).rgb, 0.0, 1.0);
+      luma = uint(dot(rgb, vec3(0.299, 0.587, 0.114)) * 255.0 + 0.5);
+      atomicAdd(hist[luma], 1u);
+   }
+   sum[i] = luma;
+   sum_sq[i] = luma * luma;
+   memoryBarrierShared();
+   barrier();
+
+   /* tree reduction of the tile in shared memory */
+   for (s = 128u; s > 0u; s >>= 1) {
+      if (i < s) {
+         sum[i] += sum[i + s];
+         sum_sq[i] += sum_sq[i + s];
+      }
+      memoryBarrierShared();
+      barrier();
+   }
+
+   if (hist[i] != 0u)
+      atomicAdd(histogram[i], hist[i]);
+   if (i == 0u)
+      partial[gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x] =
+         uvec2(sum[0], sum_sq[0]);
+}
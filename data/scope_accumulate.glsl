@@ -0,0 +1,59 @@
+#version 310 es
+precision highp float;
+precision highp int;
+layout(local_size_x = 16, local_size_y = 16) in;
+layout(binding = 0) uniform highp sampler2D s_tex;
+
+/* luma, red, green and blue histograms, the luma waveform by column,
+ * the vectorscope by cr row and the peak bin of each scope */
+layout(std430, binding = 0) buffer Scopes {
+   uint histogram[1024];
+   uint waveform[65536];
+   uint vectorscope[16384];
+   uint peak[3];
+};
+
+shared uint hist[1024];
+
+void main()
+{
+   uint i = gl_LocalInvocationIndex;
+   ivec2 size = textureSize(s_tex, 0);
+   ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+   uint c;
+
+   for (c = 0u; c < 4u; c++)
+      hist[c * 256u + i] = 0u;
+   memoryBarrierShared();
+   barrier();
+
+   if (all(lessThan(pos, size))) {
+      vec3 rgb = clamp(texelFetch(s_tex, pos, 0).rgb, 0.0, 1.0);
+      float y = dot(rgb, vec3(0.299, 0.587, 0.114));
+      vec2 chroma = vec2((rgb.b - y) * 0.564, (rgb.r - y) * 0.713);
+      uvec4 level = uvec4(vec4(y, rgb) * 255.0 + 0.5);
+      uvec2 vector = uvec2(clamp((chroma + 0.5) * 128.0, 0.0, 127.0));
+      uint column = uint(pos.x) * 256u / uint(size.x);
+      uint n;
+
+      atomicAdd(hist[level.x], 1u);
+      atomicAdd(hist[256u + level.y], 1u);
+      atomicAdd(hist[512u + level.z], 1u);
+      atomicAdd(hist[768u + level.w], 1u);
+
+      n = atomicAdd(waveform[column * 256u + level.x], 1u) + 1u;
+      atomicMax(peak[1], n);
+      n = atomicAdd(vectorscope[vector.y * 128u + vector.x], 1u) + 1u;
+      atomicMax(peak[2], n);
+   }
+   memoryBarrierShared();
+   barrier();
+
+   for (c = 0u; c < 4u; c++) {
+      uint count = hist[c * 256u + i];
+
+      if (count != 0u)
+         atomicMax(peak[0],
+                   atomicAdd(histogram[c * 256u + i], count) + count);
+   }
+}
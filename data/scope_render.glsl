@@ -0,0 +1,52 @@
+#version 310 es
+precision mediump float;
+precision highp int;
+layout(local_size_x = 16, local_size_y = 16) in;
+layout(binding = 0, rgba8) writeonly uniform mediump image2D histogram_image;
+layout(binding = 1, rgba8) writeonly uniform mediump image2D waveform_image;
+layout(binding = 2, rgba8) writeonly uniform mediump image2D vector_image;
+
+layout(std430, binding = 0) readonly buffer Scopes {
+   uint histogram[1024];
+   uint waveform[65536];
+   uint vectorscope[16384];
+   uint peak[3];
+};
+
+const float background = 0.1;
+
+/* trace brightness of a bin relative to the peak of its scope */
+float trace(uint n, uint top)
+{
+   return top == 0u ? 0.0 : float(n) / float(top) * (1.0 - background);
+}
+
+void main()
+{
+   ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+   uint x = uint(pos.x);
+   uint y = uint(pos.y);
+
+   /* levels run bottom up, one waveform column per x */
+   imageStore(waveform_image, pos,
+              vec4(background, background + trace(waveform[x * 256u + y],
+                                                  peak[1]),
+                   background, 1.0));
+
+   if (y < 128u) {
+      /* bars of the luma histogram in grey, rgb added on top */
+      float level = float(max(peak[0], 1u)) * (float(y) + 0.5) / 128.0;
+      float grey = float(histogram[x]) > level ? 0.8 : background;
+      vec3 rgb = vec3(float(histogram[256u + x]) > level,
+                      float(histogram[512u + x]) > level,
+                      float(histogram[768u + x]) > level) * 0.5;
+
+      imageStore(histogram_image, pos, vec4(min(vec3(grey) + rgb, 1.0), 1.0));
+   }
+
+   if (x < 128u && y < 128u)
+      imageStore(vector_image, pos,
+                 vec4(background, background +
+                      trace(vectorscope[y * 128u + x], peak[2]),
+                      background, 1.0));
+}
@@ -0,0 +1,10 @@
+precision mediump float;
+varying vec2 vTexcoord;
+uniform sampler2D s_tex;
+uniform vec4 color;
+
+/* glyph coverage from the atlas, in color */
+void main()
+{
+   gl_FragColor = vec4(color.rgb, color.a * texture2D(s_tex, vTexcoord).r);
+}
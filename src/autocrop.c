@@ -0,0 +1,309 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+#include <glib.h>
+#include <gst/gst.h>
+
+#include "gstglessink.h"
+#include "shader.h"
+#include "autocrop.h"
+
+static const gchar *crop_names[] = {
+    "crop_top", "crop_bottom", "crop_left", "crop_right"
+};
+
+void
+autocrop_init (GstGLESSink *sink)
+{
+    GstGLESAutocrop *autocrop = &sink->gl_thread.gles.autocrop;
+    gint i;
+
+    autocrop->available = FALSE;
+    autocrop->tex_width = 0;
+    autocrop->next = 0;
+    autocrop->since = 0;
+
+    if (gl_init_shader (GST_ELEMENT (sink), &autocrop->reduce,
+                        SHADER_AUTOCROP) < 0) {
+        GST_WARNING_OBJECT (sink, "Could not initialize the autocrop "
+                            "shader, borders are not detected");
+        return;
+    }
+    autocrop->tex_loc = glGetUniformLocation (autocrop->reduce.program,
+                                              "s_tex");
+    autocrop->direction_loc = glGetUniformLocation (autocrop->reduce.program,
+                                                    "direction");
+
+    glGenTextures (2, autocrop->tex);
+    glGenFramebuffers (2, autocrop->framebuffer);
+    for (i = 0; i < 2; i++) {
+        glBindTexture (GL_TEXTURE_2D, autocrop->tex[i]);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        autocrop->width[i] = 0;
+        autocrop->height[i] = 0;
+    }
+
+    autocrop->available = TRUE;
+}
+
+void
+autocrop_close (GstGLESSink *sink)
+{
+    GstGLESAutocrop *autocrop = &sink->gl_thread.gles.autocrop;
+
+    if (autocrop->available) {
+        gl_delete_shader (&autocrop->reduce);
+        glDeleteFramebuffers (2, autocrop->framebuffer);
+        glDeleteTextures (2, autocrop->tex);
+    }
+    autocrop->available = FALSE;
+
+    g_free (autocrop->lines);
+    autocrop->lines = NULL;
+}
+
+/* sizes the targets for a frame of width x height */
+static void
+autocrop_alloc (GstGLESSink *sink, gint width, gint height)
+{
+    GstGLESAutocrop *autocrop = &sink->gl_thread.gles.autocrop;
+    gint size = MAX (width, height);
+    gint i;
+
+    if (autocrop->tex_width == size)
+        return;
+
+    for (i = 0; i < 2; i++) {
+        glBindTexture (GL_TEXTURE_2D, autocrop->tex[i]);
+        glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA, size, 2, 0, GL_RGBA,
+                      GL_UNSIGNED_BYTE, NULL);
+
+        glBindFramebuffer (GL_FRAMEBUFFER, autocrop->framebuffer[i]);
+        glFramebufferTexture2D (GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                GL_TEXTURE_2D, autocrop->tex[i], 0);
+        autocrop->width[i] = 0;
+        autocrop->height[i] = 0;
+    }
+
+    g_free (autocrop->lines);
+    autocrop->lines = g_malloc ((gsize) size * 2 * 4);
+    autocrop->tex_width = size;
+    autocrop->since = 0;
+}
+
+/* counts the lines from the start, every step apart, darker than
+ * threshold */
+static guint
+autocrop_count (const guint8 *line, gint n, gint step, guint threshold)
+{
+    gint i;
+
+    for (i = 0; i < n; i++, line += step * 4) {
+        if (line[0] > threshold)
+            break;
+    }
+
+    return i;
+}
+
+/*
+ * Finds the borders in the line means read back, frame rows run bottom
+ * up. Returns FALSE for frames without a plausible picture, black ones or
+ * ones whose borders take more than 1 / AUTOCROP_MAX_DIVISOR of the frame
+ * on a side, which are rather dark scenes than bars. Borders are kept
+ * even so the chroma siting of the crop does not change.
+ */
+static gboolean
+autocrop_measure (GstGLESSink *sink, gint width, gint height, guint *crop)
+{
+    GstGLESAutocrop *autocrop = &sink->gl_thread.gles.autocrop;
+    const guint8 *columns = autocrop->lines;
+    const guint8 *rows = autocrop->lines + autocrop->tex_width * 4;
+    guint threshold = sink->autocrop_threshold;
+    gint i;
+
+    crop[0] = autocrop_count (rows + (height - 1) * 4, height, -1, threshold);
+    if (crop[0] == (guint) height)
+        return FALSE;
+
+    crop[1] = autocrop_count (rows, height, 1, threshold);
+    crop[2] = autocrop_count (columns, width, 1, threshold);
+    crop[3] = autocrop_count (columns + (width - 1) * 4, width, -1,
+                              threshold);
+
+    for (i = 0; i < 4; i++) {
+        if (crop[i] > (guint) (i < 2 ? height : width) / AUTOCROP_MAX_DIVISOR)
+            return FALSE;
+        crop[i] &= ~1;
+    }
+
+    return TRUE;
+}
+
+/* returns TRUE if no border of a differs from b beyond the tolerance */
+static gboolean
+autocrop_similar (const guint *a, const guint *b)
+{
+    gint i;
+
+    for (i = 0; i < 4; i++) {
+        if (ABS ((gint) a[i] - (gint) b[i]) > AUTOCROP_TOLERANCE)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Hysteresis: measured borders replace the crop once they have stayed
+ * within the tolerance of each other for autocrop_duration, borders that
+ * reveal more of the picture already after a quarter of it, so content
+ * coming back is not cut for long. Borders within the tolerance of the
+ * crop change nothing.
+ */
+static void
+autocrop_decide (GstGLESSink *sink, const guint *measured)
+{
+    GstGLESAutocrop *autocrop = &sink->gl_thread.gles.autocrop;
+    gint64 now = g_get_monotonic_time ();
+    gint64 hold;
+    gboolean grows = FALSE;
+    guint current[4];
+    gint i;
+
+    GST_OBJECT_LOCK (sink);
+    current[0] = sink->crop_top;
+    current[1] = sink->crop_bottom;
+    current[2] = sink->crop_left;
+    current[3] = sink->crop_right;
+    hold = (gint64) sink->autocrop_duration * G_TIME_SPAN_MILLISECOND;
+    GST_OBJECT_UNLOCK (sink);
+
+    if (autocrop_similar (measured, current)) {
+        autocrop->since = 0;
+        return;
+    }
+
+    if (!autocrop->since || !autocrop_similar (measured, autocrop->candidate)) {
+        memcpy (autocrop->candidate, measured, sizeof (autocrop->candidate));
+        autocrop->since = now;
+    }
+
+    for (i = 0; i < 4; i++)
+        grows |= autocrop->candidate[i] > current[i];
+    if (!grows)
+        hold /= 4;
+
+    if (now - autocrop->since < hold)
+        return;
+    autocrop->since = 0;
+
+    GST_INFO_OBJECT (sink, "Cropping %u %u %u %u (top bottom left right)",
+                     autocrop->candidate[0], autocrop->candidate[1],
+                     autocrop->candidate[2], autocrop->candidate[3]);
+
+    GST_OBJECT_LOCK (sink);
+    sink->crop_top = autocrop->candidate[0];
+    sink->crop_bottom = autocrop->candidate[1];
+    sink->crop_left = autocrop->candidate[2];
+    sink->crop_right = autocrop->candidate[3];
+    sink->stats.autocrop_changes++;
+    GST_OBJECT_UNLOCK (sink);
+
+    for (i = 0; i < 4; i++) {
+        if (autocrop->candidate[i] != current[i])
+            g_object_notify (G_OBJECT (sink), crop_names[i]);
+    }
+}
+
+void
+autocrop_update (GstGLESSink *sink)
+{
+    GLfloat vVertices[] =
+    {
+        -1.0f, -1.0f,
+        0.0f, 0.5f,
+
+        1.0f, -1.0f,
+        1.0f, 0.5f,
+
+        1.0f, 1.0f,
+        1.0f, 0.5f,
+
+        -1.0f, 1.0f,
+        0.0f, 0.5f,
+    };
+    GLushort indices[] = { 0, 1, 2, 0, 2, 3 };
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    GstGLESAutocrop *autocrop = &gles->autocrop;
+    gint width = GST_VIDEO_SINK_WIDTH (sink);
+    gint height = GST_VIDEO_SINK_HEIGHT (sink);
+    guint measured[4];
+    gint i = autocrop->next;
+
+    if (!sink->autocrop || !autocrop->available)
+        return;
+
+    autocrop_alloc (sink, width, height);
+
+    /* the lines of the frame before are done by now, reading them does
+     * not wait for the current frame. a size change in between makes
+     * them useless */
+    if (autocrop->width[!i] == width && autocrop->height[!i] == height) {
+        glBindFramebuffer (GL_FRAMEBUFFER, autocrop->framebuffer[!i]);
+        glReadPixels (0, 0, autocrop->tex_width, 2, GL_RGBA,
+                      GL_UNSIGNED_BYTE, autocrop->lines);
+        if (autocrop_measure (sink, width, height, measured))
+            autocrop_decide (sink, measured);
+    }
+    autocrop->width[!i] = 0;
+    autocrop->height[!i] = 0;
+
+    glBindFramebuffer (GL_FRAMEBUFFER, autocrop->framebuffer[i]);
+    glUseProgram (autocrop->reduce.program);
+    glActiveTexture (GL_TEXTURE3);
+    glBindTexture (GL_TEXTURE_2D, gles->rgb_tex.id);
+    glUniform1i (autocrop->tex_loc, 3);
+
+    /* the column means into the bottom row, the row means above */
+    glUniform1f (autocrop->direction_loc, 0.0f);
+    glViewport (0, 0, width, 1);
+    gl_draw_quad (sink, &autocrop->reduce, vVertices, indices);
+
+    glUniform1f (autocrop->direction_loc, 1.0f);
+    glViewport (0, 1, height, 1);
+    gl_draw_quad (sink, &autocrop->reduce, vVertices, indices);
+
+    autocrop->width[i] = width;
+    autocrop->height[i] = height;
+    autocrop->next = !i;
+
+    glBindFramebuffer (GL_FRAMEBUFFER, gles->framebuffer);
+}
@@ -0,0 +1,85 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef _AUTOCROP_H__
+#define _AUTOCROP_H__
+
+#include <glib.h>
+
+#include <GLES2/gl2.h>
+
+#include "shader.h"
+
+/* samples the reduction takes across each row and column */
+#define AUTOCROP_SAMPLES 64
+
+/* largest share of the frame height or width one border may crop */
+#define AUTOCROP_MAX_DIVISOR 4
+
+/* pixels a detected border may differ from the applied crop before it
+ * counts as a change */
+#define AUTOCROP_TOLERANCE 4
+
+typedef struct _GstGLESAutocrop    GstGLESAutocrop;
+
+/*
+ * Black border detection. The converted frame is reduced to the mean
+ * luma of every column and every row, drawn into the two rows of a small
+ * target and read back one frame late from alternating targets.
+ */
+struct _GstGLESAutocrop
+{
+    /* set if the reduction program linked */
+    gboolean available;
+    GstGLESShader reduce;
+    GLint tex_loc;
+    GLint direction_loc;
+
+    /* targets of max (width, height) x 2 texels, with the frame size
+     * drawn into each, 0 if there is nothing to read */
+    GLuint framebuffer[2];
+    GLuint tex[2];
+    gint tex_width;
+    gint width[2];
+    gint height[2];
+    gint next;
+    guint8 *lines;
+
+    /* crop of top, bottom, left and right waiting to be applied and the
+     * monotonic time it was first measured, 0 if none is */
+    guint candidate[4];
+    gint64 since;
+};
+
+struct _GstGLESSink;
+
+/* links the reduction in the current context */
+void
+autocrop_init (struct _GstGLESSink *sink);
+void
+autocrop_close (struct _GstGLESSink *sink);
+
+/* reduces the converted frame and applies the borders measured on the
+ * frame before once they have been stable long enough */
+void
+autocrop_update (struct _GstGLESSink *sink);
+#endif
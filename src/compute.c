@@ -0,0 +1,662 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <gst/gst.h>
+
+#include "gstglessink.h"
+#include "shader.h"
+#include "compute.h"
+
+/* work group sizes of the conversion and the reduction shaders */
+#define CONVERT_GROUP 8
+#define REDUCE_GROUP 16
+
+/* the reduction buffer holds the histogram followed by the luma sum and
+ * the sum of squares of every work group */
+#define REDUCE_HEADER (256 * sizeof (guint32))
+
+static const gchar *compute_path_names[] = {
+    "fragment", /* GST_GLES_CONVERT_FRAGMENT */
+    "compute", /* GST_GLES_CONVERT_COMPUTE */
+    "bench" /* GST_GLES_CONVERT_BENCH, alternating every frame */
+};
+
+gint
+compute_path_from_name (const gchar *name)
+{
+    guint i;
+
+    if (!name)
+        return GST_GLES_CONVERT_FRAGMENT;
+
+    for (i = 0; i < G_N_ELEMENTS (compute_path_names); i++) {
+        if (!strcmp (name, compute_path_names[i]))
+            return i;
+    }
+
+    return -1;
+}
+
+const gchar *
+compute_path_name (gint path)
+{
+    return compute_path_names[path];
+}
+
+const EGLint *
+compute_context_attribs (void)
+{
+    static const EGLint attribs[] =
+    {
+        EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+        EGL_CONTEXT_MINOR_VERSION_KHR, 1,
+        EGL_NONE
+    };
+
+    return attribs;
+}
+
+/* resolves an entry point by its extension name, or its core name */
+static void *
+compute_proc_address (const gchar *name, const gchar *suffix)
+{
+    gchar *ext_name = g_strconcat (name, suffix, NULL);
+    void *proc = (void *) eglGetProcAddress (ext_name);
+
+    g_free (ext_name);
+    if (!proc)
+        proc = (void *) eglGetProcAddress (name);
+
+    return proc;
+}
+
+/*
+ * Timer queries are core in desktop GL and come with
+ * GL_EXT_disjoint_timer_query in GLES, on either path.
+ */
+static void
+compute_init_timer (GstGLESSink *sink)
+{
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    GstGLESCompute *compute = &gles->compute;
+    const gchar *suffix = gles->desktop ? "" : "EXT";
+    gint i;
+
+    compute->timer = FALSE;
+    compute->query_next = 0;
+    compute->query_active = -1;
+    for (i = 0; i < GST_GLES_TIMER_QUERIES; i++)
+        compute->query_pass[i] = -1;
+
+    if (!gles->desktop &&
+        !gl_extension_available ("GL_EXT_disjoint_timer_query"))
+        return;
+
+    compute->gen_queries = (PFNGLGENQUERIESEXTPROC)
+        compute_proc_address ("glGenQueries", suffix);
+    compute->delete_queries = (PFNGLDELETEQUERIESEXTPROC)
+        compute_proc_address ("glDeleteQueries", suffix);
+    compute->begin_query = (PFNGLBEGINQUERYEXTPROC)
+        compute_proc_address ("glBeginQuery", suffix);
+    compute->end_query = (PFNGLENDQUERYEXTPROC)
+        compute_proc_address ("glEndQuery", suffix);
+    compute->get_query_uiv = (PFNGLGETQUERYOBJECTUIVEXTPROC)
+        compute_proc_address ("glGetQueryObjectuiv", suffix);
+    compute->get_query_ui64v = (PFNGLGETQUERYOBJECTUI64VEXTPROC)
+        compute_proc_address ("glGetQueryObjectui64v", suffix);
+
+    if (!compute->gen_queries || !compute->delete_queries ||
+        !compute->begin_query || !compute->end_query ||
+        !compute->get_query_uiv || !compute->get_query_ui64v)
+        return;
+
+    compute->gen_queries (GST_GLES_TIMER_QUERIES, compute->query);
+    compute->timer = TRUE;
+}
+
+/* the fragment reduction draws the frame onto a small grid and reads
+ * that back, alternating between two grids */
+static void
+compute_init_grid (GstGLESSink *sink)
+{
+    GstGLESCompute *compute = &sink->gl_thread.gles.compute;
+    gint i;
+
+    glGenTextures (2, compute->grid_tex);
+    glGenFramebuffers (2, compute->grid_framebuffer);
+
+    for (i = 0; i < 2; i++) {
+        glBindTexture (GL_TEXTURE_2D, compute->grid_tex[i]);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA, GST_GLES_REDUCE_GRID,
+                      GST_GLES_REDUCE_GRID, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                      NULL);
+
+        glBindFramebuffer (GL_FRAMEBUFFER, compute->grid_framebuffer[i]);
+        glFramebufferTexture2D (GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                GL_TEXTURE_2D, compute->grid_tex[i], 0);
+        compute->grid_pending[i] = FALSE;
+    }
+    glBindFramebuffer (GL_FRAMEBUFFER, 0);
+
+    compute->grid_next = 0;
+    compute->grid = g_malloc (GST_GLES_REDUCE_GRID * GST_GLES_REDUCE_GRID * 4);
+}
+
+/* returns TRUE if the current context is GLES 3.1 or later */
+static gboolean
+compute_es31 (void)
+{
+    const gchar *version = (const gchar *) glGetString (GL_VERSION);
+    gint major = 0;
+    gint minor = 0;
+
+    if (!version ||
+        sscanf (version, "OpenGL ES %d.%d", &major, &minor) != 2)
+        return FALSE;
+
+    return major > 3 || (major == 3 && minor >= 1);
+}
+
+gboolean
+compute_init (GstGLESSink *sink)
+{
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    GstGLESCompute *compute = &gles->compute;
+
+    compute->available = FALSE;
+    compute->rgba_storage = FALSE;
+    compute->bench_compute = FALSE;
+    compute->reduce_next = 0;
+    memset (compute->reduce_groups, 0, sizeof (compute->reduce_groups));
+    memset (compute->reduce_size, 0, sizeof (compute->reduce_size));
+    compute->metrics.valid = FALSE;
+
+    compute_init_timer (sink);
+    compute_init_grid (sink);
+
+    /* the scopes accumulate in compute shaders on any convert path */
+    if (sink->convert_path == GST_GLES_CONVERT_FRAGMENT && !sink->scopes)
+        return FALSE;
+
+    if (gles->desktop || !compute_es31 ()) {
+        GST_INFO_OBJECT (sink, "No GLES 3.1 context, converting with "
+                         "fragment shaders");
+        return FALSE;
+    }
+
+    compute->dispatch_compute = (PFNGLDISPATCHCOMPUTEPROC)
+        eglGetProcAddress ("glDispatchCompute");
+    compute->memory_barrier = (PFNGLMEMORYBARRIERPROC)
+        eglGetProcAddress ("glMemoryBarrier");
+    compute->bind_image_texture = (PFNGLBINDIMAGETEXTUREPROC)
+        eglGetProcAddress ("glBindImageTexture");
+    compute->bind_buffer_base = (PFNGLBINDBUFFERBASEPROC)
+        eglGetProcAddress ("glBindBufferBase");
+    compute->tex_storage_2d = (PFNGLTEXSTORAGE2DEXTPROC)
+        eglGetProcAddress ("glTexStorage2D");
+    compute->map_buffer_range = (PFNGLMAPBUFFERRANGEEXTPROC)
+        eglGetProcAddress ("glMapBufferRange");
+    compute->unmap_buffer = (PFNGLUNMAPBUFFEROESPROC)
+        eglGetProcAddress ("glUnmapBuffer");
+
+    if (!compute->dispatch_compute || !compute->memory_barrier ||
+        !compute->bind_image_texture || !compute->bind_buffer_base ||
+        !compute->tex_storage_2d || !compute->map_buffer_range ||
+        !compute->unmap_buffer) {
+        GST_WARNING_OBJECT (sink, "Missing GLES 3.1 entry points");
+        return FALSE;
+    }
+
+    if (gl_init_compute_shader (GST_ELEMENT (sink), &compute->convert,
+                                SHADER_CONVERT_COMPUTE) < 0 ||
+        gl_init_compute_shader (GST_ELEMENT (sink), &compute->convert_nv12,
+                                SHADER_CONVERT_COMPUTE_NV12) < 0 ||
+        gl_init_compute_shader (GST_ELEMENT (sink), &compute->reduce,
+                                SHADER_REDUCE_COMPUTE) < 0) {
+        GST_WARNING_OBJECT (sink, "Could not initialize the compute "
+                            "shaders, converting with fragment shaders");
+        gl_delete_shader (&compute->convert);
+        gl_delete_shader (&compute->convert_nv12);
+        gl_delete_shader (&compute->reduce);
+        return FALSE;
+    }
+
+    glGenBuffers (2, compute->reduce_buf);
+
+    GST_INFO_OBJECT (sink, "Compute path available, timer queries %s",
+                     compute->timer ? "available" : "not available");
+    compute->available = TRUE;
+    return TRUE;
+}
+
+void
+compute_close (GstGLESSink *sink)
+{
+    GstGLESCompute *compute = &sink->gl_thread.gles.compute;
+
+    if (compute->available) {
+        gl_delete_shader (&compute->convert);
+        gl_delete_shader (&compute->convert_nv12);
+        gl_delete_shader (&compute->reduce);
+        glDeleteBuffers (2, compute->reduce_buf);
+    }
+    compute->available = FALSE;
+
+    if (compute->timer) {
+        if (compute->query_active >= 0)
+            compute->end_query (GL_TIME_ELAPSED_EXT);
+        compute->delete_queries (GST_GLES_TIMER_QUERIES, compute->query);
+    }
+    compute->timer = FALSE;
+
+    glDeleteFramebuffers (2, compute->grid_framebuffer);
+    glDeleteTextures (2, compute->grid_tex);
+    memset (compute->grid_framebuffer, 0, sizeof (compute->grid_framebuffer));
+    memset (compute->grid_tex, 0, sizeof (compute->grid_tex));
+
+    g_free (compute->grid);
+    compute->grid = NULL;
+
+    g_free (compute->tiles);
+    compute->tiles = NULL;
+    compute->n_tiles = 0;
+}
+
+gboolean
+compute_alloc_rgb (GstGLESSink *sink, gint width, gint height)
+{
+    GstGLESCompute *compute = &sink->gl_thread.gles.compute;
+
+    compute->rgba_storage = FALSE;
+    if (!compute->available)
+        return FALSE;
+
+    compute->tex_storage_2d (GL_TEXTURE_2D, 1, GL_RGBA8_OES, width, height);
+    compute->rgba_storage = glGetError () == GL_NO_ERROR;
+    return compute->rgba_storage;
+}
+
+gboolean
+compute_pick (GstGLESSink *sink)
+{
+    GstGLESCompute *compute = &sink->gl_thread.gles.compute;
+
+    if (!compute->available || !compute->rgba_storage)
+        return FALSE;
+
+    if (sink->convert_path == GST_GLES_CONVERT_BENCH) {
+        compute->bench_compute = !compute->bench_compute;
+        return compute->bench_compute;
+    }
+
+    return sink->convert_path == GST_GLES_CONVERT_COMPUTE;
+}
+
+static guint
+compute_groups (gint size, gint group)
+{
+    return (size + group - 1) / group;
+}
+
+/*
+ * One invocation per output pixel, reading the planes with texelFetch
+ * the way the fragment shaders sample them and storing into the rgb
+ * texture, whose rows run bottom up.
+ */
+void
+compute_convert (GstGLESSink *sink, GstGLESSlot *slot,
+                 const GstVideoRectangle *rect)
+{
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    GstGLESCompute *compute = &gles->compute;
+    GstGLESShader *shader = slot->nv12 ? &compute->convert_nv12 :
+                                         &compute->convert;
+    gint i;
+
+    glUseProgram (shader->program);
+    privacy_bind (sink, shader);
+    for (i = 0; i < (slot->nv12 ? 2 : 3); i++) {
+        glActiveTexture (GL_TEXTURE0 + i);
+        glBindTexture (GL_TEXTURE_2D, slot->tex[i]);
+    }
+
+    /* the rectangle uniform has location 0 in both programs */
+    glUniform4i (0, rect->x, rect->y, rect->w, rect->h);
+    compute->bind_image_texture (0, gles->rgb_tex.id, 0, GL_FALSE, 0,
+                                 GL_WRITE_ONLY_OES, GL_RGBA8_OES);
+
+    compute->dispatch_compute (compute_groups (rect->w, CONVERT_GROUP),
+                               compute_groups (rect->h, CONVERT_GROUP), 1);
+
+    /* the onscreen pass samples the texture, the fragment path may draw
+     * into it next */
+    compute->memory_barrier (GL_TEXTURE_FETCH_BARRIER_BIT |
+                             GL_FRAMEBUFFER_BARRIER_BIT);
+}
+
+/* hands new luma statistics to the stats and the detection */
+static void
+compute_set_metrics (GstGLESSink *sink, GstGLESMetrics *metrics)
+{
+    metrics->valid = metrics->samples > 0;
+
+    GST_OBJECT_LOCK (sink);
+    sink->stats.luma_mean = metrics->mean;
+    sink->stats.luma_variance = metrics->variance;
+    if (metrics->has_difference)
+        sink->stats.luma_difference = metrics->difference;
+    GST_OBJECT_UNLOCK (sink);
+
+    detect_frame (sink, metrics);
+}
+
+/* returns TRUE if the tiles of the frame before can be compared with n
+ * tiles, reallocating them otherwise */
+static gboolean
+compute_tiles_comparable (GstGLESCompute *compute, guint n)
+{
+    if (compute->n_tiles == n)
+        return TRUE;
+
+    g_free (compute->tiles);
+    compute->tiles = g_new0 (gfloat, n);
+    compute->n_tiles = n;
+    return FALSE;
+}
+
+/* reads the reduction the GPU wrote into buffer i, a frame ago */
+static void
+compute_read_reduction (GstGLESSink *sink, gint i)
+{
+    GstGLESCompute *compute = &sink->gl_thread.gles.compute;
+    GstGLESMetrics *metrics = &compute->metrics;
+    gint width = GST_VIDEO_SINK_WIDTH (sink);
+    gint height = GST_VIDEO_SINK_HEIGHT (sink);
+    guint gx = compute_groups (width, REDUCE_GROUP);
+    guint groups = compute->reduce_groups[i];
+    const guint32 *data;
+    gdouble difference = 0;
+    guint64 sum = 0;
+    guint64 sum_sq = 0;
+    guint g;
+
+    compute->reduce_groups[i] = 0;
+
+    glBindBuffer (GL_SHADER_STORAGE_BUFFER, compute->reduce_buf[i]);
+    data = compute->map_buffer_range (GL_SHADER_STORAGE_BUFFER, 0,
+                                      REDUCE_HEADER + groups * 8,
+                                      GL_MAP_READ_BIT_EXT);
+    if (!data) {
+        GST_DEBUG_OBJECT (sink, "Could not map the reduction buffer");
+        return;
+    }
+
+    memcpy (metrics->histogram, data, sizeof (metrics->histogram));
+    metrics->samples = 0;
+    for (g = 0; g < 256; g++)
+        metrics->samples += data[g];
+
+    /* the frame size may have changed since the dispatch */
+    metrics->has_difference = compute_tiles_comparable (compute, groups) &&
+                               groups == gx * compute_groups (height,
+                                                              REDUCE_GROUP);
+
+    data += 256;
+    for (g = 0; g < groups; g++) {
+        gint tw = MIN (REDUCE_GROUP, width - (gint) (g % gx) * REDUCE_GROUP);
+        gint th = MIN (REDUCE_GROUP, height - (gint) (g / gx) * REDUCE_GROUP);
+        gfloat mean = tw > 0 && th > 0 ? (gfloat) data[2 * g] / (tw * th) : 0;
+
+        sum += data[2 * g];
+        sum_sq += data[2 * g + 1];
+
+        difference += ABS (mean - compute->tiles[g]);
+        compute->tiles[g] = mean;
+    }
+    compute->unmap_buffer (GL_SHADER_STORAGE_BUFFER);
+
+    if (metrics->samples) {
+        metrics->mean = (gdouble) sum / metrics->samples;
+        metrics->variance = (gdouble) sum_sq / metrics->samples -
+                            metrics->mean * metrics->mean;
+    }
+    metrics->difference = groups ? difference / groups : 0;
+    metrics->timestamp = compute->reduce_pts[i];
+    compute_set_metrics (sink, metrics);
+}
+
+/*
+ * Every work group builds the histogram of its tile in shared memory and
+ * adds it to the global one, and reduces the sums of its tile to one
+ * pair. Summing those up on the cpu avoids 64 bit atomics. The buffer
+ * written the frame before is read first, by now the GPU is done with
+ * it and the map does not stall.
+ */
+void
+compute_reduce (GstGLESSink *sink)
+{
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    GstGLESCompute *compute = &gles->compute;
+    gint width = GST_VIDEO_SINK_WIDTH (sink);
+    gint height = GST_VIDEO_SINK_HEIGHT (sink);
+    guint gx = compute_groups (width, REDUCE_GROUP);
+    guint gy = compute_groups (height, REDUCE_GROUP);
+    GLsizeiptr size = REDUCE_HEADER + (GLsizeiptr) gx * gy * 8;
+    gint i = compute->reduce_next;
+    static const guint32 zero[256];
+
+    if (compute->reduce_groups[!i])
+        compute_read_reduction (sink, !i);
+
+    glBindBuffer (GL_SHADER_STORAGE_BUFFER, compute->reduce_buf[i]);
+    if (compute->reduce_size[i] != size) {
+        glBufferData (GL_SHADER_STORAGE_BUFFER, size, NULL, GL_DYNAMIC_READ);
+        compute->reduce_size[i] = size;
+    }
+    glBufferSubData (GL_SHADER_STORAGE_BUFFER, 0, REDUCE_HEADER, zero);
+    compute->bind_buffer_base (GL_SHADER_STORAGE_BUFFER, 0,
+                               compute->reduce_buf[i]);
+
+    glUseProgram (compute->reduce.program);
+    glActiveTexture (GL_TEXTURE0);
+    glBindTexture (GL_TEXTURE_2D, gles->rgb_tex.id);
+
+    compute->dispatch_compute (gx, gy, 1);
+    compute->memory_barrier (GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    compute->reduce_groups[i] = gx * gy;
+    compute->reduce_pts[i] = sink->gl_thread.pts;
+    compute->reduce_next = !i;
+}
+
+/* finishes the fragment reduction from the grid read back */
+static void
+compute_grid_metrics (GstGLESSink *sink, GstClockTime timestamp)
+{
+    GstGLESCompute *compute = &sink->gl_thread.gles.compute;
+    GstGLESMetrics *metrics = &compute->metrics;
+    const guint8 *p = compute->grid;
+    gdouble difference = 0;
+    guint64 sum = 0;
+    guint64 sum_sq = 0;
+    guint i;
+
+    memset (metrics->histogram, 0, sizeof (metrics->histogram));
+    metrics->samples = GST_GLES_REDUCE_GRID * GST_GLES_REDUCE_GRID;
+    metrics->has_difference = compute_tiles_comparable (compute,
+                                                        metrics->samples);
+
+    /* BT.601 luma in 8 bit fixed point, every sample is a tile */
+    for (i = 0; i < metrics->samples; i++, p += 4) {
+        guint luma = (77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8;
+
+        metrics->histogram[luma]++;
+        sum += luma;
+        sum_sq += luma * luma;
+
+        difference += ABS ((gfloat) luma - compute->tiles[i]);
+        compute->tiles[i] = luma;
+    }
+
+    metrics->mean = (gdouble) sum / metrics->samples;
+    metrics->variance = (gdouble) sum_sq / metrics->samples -
+                        metrics->mean * metrics->mean;
+    metrics->difference = difference / metrics->samples;
+    metrics->timestamp = timestamp;
+    compute_set_metrics (sink, metrics);
+}
+
+void
+compute_reduce_fragment (GstGLESSink *sink)
+{
+    GLfloat vVertices[] =
+    {
+        -1.0f, -1.0f,
+        0.0f, 0.0f,
+
+        1.0f, -1.0f,
+        1.0f, 0.0f,
+
+        1.0f, 1.0f,
+        1.0f, 1.0f,
+
+        -1.0f, 1.0f,
+        0.0f, 1.0f,
+    };
+    GLushort indices[] = { 0, 1, 2, 0, 2, 3 };
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    GstGLESCompute *compute = &gles->compute;
+    gint i = compute->grid_next;
+
+    /* the grid of the frame before is done by now, reading it does not
+     * wait for the current frame */
+    if (compute->grid_pending[!i]) {
+        glBindFramebuffer (GL_FRAMEBUFFER, compute->grid_framebuffer[!i]);
+        glReadPixels (0, 0, GST_GLES_REDUCE_GRID, GST_GLES_REDUCE_GRID,
+                      GL_RGBA, GL_UNSIGNED_BYTE, compute->grid);
+        compute->grid_pending[!i] = FALSE;
+        compute_grid_metrics (sink, compute->grid_pts[!i]);
+    }
+
+    glBindFramebuffer (GL_FRAMEBUFFER, compute->grid_framebuffer[i]);
+    glViewport (0, 0, GST_GLES_REDUCE_GRID, GST_GLES_REDUCE_GRID);
+
+    glUseProgram (gles->scale.program);
+    glActiveTexture (GL_TEXTURE3);
+    glBindTexture (GL_TEXTURE_2D, gles->rgb_tex.id);
+    glUniform1i (gles->rgb_tex.loc, 3);
+    gl_draw_quad (sink, &gles->scale, vVertices, indices);
+
+    compute->grid_pending[i] = TRUE;
+    compute->grid_pts[i] = sink->gl_thread.pts;
+    compute->grid_next = !i;
+
+    glBindFramebuffer (GL_FRAMEBUFFER, gles->framebuffer);
+}
+
+/* moves the finished queries into the stats, a running average per pass */
+static void
+compute_timer_collect (GstGLESSink *sink)
+{
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    GstGLESCompute *compute = &gles->compute;
+    GLint disjoint = 0;
+    gint i;
+
+    /* a frequency change or similar makes pending results meaningless */
+    if (!gles->desktop)
+        glGetIntegerv (GL_GPU_DISJOINT_EXT, &disjoint);
+
+    for (i = 0; i < GST_GLES_TIMER_QUERIES; i++) {
+        gint pass = compute->query_pass[i];
+        GLuint available = 0;
+        GLuint64 elapsed = 0;
+
+        if (pass < 0 || i == compute->query_active)
+            continue;
+
+        compute->get_query_uiv (compute->query[i],
+                                GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+        if (!available)
+            continue;
+
+        compute->get_query_ui64v (compute->query[i], GL_QUERY_RESULT_EXT,
+                                  &elapsed);
+        compute->query_pass[i] = -1;
+        if (disjoint)
+            continue;
+
+        GST_OBJECT_LOCK (sink);
+        if (sink->stats.pass_time[pass])
+            sink->stats.pass_time[pass] =
+                    (sink->stats.pass_time[pass] * 7 + elapsed) / 8;
+        else
+            sink->stats.pass_time[pass] = elapsed;
+        GST_OBJECT_UNLOCK (sink);
+    }
+}
+
+void
+compute_timer_begin (GstGLESSink *sink, gint pass)
+{
+    GstGLESCompute *compute = &sink->gl_thread.gles.compute;
+    gint i = compute->query_next;
+
+    GST_OBJECT_LOCK (sink);
+    sink->stats.pass_frames[pass]++;
+    GST_OBJECT_UNLOCK (sink);
+
+    if (!compute->timer || compute->query_active >= 0)
+        return;
+
+    compute_timer_collect (sink);
+
+    /* all queries still in flight, leave this pass unmeasured */
+    if (compute->query_pass[i] >= 0)
+        return;
+
+    compute->begin_query (GL_TIME_ELAPSED_EXT, compute->query[i]);
+    compute->query_pass[i] = pass;
+    compute->query_active = i;
+    compute->query_next = (i + 1) % GST_GLES_TIMER_QUERIES;
+}
+
+void
+compute_timer_end (GstGLESSink *sink)
+{
+    GstGLESCompute *compute = &sink->gl_thread.gles.compute;
+
+    if (compute->query_active < 0)
+        return;
+
+    compute->end_query (GL_TIME_ELAPSED_EXT);
+    compute->query_active = -1;
+}
@@ -0,0 +1,226 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _COMPUTE_H__
+#define _COMPUTE_H__
+
+#include <glib.h>
+#include <gst/video/gstvideosink.h>
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "shader.h"
+#include "upload.h"
+
+/* GLES 3.1 tokens missing from the GLES 2.0 headers */
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_TEXTURE_FETCH_BARRIER_BIT
+#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#endif
+#ifndef GL_SHADER_IMAGE_ACCESS_BARRIER_BIT
+#define GL_SHADER_IMAGE_ACCESS_BARRIER_BIT 0x00000020
+#endif
+#ifndef GL_BUFFER_UPDATE_BARRIER_BIT
+#define GL_BUFFER_UPDATE_BARRIER_BIT 0x00000200
+#endif
+#ifndef GL_SHADER_STORAGE_BARRIER_BIT
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+#endif
+#ifndef GL_FRAMEBUFFER_BARRIER_BIT
+#define GL_FRAMEBUFFER_BARRIER_BIT 0x00000400
+#endif
+#ifndef GL_DYNAMIC_READ
+#define GL_DYNAMIC_READ 0x88E9
+#endif
+
+/* values of the convert_path property */
+#define GST_GLES_CONVERT_FRAGMENT 0
+#define GST_GLES_CONVERT_COMPUTE  1
+#define GST_GLES_CONVERT_BENCH    2
+
+/* passes the timer queries measure */
+#define GST_GLES_PASS_FRAGMENT_CONVERT 0
+#define GST_GLES_PASS_COMPUTE_CONVERT  1
+#define GST_GLES_PASS_FRAGMENT_REDUCE  2
+#define GST_GLES_PASS_COMPUTE_REDUCE   3
+#define GST_GLES_PASSES                4
+
+/* timer queries in flight, results are read a few frames late */
+#define GST_GLES_TIMER_QUERIES 8
+
+/* edge length of the grid the fragment reduction samples the frame on */
+#define GST_GLES_REDUCE_GRID 64
+
+typedef struct _GstGLESCompute     GstGLESCompute;
+typedef struct _GstGLESMetrics     GstGLESMetrics;
+
+typedef void (GL_APIENTRYP PFNGLDISPATCHCOMPUTEPROC) (GLuint x, GLuint y,
+                                                      GLuint z);
+typedef void (GL_APIENTRYP PFNGLMEMORYBARRIERPROC) (GLbitfield barriers);
+typedef void (GL_APIENTRYP PFNGLBINDIMAGETEXTUREPROC) (GLuint unit,
+        GLuint texture, GLint level, GLboolean layered, GLint layer,
+        GLenum access, GLenum format);
+typedef void (GL_APIENTRYP PFNGLBINDBUFFERBASEPROC) (GLenum target,
+        GLuint index, GLuint buffer);
+
+/* luma statistics of a converted frame, on the 0 - 255 scale */
+struct _GstGLESMetrics
+{
+    gboolean valid;
+    GstClockTime timestamp;
+    gdouble mean;
+    gdouble variance;
+    guint32 histogram[256];
+    guint64 samples;
+
+    /* mean absolute difference of the tile means from the frame before,
+     * has_difference is unset for the first frame of a size */
+    gboolean has_difference;
+    gdouble difference;
+};
+
+/*
+ * State of the GLES 3.1 compute path. The conversion and the reductions
+ * run as compute shaders where the context has them, the fragment
+ * shaders stay the fallback. Timer queries measure either path so both
+ * can be compared on the same stream.
+ */
+struct _GstGLESCompute
+{
+    /* set if the context is GLES 3.1 and the compute programs linked */
+    gboolean available;
+
+    GstGLESShader convert;
+    GstGLESShader convert_nv12;
+    GstGLESShader reduce;
+
+    /* rgb texture has immutable rgba8 storage, as image stores need */
+    gboolean rgba_storage;
+
+    /* shader storage buffers the reduction accumulates into, read back
+     * one frame after they were written, with the work groups that wrote
+     * them or 0 if there is nothing to read */
+    GLuint reduce_buf[2];
+    GLsizeiptr reduce_size[2];
+    guint reduce_groups[2];
+    GstClockTime reduce_pts[2];
+    gint reduce_next;
+
+    /* targets of the fragment reduction, read back one frame after they
+     * were drawn, and the readback */
+    GLuint grid_framebuffer[2];
+    GLuint grid_tex[2];
+    gboolean grid_pending[2];
+    GstClockTime grid_pts[2];
+    gint grid_next;
+    guint8 *grid;
+
+    /* luma means of the tiles of the last measured frame, the work group
+     * tiles of the compute reduction or the grid of the fallback */
+    gfloat *tiles;
+    guint n_tiles;
+
+    /* latest luma statistics */
+    GstGLESMetrics metrics;
+
+    /* pass of the next frame in bench mode */
+    gboolean bench_compute;
+
+    /* GL_EXT_disjoint_timer_query, the pass each query measures or -1 */
+    gboolean timer;
+    GLuint query[GST_GLES_TIMER_QUERIES];
+    gint query_pass[GST_GLES_TIMER_QUERIES];
+    gint query_next;
+    gint query_active;
+
+    PFNGLDISPATCHCOMPUTEPROC dispatch_compute;
+    PFNGLMEMORYBARRIERPROC memory_barrier;
+    PFNGLBINDIMAGETEXTUREPROC bind_image_texture;
+    PFNGLBINDBUFFERBASEPROC bind_buffer_base;
+    PFNGLTEXSTORAGE2DEXTPROC tex_storage_2d;
+    PFNGLMAPBUFFERRANGEEXTPROC map_buffer_range;
+    PFNGLUNMAPBUFFEROESPROC unmap_buffer;
+
+    PFNGLGENQUERIESEXTPROC gen_queries;
+    PFNGLDELETEQUERIESEXTPROC delete_queries;
+    PFNGLBEGINQUERYEXTPROC begin_query;
+    PFNGLENDQUERYEXTPROC end_query;
+    PFNGLGETQUERYOBJECTUIVEXTPROC get_query_uiv;
+    PFNGLGETQUERYOBJECTUI64VEXTPROC get_query_ui64v;
+};
+
+struct _GstGLESSink;
+
+/* converts between the path and its name as used by the convert_path
+ * property, returns -1 for unknown names */
+gint
+compute_path_from_name (const gchar *name);
+const gchar *
+compute_path_name (gint path);
+
+/* context attributes of a GLES 3.1 context */
+const EGLint *
+compute_context_attribs (void);
+
+/* loads the compute programs if the current context is GLES 3.1 and
+ * sets up the timer queries, which work on either path. returns TRUE if
+ * the compute path is available */
+gboolean
+compute_init (struct _GstGLESSink *sink);
+void
+compute_close (struct _GstGLESSink *sink);
+
+/* allocates the storage of the bound rgb texture, returns FALSE if
+ * glTexImage2D has to be used */
+gboolean
+compute_alloc_rgb (struct _GstGLESSink *sink, gint width, gint height);
+
+/* returns TRUE if the next frame converts and reduces on the compute
+ * path, alternating between the paths in bench mode */
+gboolean
+compute_pick (struct _GstGLESSink *sink);
+
+/* converts the rectangle of the slot into the rgb texture */
+void
+compute_convert (struct _GstGLESSink *sink, GstGLESSlot *slot,
+                 const GstVideoRectangle *rect);
+
+/* measures the luma of the rgb texture, results show up in the metrics
+ * once the GPU has finished */
+void
+compute_reduce (struct _GstGLESSink *sink);
+
+/* measures the luma of the rgb texture without compute shaders, by
+ * drawing it onto a grid that is read back with the next frame */
+void
+compute_reduce_fragment (struct _GstGLESSink *sink);
+
+/* brackets a pass with a timer query, the results feed the stats */
+void
+compute_timer_begin (struct _GstGLESSink *sink, gint pass);
+void
+compute_timer_end (struct _GstGLESSink *sink);
+#endif
@@ -0,0 +1,261 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+#include <glib.h>
+#include <gst/gst.h>
+
+#include "gstglessink.h"
+#include "shader.h"
+#include "desktop.h"
+
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+
+static const gchar *desktop_api_names[] = {
+    "gles", /* GST_GLES_API_GLES */
+    "opengl", /* GST_GLES_API_OPENGL */
+    "auto" /* GST_GLES_API_AUTO */
+};
+
+gint
+desktop_api_from_name (const gchar *name)
+{
+    guint i;
+
+    if (!name)
+        return GST_GLES_API_GLES;
+
+    for (i = 0; i < G_N_ELEMENTS (desktop_api_names); i++) {
+        if (!strcmp (name, desktop_api_names[i]))
+            return i;
+    }
+
+    return -1;
+}
+
+const gchar *
+desktop_api_name (gint api)
+{
+    return desktop_api_names[api];
+}
+
+/* checks for a name in a space separated list */
+static gboolean
+desktop_list_contains (const gchar *list, const gchar *name)
+{
+    gsize len = strlen (name);
+    const gchar *p = list;
+
+    while (list && (p = strstr (p, name))) {
+        if ((p == list || p[-1] == ' ') && (p[len] == ' ' || !p[len]))
+            return TRUE;
+        p += len;
+    }
+
+    return FALSE;
+}
+
+gboolean
+desktop_egl_available (EGLDisplay display)
+{
+    return desktop_list_contains (eglQueryString (display, EGL_CLIENT_APIS),
+                                  "OpenGL") &&
+           desktop_list_contains (eglQueryString (display, EGL_EXTENSIONS),
+                                  "EGL_KHR_create_context");
+}
+
+const EGLint *
+desktop_context_attribs (void)
+{
+    static const EGLint attribs[] =
+    {
+        EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+        EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR,
+        EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+        EGL_NONE
+    };
+
+    return attribs;
+}
+
+gint
+desktop_init (GstGLESSink *sink)
+{
+    GstGLESDesktop *desktop = &sink->gl_thread.gles.desktop_gl;
+
+    desktop->gen_vertex_arrays = (PFNGLGENVERTEXARRAYSOESPROC)
+        eglGetProcAddress ("glGenVertexArrays");
+    desktop->bind_vertex_array = (PFNGLBINDVERTEXARRAYOESPROC)
+        eglGetProcAddress ("glBindVertexArray");
+    desktop->delete_vertex_arrays = (PFNGLDELETEVERTEXARRAYSOESPROC)
+        eglGetProcAddress ("glDeleteVertexArrays");
+    desktop->map_buffer_range = (PFNGLMAPBUFFERRANGEEXTPROC)
+        eglGetProcAddress ("glMapBufferRange");
+    desktop->unmap_buffer = (PFNGLUNMAPBUFFEROESPROC)
+        eglGetProcAddress ("glUnmapBuffer");
+    desktop->tex_storage_2d = (PFNGLTEXSTORAGE2DEXTPROC)
+        eglGetProcAddress ("glTexStorage2D");
+
+    if (!desktop->gen_vertex_arrays || !desktop->bind_vertex_array ||
+        !desktop->delete_vertex_arrays || !desktop->map_buffer_range ||
+        !desktop->unmap_buffer) {
+        GST_ERROR_OBJECT (sink, "Missing OpenGL 3.3 entry points");
+        return -1;
+    }
+
+    /* texture storage is core in 4.2 only */
+    desktop->tex_storage = desktop->tex_storage_2d &&
+        gl_extension_available ("GL_ARB_texture_storage");
+    GST_DEBUG_OBJECT (sink, "Texture storage %ssupported",
+                      desktop->tex_storage ? "" : "not ");
+
+    /* one vertex array holds the attribute setup of all draws */
+    desktop->gen_vertex_arrays (1, &desktop->vao);
+    desktop->bind_vertex_array (desktop->vao);
+
+    glGenBuffers (1, &desktop->vbo);
+    glGenBuffers (1, &desktop->ibo);
+    glGenBuffers (1, &desktop->pbo);
+
+    return 0;
+}
+
+void
+desktop_close (GstGLESSink *sink)
+{
+    GstGLESDesktop *desktop = &sink->gl_thread.gles.desktop_gl;
+    const GLuint buffers[] = { desktop->vbo, desktop->ibo, desktop->pbo };
+
+    if (desktop->vao) {
+        desktop->bind_vertex_array (0);
+        desktop->delete_vertex_arrays (1, &desktop->vao);
+        glDeleteBuffers (G_N_ELEMENTS (buffers), buffers);
+    }
+
+    memset (desktop, 0, sizeof (*desktop));
+}
+
+/* replaces every occurrence of from in src */
+static gchar *
+desktop_replace (gchar *src, const gchar *from, const gchar *to)
+{
+    gchar **parts = g_strsplit (src, from, -1);
+    gchar *result = g_strjoinv (to, parts);
+
+    g_strfreev (parts);
+    g_free (src);
+    return result;
+}
+
+/*
+ * The shaders are written for GLSL ES 1.00. GLSL 3.30 core dropped
+ * attribute, varying, texture2D and gl_FragColor, which are mapped by a
+ * prefix or replaced, and only tolerates the precision statements, which
+ * are removed. Precision qualifiers on declarations have no effect there.
+ */
+gchar *
+desktop_shader_source (const gchar *src, GLenum type)
+{
+    gchar **lines = g_strsplit (src, "\n", -1);
+    GString *out = g_string_new ("#version 330 core\n");
+    gchar *body;
+    gint i;
+
+    if (type == GL_VERTEX_SHADER)
+        g_string_append (out, "#define attribute in\n"
+                              "#define varying out\n");
+    else
+        g_string_append (out, "#define varying in\n"
+                              "out vec4 frag_color;\n");
+
+    for (i = 0; lines[i]; i++) {
+        if (g_str_has_prefix (g_strchug (lines[i]), "precision "))
+            continue;
+        g_string_append (out, lines[i]);
+        g_string_append_c (out, '\n');
+    }
+    g_strfreev (lines);
+
+    body = g_string_free (out, FALSE);
+    body = desktop_replace (body, "texture2D", "texture");
+    return desktop_replace (body, "gl_FragColor", "frag_color");
+}
+
+gboolean
+desktop_stage_frame (GstGLESSink *sink, const guint8 *data, gsize size,
+                     const guint8 **base)
+{
+    GstGLESDesktop *desktop = &sink->gl_thread.gles.desktop_gl;
+    gpointer mapped;
+
+    if (!desktop->pbo)
+        return FALSE;
+
+    /* orphan the storage of the previous frame, the driver may still be
+     * copying from it */
+    glBindBuffer (GL_PIXEL_UNPACK_BUFFER, desktop->pbo);
+    glBufferData (GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+
+    mapped = desktop->map_buffer_range (GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                        GL_MAP_WRITE_BIT_EXT |
+                                        GL_MAP_INVALIDATE_BUFFER_BIT_EXT);
+    if (!mapped) {
+        glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+        return FALSE;
+    }
+
+    memcpy (mapped, data, size);
+    if (!desktop->unmap_buffer (GL_PIXEL_UNPACK_BUFFER)) {
+        /* the contents were lost, e.g. by a mode switch */
+        glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+        return FALSE;
+    }
+
+    *base = NULL;
+    return TRUE;
+}
+
+void
+desktop_unstage_frame (GstGLESSink *sink)
+{
+    glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+gboolean
+desktop_tex_storage (GstGLESSink *sink, GLenum internal_format,
+                     gint width, gint height)
+{
+    GstGLESDesktop *desktop = &sink->gl_thread.gles.desktop_gl;
+
+    if (!desktop->tex_storage)
+        return FALSE;
+
+    desktop->tex_storage_2d (GL_TEXTURE_2D, 1, internal_format, width,
+                             height);
+    return TRUE;
+}
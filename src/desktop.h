@@ -0,0 +1,107 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _DESKTOP_H__
+#define _DESKTOP_H__
+
+#include <glib.h>
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+/* values of the gl_api property */
+#define GST_GLES_API_GLES   0
+#define GST_GLES_API_OPENGL 1
+#define GST_GLES_API_AUTO   2
+
+typedef struct _GstGLESDesktop     GstGLESDesktop;
+
+/*
+ * State of the desktop OpenGL 3.3 core backend. The GLES 2.0 entry points
+ * the sink uses exist in desktop GL as well, only the objects core
+ * profiles require and the calls GLES 2.0 lacks are kept here.
+ */
+struct _GstGLESDesktop
+{
+    /* core profiles have no client side vertex arrays */
+    GLuint vao;
+    GLuint vbo;
+    GLuint ibo;
+
+    /* pixel unpack buffer frames are staged in before the upload */
+    GLuint pbo;
+
+    /* immutable textures through ARB_texture_storage */
+    gboolean tex_storage;
+
+    PFNGLGENVERTEXARRAYSOESPROC gen_vertex_arrays;
+    PFNGLBINDVERTEXARRAYOESPROC bind_vertex_array;
+    PFNGLDELETEVERTEXARRAYSOESPROC delete_vertex_arrays;
+    PFNGLTEXSTORAGE2DEXTPROC tex_storage_2d;
+    PFNGLMAPBUFFERRANGEEXTPROC map_buffer_range;
+    PFNGLUNMAPBUFFEROESPROC unmap_buffer;
+};
+
+struct _GstGLESSink;
+
+/* converts between the api and its name as used by the gl_api property,
+ * returns -1 for unknown names */
+gint
+desktop_api_from_name (const gchar *name);
+const gchar *
+desktop_api_name (gint api);
+
+/* returns TRUE if the display can create OpenGL 3.3 core contexts */
+gboolean
+desktop_egl_available (EGLDisplay display);
+
+/* context attributes of a desktop OpenGL 3.3 core context */
+const EGLint *
+desktop_context_attribs (void);
+
+/* creates the objects of the backend in the current context, returns 0
+ * on success */
+gint
+desktop_init (struct _GstGLESSink *sink);
+void
+desktop_close (struct _GstGLESSink *sink);
+
+/* turns GLSL ES 1.00 source into GLSL 3.30 core source */
+gchar *
+desktop_shader_source (const gchar *src, GLenum type);
+
+/* copies a frame into the pixel unpack buffer and leaves it bound, the
+ * planes are then addressed relative to *base. returns FALSE if the
+ * frame has to be uploaded from client memory */
+gboolean
+desktop_stage_frame (struct _GstGLESSink *sink, const guint8 *data,
+                     gsize size, const guint8 **base);
+void
+desktop_unstage_frame (struct _GstGLESSink *sink);
+
+/* allocates immutable storage for the bound texture if the driver
+ * supports it, returns FALSE if glTexImage2D has to be used */
+gboolean
+desktop_tex_storage (struct _GstGLESSink *sink, GLenum internal_format,
+                     gint width, gint height);
+#endif
@@ -0,0 +1,181 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+#include <glib.h>
+#include <gst/gst.h>
+
+#include "gstglessink.h"
+#include "detect.h"
+
+gboolean
+detect_enabled (GstGLESSink *sink)
+{
+    return sink->black_threshold > 0 || sink->freeze_threshold > 0;
+}
+
+/* moves the detector to condition once it held for hold us, returns
+ * TRUE if the state changed */
+static gboolean
+detect_debounce (GstGLESDetector *detector, gboolean condition,
+                 gint64 now, gint64 hold)
+{
+    if (condition == detector->active) {
+        detector->since = 0;
+        return FALSE;
+    }
+
+    if (!detector->since)
+        detector->since = now;
+    if (now - detector->since < hold)
+        return FALSE;
+
+    detector->active = condition;
+    detector->since = 0;
+    return TRUE;
+}
+
+static void
+detect_post_black (GstGLESSink *sink, gboolean active,
+                   GstClockTime timestamp, gdouble mean, gdouble variance)
+{
+    GST_INFO_OBJECT (sink, "Black frames %s at %" GST_TIME_FORMAT,
+                     active ? "started" : "ended",
+                     GST_TIME_ARGS (timestamp));
+
+    gst_element_post_message (GST_ELEMENT (sink),
+        gst_message_new_element (GST_OBJECT (sink),
+            gst_structure_new ("glessink-black",
+                "active", G_TYPE_BOOLEAN, active,
+                "timestamp", G_TYPE_UINT64, timestamp,
+                "luma-mean", G_TYPE_DOUBLE, mean,
+                "luma-variance", G_TYPE_DOUBLE, variance,
+                NULL)));
+}
+
+static void
+detect_post_freeze (GstGLESSink *sink, gboolean active,
+                    GstClockTime timestamp, gdouble difference)
+{
+    GST_INFO_OBJECT (sink, "Frozen frames %s at %" GST_TIME_FORMAT,
+                     active ? "started" : "ended",
+                     GST_TIME_ARGS (timestamp));
+
+    gst_element_post_message (GST_ELEMENT (sink),
+        gst_message_new_element (GST_OBJECT (sink),
+            gst_structure_new ("glessink-freeze",
+                "active", G_TYPE_BOOLEAN, active,
+                "timestamp", G_TYPE_UINT64, timestamp,
+                "difference", G_TYPE_DOUBLE, difference,
+                NULL)));
+}
+
+/*
+ * A frame is black if both its mean luma and the standard deviation of
+ * its luma stay below black_threshold, so dark scenes with detail do not
+ * count. It is frozen if the mean difference of its tile means from the
+ * frame before stays below freeze_threshold. Either state is reported
+ * once it held for detect_duration, and so is its end.
+ */
+void
+detect_frame (GstGLESSink *sink, const GstGLESMetrics *metrics)
+{
+    gint64 now = g_get_monotonic_time ();
+    gint64 hold;
+    gboolean black = FALSE;
+    gboolean freeze = FALSE;
+    gboolean black_active;
+    gboolean frozen;
+
+    if (!metrics->valid)
+        return;
+
+    GST_OBJECT_LOCK (sink);
+    hold = (gint64) sink->detect_duration * G_TIME_SPAN_MILLISECOND;
+
+    if (sink->black_threshold > 0 &&
+        detect_debounce (&sink->detect.black,
+                         metrics->mean < sink->black_threshold &&
+                         sqrt (MAX (metrics->variance, 0)) <
+                         sink->black_threshold, now, hold)) {
+        black = TRUE;
+        if (sink->detect.black.active)
+            sink->stats.black_events++;
+    }
+
+    if (sink->freeze_threshold > 0 && metrics->has_difference &&
+        detect_debounce (&sink->detect.freeze,
+                         metrics->difference < sink->freeze_threshold,
+                         now, hold)) {
+        freeze = TRUE;
+        if (sink->detect.freeze.active)
+            sink->stats.freeze_events++;
+    }
+
+    black_active = sink->stats.black = sink->detect.black.active;
+    frozen = sink->stats.frozen = sink->detect.freeze.active;
+    GST_OBJECT_UNLOCK (sink);
+
+    if (black)
+        detect_post_black (sink, black_active, metrics->timestamp,
+                           metrics->mean, metrics->variance);
+    if (freeze)
+        detect_post_freeze (sink, frozen, metrics->timestamp,
+                            metrics->difference);
+}
+
+/* repeated pictures are not converted again, they count as frozen */
+void
+detect_unchanged (GstGLESSink *sink, GstClockTime timestamp)
+{
+    gint64 now = g_get_monotonic_time ();
+    gboolean freeze = FALSE;
+
+    if (sink->freeze_threshold <= 0)
+        return;
+
+    GST_OBJECT_LOCK (sink);
+    if (detect_debounce (&sink->detect.freeze, TRUE, now,
+                         (gint64) sink->detect_duration *
+                         G_TIME_SPAN_MILLISECOND)) {
+        freeze = TRUE;
+        sink->stats.freeze_events++;
+    }
+    sink->stats.frozen = sink->detect.freeze.active;
+    GST_OBJECT_UNLOCK (sink);
+
+    if (freeze)
+        detect_post_freeze (sink, TRUE, timestamp, 0);
+}
+
+void
+detect_reset (GstGLESSink *sink)
+{
+    GST_OBJECT_LOCK (sink);
+    memset (&sink->detect, 0, sizeof (sink->detect));
+    GST_OBJECT_UNLOCK (sink);
+}
@@ -0,0 +1,70 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef _DETECT_H__
+#define _DETECT_H__
+
+#include <glib.h>
+#include <gst/gst.h>
+
+typedef struct _GstGLESDetector    GstGLESDetector;
+typedef struct _GstGLESDetect      GstGLESDetect;
+
+/* debounced state of one condition */
+struct _GstGLESDetector
+{
+    /* state last reported */
+    gboolean active;
+
+    /* monotonic time since which the condition contradicts the reported
+     * state, 0 while it agrees */
+    gint64 since;
+};
+
+/* black and frozen frame detection, protected by the object lock */
+struct _GstGLESDetect
+{
+    GstGLESDetector black;
+    GstGLESDetector freeze;
+};
+
+struct _GstGLESSink;
+struct _GstGLESMetrics;
+
+/* returns TRUE if a threshold is set and the frames have to be measured */
+gboolean
+detect_enabled (struct _GstGLESSink *sink);
+
+/* feeds the metrics of a measured frame to the detection and posts the
+ * changes that have lasted long enough */
+void
+detect_frame (struct _GstGLESSink *sink,
+              const struct _GstGLESMetrics *metrics);
+
+/* feeds a frame identical to the one before, which is not measured */
+void
+detect_unchanged (struct _GstGLESSink *sink, GstClockTime timestamp);
+
+/* forgets the reported states, e.g. when streaming starts */
+void
+detect_reset (struct _GstGLESSink *sink);
+#endif
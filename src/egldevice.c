@@ -0,0 +1,208 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <gst/gst.h>
+
+#include "gstglessink.h"
+#include "egldevice.h"
+
+/* most devices looked at */
+#define DEVICE_MAX 16
+
+/* checks for an extension in a space separated list */
+static gboolean
+device_has_extension (const gchar *extensions, const gchar *name)
+{
+    gsize len = strlen (name);
+    const gchar *p = extensions;
+
+    while (extensions && (p = strstr (p, name))) {
+        if ((p == extensions || p[-1] == ' ') && (p[len] == ' ' || !p[len]))
+            return TRUE;
+        p += len;
+    }
+
+    return FALSE;
+}
+
+/* extensions not tied to a display */
+static const gchar *
+device_client_extensions (void)
+{
+    return eglQueryString (EGL_NO_DISPLAY, EGL_EXTENSIONS);
+}
+
+gboolean
+device_explicit_available (void)
+{
+    const gchar *extensions = device_client_extensions ();
+
+    return device_has_extension (extensions, "EGL_EXT_explicit_device") &&
+           device_has_extension (extensions, "EGL_EXT_platform_x11");
+}
+
+/* DRM device or render node file of a device, NULL if it has none */
+static const gchar *
+device_file (EGLDeviceEXT device, EGLint name, const gchar *extension)
+{
+    PFNEGLQUERYDEVICESTRINGEXTPROC query_device_string =
+        (PFNEGLQUERYDEVICESTRINGEXTPROC)
+        eglGetProcAddress ("eglQueryDeviceStringEXT");
+
+    if (!query_device_string ||
+        !device_has_extension (query_device_string (device, EGL_EXTENSIONS),
+                               extension))
+        return NULL;
+
+    return query_device_string (device, name);
+}
+
+static gboolean
+device_is_software (EGLDeviceEXT device)
+{
+    PFNEGLQUERYDEVICESTRINGEXTPROC query_device_string =
+        (PFNEGLQUERYDEVICESTRINGEXTPROC)
+        eglGetProcAddress ("eglQueryDeviceStringEXT");
+
+    return query_device_string &&
+           device_has_extension (query_device_string (device, EGL_EXTENSIONS),
+                                 "EGL_MESA_device_software");
+}
+
+static gboolean
+device_matches (EGLDeviceEXT device, gint index, const gchar *name)
+{
+    const gchar *file;
+    gchar *end;
+    glong n;
+
+    if (!strcmp (name, "software"))
+        return device_is_software (device);
+
+    n = strtol (name, &end, 10);
+    if (end != name && !*end)
+        return n == index;
+
+    file = device_file (device, EGL_DRM_DEVICE_FILE_EXT,
+                        "EGL_EXT_device_drm");
+    if (file && !strcmp (file, name))
+        return TRUE;
+
+    file = device_file (device, EGL_DRM_RENDER_NODE_FILE_EXT,
+                        "EGL_EXT_device_drm_render_node");
+    return file && !strcmp (file, name);
+}
+
+EGLDisplay
+device_get_display (GstGLESSink *sink, Display *x11_display,
+                    const gchar *name)
+{
+    const gchar *extensions = device_client_extensions ();
+    PFNEGLQUERYDEVICESEXTPROC query_devices;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display;
+    EGLDeviceEXT devices[DEVICE_MAX];
+    EGLint n_devices = 0;
+    EGLint i;
+
+    if (!device_has_extension (extensions, "EGL_EXT_device_enumeration") ||
+        !device_has_extension (extensions, "EGL_EXT_platform_base")) {
+        GST_ERROR_OBJECT (sink, "EGL cannot enumerate devices");
+        return EGL_NO_DISPLAY;
+    }
+
+    query_devices = (PFNEGLQUERYDEVICESEXTPROC)
+        eglGetProcAddress ("eglQueryDevicesEXT");
+    get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+        eglGetProcAddress ("eglGetPlatformDisplayEXT");
+    if (!query_devices || !get_platform_display ||
+        !query_devices (DEVICE_MAX, devices, &n_devices)) {
+        GST_ERROR_OBJECT (sink, "Could not enumerate EGL devices");
+        return EGL_NO_DISPLAY;
+    }
+
+    for (i = 0; i < n_devices; i++) {
+        if (!device_matches (devices[i], i, name))
+            continue;
+
+        if (x11_display && device_explicit_available ()) {
+            /* the device handle only fits the EGL 1.5 attribute list */
+            PFNEGLGETPLATFORMDISPLAYPROC get_platform_display_attrib =
+                (PFNEGLGETPLATFORMDISPLAYPROC)
+                eglGetProcAddress ("eglGetPlatformDisplay");
+            const EGLAttrib attribs[] = {
+                EGL_DEVICE_EXT, (EGLAttrib) devices[i],
+                EGL_NONE
+            };
+
+            if (get_platform_display_attrib)
+                return get_platform_display_attrib (EGL_PLATFORM_X11_EXT,
+                                                    x11_display, attribs);
+        }
+
+        if (!device_has_extension (extensions, "EGL_EXT_platform_device"))
+            break;
+
+        return get_platform_display (EGL_PLATFORM_DEVICE_EXT, devices[i],
+                                     NULL);
+    }
+
+    GST_ERROR_OBJECT (sink, "No usable EGL device %s among %d", name,
+                      n_devices);
+    return EGL_NO_DISPLAY;
+}
+
+gchar *
+device_describe (EGLDisplay display)
+{
+    PFNEGLQUERYDISPLAYATTRIBEXTPROC query_display_attrib;
+    EGLAttrib attrib;
+    EGLDeviceEXT device;
+    const gchar *file;
+
+    if (!device_has_extension (device_client_extensions (),
+                               "EGL_EXT_device_query"))
+        return NULL;
+
+    query_display_attrib = (PFNEGLQUERYDISPLAYATTRIBEXTPROC)
+        eglGetProcAddress ("eglQueryDisplayAttribEXT");
+    if (!query_display_attrib ||
+        !query_display_attrib (display, EGL_DEVICE_EXT, &attrib))
+        return NULL;
+
+    device = (EGLDeviceEXT) attrib;
+    if (device_is_software (device))
+        return g_strdup ("software");
+
+    file = device_file (device, EGL_DRM_RENDER_NODE_FILE_EXT,
+                        "EGL_EXT_device_drm_render_node");
+    if (!file)
+        file = device_file (device, EGL_DRM_DEVICE_FILE_EXT,
+                            "EGL_EXT_device_drm");
+
+    return g_strdup (file);
+}
@@ -0,0 +1,54 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _EGLDEVICE_H__
+#define _EGLDEVICE_H__
+
+#include <glib.h>
+
+#include <X11/Xlib.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+struct _GstGLESSink;
+
+/* returns TRUE if a device can be picked for the X11 display through
+ * EGL_EXT_explicit_device, otherwise or without an X server a selected
+ * device renders headless into a pbuffer of its own platform display */
+gboolean
+device_explicit_available (void);
+
+/*
+ * Returns the display of the device selected by name: a DRM device or
+ * render node path, "software" for a software renderer, or the index of
+ * the device in the enumeration. With EGL_EXT_explicit_device and an
+ * x11_display it is an X11 display rendering on that device, otherwise a
+ * device platform display. Returns EGL_NO_DISPLAY if there is no such device.
+ */
+EGLDisplay
+device_get_display (struct _GstGLESSink *sink, Display *x11_display,
+                    const gchar *name);
+
+/* returns a description of the device the display renders on, to be
+ * freed with g_free, or NULL if EGL cannot tell */
+gchar *
+device_describe (EGLDisplay display);
+#endif
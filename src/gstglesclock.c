@@ -0,0 +1,233 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#define GST_USE_UNSTABLE_API
+#include <gst/gst.h>
+
+#include "gstglesclock.h"
+
+GST_DEBUG_CATEGORY_EXTERN (gst_gles_sink_debug);
+#define GST_CAT_DEFAULT gst_gles_sink_debug
+
+/* PLL gains for the phase and the period error */
+#define PLL_ALPHA (1.0 / 8.0)
+#define PLL_BETA (1.0 / 64.0)
+
+/* the frame duration drives the clock when it is within 2% of the
+ * measured refresh period */
+#define FRAME_DURATION_TOLERANCE 0.02
+
+G_DEFINE_TYPE (GstGLESClock, gst_gles_clock, GST_TYPE_SYSTEM_CLOCK);
+
+static GstClockTime gst_gles_clock_get_internal_time (GstClock *clock);
+static void gst_gles_clock_finalize (GObject *object);
+
+static void
+gst_gles_clock_class_init (GstGLESClockClass *klass)
+{
+    GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+    GstClockClass *clock_class = GST_CLOCK_CLASS (klass);
+
+    gobject_class->finalize = gst_gles_clock_finalize;
+    clock_class->get_internal_time = gst_gles_clock_get_internal_time;
+}
+
+static void
+gst_gles_clock_init (GstGLESClock *clock)
+{
+    g_mutex_init (&clock->lock);
+
+    clock->frame_duration = 0;
+    clock->have_vblank = FALSE;
+    clock->locked = FALSE;
+    clock->period = 0.0;
+    clock->vblank_system = 0.0;
+    clock->vblank_time = 0;
+    clock->msc = 0;
+    clock->last_time = 0;
+
+    GST_OBJECT_FLAG_SET (clock, GST_CLOCK_FLAG_CAN_SET_MASTER);
+}
+
+static void
+gst_gles_clock_finalize (GObject *object)
+{
+    GstGLESClock *clock = GST_GLES_CLOCK (object);
+
+    g_mutex_clear (&clock->lock);
+
+    G_OBJECT_CLASS (gst_gles_clock_parent_class)->finalize (object);
+}
+
+GstClock *
+gst_gles_clock_new (const gchar *name)
+{
+    /* vblank timestamps are taken from the monotonic clock */
+    return GST_CLOCK_CAST (g_object_new (GST_TYPE_GLES_CLOCK,
+                                         "name", name,
+                                         "clock-type",
+                                         GST_CLOCK_TYPE_MONOTONIC,
+                                         NULL));
+}
+
+/* clock time that passes per vblank, must be called with the lock held */
+static gdouble
+gst_gles_clock_advance (GstGLESClock *clock)
+{
+    gdouble duration = clock->frame_duration;
+
+    if (duration > 0.0 &&
+        ABS (duration - clock->period) < clock->period *
+                                         FRAME_DURATION_TOLERANCE)
+        return duration;
+
+    return clock->period;
+}
+
+/* maps system time to clock time, must be called with the lock held */
+static GstClockTime
+gst_gles_clock_map (GstGLESClock *clock, GstClockTime system)
+{
+    gdouble diff = (gdouble) system - clock->vblank_system;
+    gdouble time;
+
+    if (clock->locked)
+        diff *= gst_gles_clock_advance (clock) / clock->period;
+
+    time = clock->vblank_time + diff;
+    if (time < 0.0)
+        return 0;
+
+    return (GstClockTime) time;
+}
+
+static GstClockTime
+gst_gles_clock_get_internal_time (GstClock *gstclock)
+{
+    GstGLESClock *clock = GST_GLES_CLOCK (gstclock);
+    GstClockTime system;
+    GstClockTime time;
+
+    system = GST_CLOCK_CLASS (gst_gles_clock_parent_class)->
+            get_internal_time (gstclock);
+
+    g_mutex_lock (&clock->lock);
+    time = gst_gles_clock_map (clock, system);
+    if (time < clock->last_time)
+        time = clock->last_time;
+    clock->last_time = time;
+    g_mutex_unlock (&clock->lock);
+
+    return time;
+}
+
+/* starts tracking again from the given vblank, must be called with the
+ * lock held */
+static void
+gst_gles_clock_anchor (GstGLESClock *clock, GstClockTime time, guint64 msc)
+{
+    clock->vblank_time = gst_gles_clock_map (clock, time);
+    clock->vblank_system = time;
+    clock->msc = msc;
+}
+
+void
+gst_gles_clock_add_vblank (GstGLESClock *clock, GstClockTime time,
+                           guint64 msc)
+{
+    gdouble predicted;
+    gdouble error;
+    gint64 n;
+
+    g_mutex_lock (&clock->lock);
+
+    if (!clock->have_vblank) {
+        gst_gles_clock_anchor (clock, time, msc);
+        clock->have_vblank = TRUE;
+        goto done;
+    }
+
+    if (time <= clock->vblank_system)
+        goto done;
+
+    if (msc && clock->msc) {
+        if (msc <= clock->msc)
+            goto done;
+        n = msc - clock->msc;
+    } else if (clock->locked) {
+        /* swap completions only, assume the closest vblank count */
+        n = (gint64) ((time - clock->vblank_system) / clock->period + 0.5);
+        if (n <= 0)
+            goto done;
+    } else {
+        n = 1;
+    }
+
+    if (!clock->locked) {
+        /* the second vblank gives the first period estimate */
+        clock->period = (time - clock->vblank_system) / n;
+        gst_gles_clock_anchor (clock, time, msc);
+        clock->locked = TRUE;
+
+        GST_DEBUG_OBJECT (clock, "Initial refresh period %.0f ns",
+                          clock->period);
+        goto done;
+    }
+
+    predicted = clock->vblank_system + n * clock->period;
+    error = time - predicted;
+
+    if (ABS (error) > clock->period / 2) {
+        /* lost track, e.g. after a mode change, restart from here */
+        gdouble period = (time - clock->vblank_system) / n;
+
+        GST_DEBUG_OBJECT (clock, "Vblank off by %.0f ns, resync", error);
+        gst_gles_clock_anchor (clock, time, msc);
+        clock->period = period;
+        goto done;
+    }
+
+    clock->vblank_time += (GstClockTime) (n * gst_gles_clock_advance (clock));
+    clock->vblank_system = predicted + PLL_ALPHA * error;
+    clock->period += PLL_BETA * error / n;
+    clock->msc = msc;
+
+    GST_LOG_OBJECT (clock, "Vblank error %.0f ns, period %.0f ns",
+                    error, clock->period);
+
+done:
+    g_mutex_unlock (&clock->lock);
+}
+
+void
+gst_gles_clock_set_frame_duration (GstGLESClock *clock,
+                                   GstClockTime duration)
+{
+    /* the rate change only affects the time since the last vblank,
+     * get_internal_time keeps the clock from going backwards */
+    g_mutex_lock (&clock->lock);
+    clock->frame_duration = duration;
+    g_mutex_unlock (&clock->lock);
+}
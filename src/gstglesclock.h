@@ -0,0 +1,92 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _GST_GLES_CLOCK_H__
+#define _GST_GLES_CLOCK_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_GLES_CLOCK \
+  (gst_gles_clock_get_type())
+#define GST_GLES_CLOCK(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_GLES_CLOCK,GstGLESClock))
+#define GST_GLES_CLOCK_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_GLES_CLOCK,GstGLESClockClass))
+#define GST_IS_GLES_CLOCK(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_GLES_CLOCK))
+
+typedef struct _GstGLESClock        GstGLESClock;
+typedef struct _GstGLESClockClass   GstGLESClockClass;
+
+/*
+ * A clock that advances by one frame duration per display refresh. The
+ * vblank times reported by the sink drive a PLL estimating the refresh
+ * period and phase in system time, so the clock follows the display
+ * instead of the system oscillator without inheriting the jitter of the
+ * individual timestamps.
+ */
+struct _GstGLESClock
+{
+    GstSystemClock clock;
+
+    GMutex lock;
+
+    /* duration of one frame of the stream, used as the clock advance per
+     * vblank when it is close enough to the measured period */
+    GstClockTime frame_duration;
+
+    /* PLL state, times are in system clock time */
+    gboolean have_vblank;
+    gboolean locked;
+    gdouble period;
+    gdouble vblank_system;
+    GstClockTime vblank_time;
+    guint64 msc;
+
+    /* keeps the clock monotonic across PLL corrections */
+    GstClockTime last_time;
+};
+
+struct _GstGLESClockClass
+{
+    GstSystemClockClass parent_class;
+};
+
+GType gst_gles_clock_get_type (void);
+
+GstClock *
+gst_gles_clock_new (const gchar *name);
+
+/* feeds the time of a vblank in system clock time, msc is the vblank
+ * counter of the display or 0 if it is not known */
+void
+gst_gles_clock_add_vblank (GstGLESClock *clock, GstClockTime time,
+                           guint64 msc);
+
+void
+gst_gles_clock_set_frame_duration (GstGLESClock *clock,
+                                   GstClockTime duration);
+
+G_END_DECLS
+
+#endif /* _GST_GLES_CLOCK_H__ */
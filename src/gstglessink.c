@@ -48,6 +48,8 @@
 
 #if GST_CHECK_VERSION(1, 0, 0)
 #include <gst/video/videooverlay.h>
+#include <gst/video/gstvideometa.h>
+#include <gst/video/gstvideopool.h>
 #else
 #include <gst/interfaces/xoverlay.h>
 #endif
@@ -58,11 +60,17 @@
 #include <GLES2/gl2ext.h>
 
 #include <X11/Xatom.h>
+#ifdef HAVE_XRANDR
+#include <X11/extensions/Xrandr.h>
+#endif
 
 #include <unistd.h>
 
 #include "gstglessink.h"
+#include "gstglesclock.h"
 #include "shader.h"
+#include "present.h"
+#include "upload.h"
 
 GST_DEBUG_CATEGORY (gst_gles_sink_debug);
 
@@ -77,9 +85,63 @@ enum _GstGLESPluginProperties
   PROP_CROP_BOTTOM,
   PROP_CROP_LEFT,
   PROP_CROP_RIGHT,
-  PROP_DROP_FIRST
+  PROP_DROP_FIRST,
+  PROP_FULLSCREEN,
+  PROP_OUTPUT,
+  PROP_STATS,
+  PROP_PROVIDE_CLOCK,
+  PROP_DIRTY_TILES,
+  PROP_UPLOAD_THREAD,
+  PROP_TEXTURE_SLOTS,
+  PROP_PACKED_UPLOAD,
+  PROP_REPACK_THREADS,
+  PROP_WATCHDOG_TIMEOUT,
+  PROP_SCHED_POLICY,
+  PROP_SCHED_PRIORITY,
+  PROP_NICE,
+  PROP_CPU_AFFINITY,
+  PROP_GL_API,
+  PROP_DEVICE,
+  PROP_CONVERT_PATH,
+  PROP_FRAME_METRICS,
+  PROP_SCOPES,
+  PROP_SCOPE_OVERLAY,
+  PROP_SCOPE_INTERVAL,
+  PROP_SCOPE_MESSAGE_INTERVAL,
+  PROP_BLACK_THRESHOLD,
+  PROP_FREEZE_THRESHOLD,
+  PROP_DETECT_DURATION,
+  PROP_AUTOCROP,
+  PROP_AUTOCROP_THRESHOLD,
+  PROP_AUTOCROP_DURATION,
+  PROP_MOTION_THRESHOLD,
+  PROP_MOTION_GRID,
+  PROP_MOTION_ZONES,
+  PROP_MOTION_AREA,
+  PROP_MOTION_HOLD,
+  PROP_MOTION_OUTLINE,
+  PROP_PRIVACY_MASKS,
+  PROP_PRIVACY_BLOCK,
+  PROP_TEXT,
+  PROP_TEXT_FONT,
+  PROP_TEXT_SCALE,
+  PROP_TEXT_POSITION,
+  PROP_REPLAY_FRAMES,
+  PROP_REPLAY_DIVISOR,
+  PROP_REPLAY_BUDGET
+};
+
+enum
+{
+  SIGNAL_REPLAY_FREEZE,
+  SIGNAL_REPLAY_STEP_BACK,
+  SIGNAL_REPLAY_STEP_FORWARD,
+  SIGNAL_REPLAY_LIVE,
+  LAST_SIGNAL
 };
 
+static guint gst_gles_sink_signals[LAST_SIGNAL] = { 0 };
+
 #if GST_CHECK_VERSION(1, 0, 0)
 static void
 gst_gles_video_overlay_init (GstVideoOverlayInterface * iface);
@@ -99,31 +161,78 @@ static void gst_gles_sink_get_property (GObject * object, guint prop_id,
 
 static gboolean gst_gles_sink_start (GstBaseSink * basesink);
 static gboolean gst_gles_sink_stop (GstBaseSink * basesink);
+static gboolean gst_gles_sink_unlock (GstBaseSink * basesink);
+static gboolean gst_gles_sink_unlock_stop (GstBaseSink * basesink);
 static gboolean gst_gles_sink_set_caps (GstBaseSink * basesink,
                                           GstCaps * caps);
+#if GST_CHECK_VERSION(1, 0, 0)
+static gboolean gst_gles_sink_propose_allocation (GstBaseSink * basesink,
+                                                  GstQuery * query);
+#endif
 static GstFlowReturn gst_gles_sink_render (GstBaseSink * basesink,
                                              GstBuffer * buf);
 static GstFlowReturn gst_gles_sink_preroll (GstBaseSink * basesink,
                                               GstBuffer * buf);
 static void gst_gles_sink_finalize (GObject *gobject);
+static GstClock *gst_gles_sink_provide_clock (GstElement *element);
 static gint setup_gl_context (GstGLESSink *sink);
+static gint gl_context_init (GstGLESSink *sink);
 static gpointer gl_thread_proc (gpointer data);
 
 #define WxH ", width = (int) [ 16, 4096 ], height = (int) [ 16, 4096 ]"
 
+/* texture sets uploads rotate through by default */
+#define DEFAULT_TEXTURE_SLOTS 3
+#define DEFAULT_SCHED_PRIORITY 10
+
+/* ms a black or frozen picture has to last before it is reported */
+#define DEFAULT_DETECT_DURATION 1000
+
+/* luma below which a border line counts as black, and ms a border has to
+ * last before the crop follows it */
+#define DEFAULT_AUTOCROP_THRESHOLD 16
+#define DEFAULT_AUTOCROP_DURATION 2000
+
+/* motion grid size, percentage of a zone that has to move and ms motion
+ * has to pause before it is reported as stopped */
+#define DEFAULT_MOTION_COLUMNS 16
+#define DEFAULT_MOTION_ROWS 9
+#define DEFAULT_MOTION_AREA 5
+#define DEFAULT_MOTION_HOLD 1000
+
+/* edge in pixels of the blocks privacy masks pixelate */
+#define DEFAULT_PRIVACY_BLOCK 16
+
+/* X core font and pixel scale of the text burn-in */
+#define DEFAULT_TEXT_FONT "fixed"
+#define DEFAULT_TEXT_SCALE 2
+
+/* downscale of the replay frames and MB of texture memory they may take */
+#define DEFAULT_REPLAY_DIVISOR 2
+#define DEFAULT_REPLAY_BUDGET 64
+
+/* assumed refresh interval until it has been measured */
+#define DEFAULT_REFRESH_INTERVAL (GST_SECOND / 60)
+
+#if GST_CHECK_VERSION(1, 0, 0)
+#define GST_GLES_FLOW_FLUSHING GST_FLOW_FLUSHING
+#else
+#define GST_GLES_FLOW_FLUSHING GST_FLOW_WRONG_STATE
+#endif
+
 #if GST_CHECK_VERSION(1, 0, 0)
 static GstStaticPadTemplate gles_sink_factory =
         GST_STATIC_PAD_TEMPLATE ("sink",
                                  GST_PAD_SINK,
                                  GST_PAD_ALWAYS,
-                                 GST_STATIC_CAPS ( GST_VIDEO_CAPS_MAKE("I420")
+                                 GST_STATIC_CAPS ( GST_VIDEO_CAPS_MAKE("{ I420, NV12 }")
                                                    WxH) );
 #else
 static GstStaticPadTemplate gles_sink_factory =
         GST_STATIC_PAD_TEMPLATE ("sink",
                                  GST_PAD_SINK,
                                  GST_PAD_ALWAYS,
-                                 GST_STATIC_CAPS ( GST_VIDEO_CAPS_YUV("I420")
+                                 GST_STATIC_CAPS ( GST_VIDEO_CAPS_YUV("{ I420, NV12 }")
                                                    WxH) );
 #endif
 
@@ -155,9 +264,12 @@ gl_gen_framebuffer(GstGLESSink *sink)
     if (!gles->rgb_tex.id)
         GST_ERROR_OBJECT (sink, "Could not create RGB texture");
 
-    glTexImage2D (GL_TEXTURE_2D, 0, GL_RGB, GST_VIDEO_SINK_WIDTH (sink),
-                  GST_VIDEO_SINK_HEIGHT (sink), 0, GL_RGB,
-                  GL_UNSIGNED_BYTE, NULL);
+    /* compute shaders store into it as an image */
+    if (!compute_alloc_rgb (sink, GST_VIDEO_SINK_WIDTH (sink),
+                            GST_VIDEO_SINK_HEIGHT (sink)))
+        glTexImage2D (GL_TEXTURE_2D, 0, GL_RGB, GST_VIDEO_SINK_WIDTH (sink),
+                      GST_VIDEO_SINK_HEIGHT (sink), 0, GL_RGB,
+                      GL_UNSIGNED_BYTE, NULL);
 
     glBindFramebuffer (GL_FRAMEBUFFER, gles->framebuffer);
     glFramebufferTexture2D (GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
@@ -167,66 +279,135 @@ gl_gen_framebuffer(GstGLESSink *sink)
 static void
 gl_init_textures (GstGLESSink *sink)
 {
-    sink->gl_thread.gles.y_tex.id = gl_create_texture(GL_NEAREST);
-    sink->gl_thread.gles.u_tex.id = gl_create_texture(GL_NEAREST);
-    sink->gl_thread.gles.v_tex.id = gl_create_texture(GL_NEAREST);
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    gint i, j;
+
+    for (i = 0; i < gles->n_slots; i++) {
+        GstGLESSlot *slot = &gles->slots[i];
+
+        for (j = 0; j < 3; j++)
+            slot->tex[j] = gl_create_texture(GL_NEAREST);
+        slot->width = 0;
+        slot->height = 0;
+        slot->fence = EGL_NO_SYNC_KHR;
+        slot->state = SLOT_FREE;
+        slot->packed = FALSE;
+    }
 }
 
-static void
-gl_load_texture (GstGLESSink *sink, GstBuffer *buf)
+/* binds the plane textures of a set to the samplers of the conversion
+ * and returns the conversion program to use */
+static GstGLESShader *
+gl_bind_slot (GstGLESSink *sink, GstGLESSlot *slot)
 {
-#if GST_CHECK_VERSION(1, 0, 0)
-    GstMapInfo bufmap;
-    guint8 *data;
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    gint i;
+
+    if (slot->packed) {
+        glUseProgram (gles->deinterlace_packed.program);
+        glActiveTexture (GL_TEXTURE0);
+        glBindTexture (GL_TEXTURE_2D, slot->tex[0]);
+        glUniform1i (gles->packed_tex_loc, 0);
+        glUniform2f (gles->packed_size_loc, slot->width, slot->height);
+        glUniform2f (gles->packed_tex_size_loc, slot->packed_width,
+                     slot->height * 3 / 2);
+        return &gles->deinterlace_packed;
+    }
 
-    if (G_UNLIKELY(!gst_buffer_map (buf, &bufmap, GST_MAP_READ))) {
-	GST_WARNING_OBJECT (sink, "%s: Failed to map buffer data", __func__);
-	return;
+    if (slot->nv12) {
+        glUseProgram (gles->deinterlace_nv12.program);
+        for (i = 0; i < 2; i++) {
+            glActiveTexture (GL_TEXTURE0 + i);
+            glBindTexture (GL_TEXTURE_2D, slot->tex[i]);
+            glUniform1i (gles->nv12_loc[i], i);
+        }
+        return &gles->deinterlace_nv12;
     }
 
-    data = bufmap.data;
-#else
-    guint8 *data = GST_BUFFER_DATA (buf);
-#endif
+    glUseProgram (gles->deinterlace.program);
+    for (i = 0; i < 3; i++) {
+        glActiveTexture (GL_TEXTURE0 + i);
+        glBindTexture (GL_TEXTURE_2D, slot->tex[i]);
+        glUniform1i (gles->plane_loc[i], i);
+    }
+    return &gles->deinterlace;
+}
 
+/*
+ * Draws quads from interleaved position and texture coordinates with
+ * the attributes of shader, four vertices and six indices per quad. Core
+ * desktop contexts have no client side arrays, there the vertices and
+ * indices go through buffer objects. */
+void
+gl_draw_quads (GstGLESSink *sink, GstGLESShader *shader,
+               const GLfloat *vertices, const GLushort *indices,
+               gint n_quads)
+{
     GstGLESContext *gles = &sink->gl_thread.gles;
-    /* y component */
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture (GL_TEXTURE_2D, gles->y_tex.id);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, GST_VIDEO_SINK_WIDTH (sink),
-                 GST_VIDEO_SINK_HEIGHT (sink), 0, GL_LUMINANCE,
-                 GL_UNSIGNED_BYTE, data);
-    glUniform1i (gles->y_tex.loc, 0);
-
-    /* u component */
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture (GL_TEXTURE_2D, gles->u_tex.id);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE,
-                 GST_VIDEO_SINK_WIDTH (sink)/2,
-                 GST_VIDEO_SINK_HEIGHT (sink)/2, 0, GL_LUMINANCE,
-                 GL_UNSIGNED_BYTE, data +
-                 GST_VIDEO_SINK_WIDTH (sink) * GST_VIDEO_SINK_HEIGHT (sink));
-    glUniform1i (gles->u_tex.loc, 1);
-
-    /* v component */
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture (GL_TEXTURE_2D, gles->v_tex.id);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE,
-                 GST_VIDEO_SINK_WIDTH (sink)/2,
-                 GST_VIDEO_SINK_HEIGHT (sink)/2, 0, GL_LUMINANCE,
-                 GL_UNSIGNED_BYTE, data +
-                 GST_VIDEO_SINK_WIDTH (sink) * GST_VIDEO_SINK_HEIGHT (sink) +
-                 GST_VIDEO_SINK_WIDTH (sink)/2 *
-                 GST_VIDEO_SINK_HEIGHT (sink)/2);
-    glUniform1i (gles->v_tex.loc, 2);
 
-#if GST_CHECK_VERSION(1, 0, 0)
-    gst_buffer_unmap(buf, &bufmap);
-#endif
+    if (gles->desktop) {
+        glBindBuffer (GL_ARRAY_BUFFER, gles->desktop_gl.vbo);
+        glBufferData (GL_ARRAY_BUFFER, n_quads * 16 * sizeof (GLfloat),
+                      vertices, GL_STREAM_DRAW);
+        glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, gles->desktop_gl.ibo);
+        glBufferData (GL_ELEMENT_ARRAY_BUFFER,
+                      n_quads * 6 * sizeof (GLushort), indices,
+                      GL_STREAM_DRAW);
+        vertices = NULL;
+        indices = NULL;
+    }
+
+    glVertexAttribPointer (shader->position_loc, 2, GL_FLOAT, GL_FALSE,
+                           4 * sizeof (GLfloat), vertices);
+    glVertexAttribPointer (shader->texcoord_loc, 2, GL_FLOAT, GL_FALSE,
+                           4 * sizeof (GLfloat), vertices + 2);
+
+    glEnableVertexAttribArray (shader->position_loc);
+    glEnableVertexAttribArray (shader->texcoord_loc);
+
+    glDrawElements (GL_TRIANGLES, n_quads * 6, GL_UNSIGNED_SHORT, indices);
+}
+
+void
+gl_draw_quad (GstGLESSink *sink, GstGLESShader *shader,
+              const GLfloat *vertices, const GLushort *indices)
+{
+    gl_draw_quads (sink, shader, vertices, indices, 1);
+}
+
+/*
+ * Measures the luma of the converted frame, with a compute reduction or
+ * by drawing the frame onto a small grid and reading that back.
+ */
+static void
+gl_draw_reduce (GstGLESSink *sink, gboolean use_compute)
+{
+    if (use_compute) {
+        compute_timer_begin (sink, GST_GLES_PASS_COMPUTE_REDUCE);
+        compute_reduce (sink);
+    } else {
+        compute_timer_begin (sink, GST_GLES_PASS_FRAGMENT_REDUCE);
+        compute_reduce_fragment (sink);
+    }
+    compute_timer_end (sink);
+}
+
+/* runs the enabled analysis of the converted frame and keeps it for
+ * replay */
+static void
+gl_draw_analysis (GstGLESSink *sink, gboolean use_compute)
+{
+    if (sink->frame_metrics || detect_enabled (sink))
+        gl_draw_reduce (sink, use_compute);
+
+    scopes_update (sink);
+    autocrop_update (sink);
+    motion_update (sink);
+    replay_record (sink);
 }
 
 static void
-gl_draw_fbo (GstGLESSink *sink, GstBuffer *buf)
+gl_draw_fbo (GstGLESSink *sink, GstGLESSlot *slot, GstBuffer *buf)
 {
     GLfloat vVertices[] =
     {
@@ -244,33 +425,95 @@ gl_draw_fbo (GstGLESSink *sink, GstBuffer *buf)
     };
     GLushort indices[] = { 0, 1, 2, 0, 2, 3 };
     GstGLESContext *gles = &sink->gl_thread.gles;
+    gint height = GST_VIDEO_SINK_HEIGHT (sink);
+    GstGLESShader *shader;
+    gboolean use_compute;
+    gboolean unmasked;
+    gboolean scissor;
 
     glBindFramebuffer (GL_FRAMEBUFFER, gles->framebuffer);
-    glUseProgram (gles->deinterlace.program);
 
-    glViewport(0, 0, GST_VIDEO_SINK_WIDTH (sink),
-               GST_VIDEO_SINK_HEIGHT (sink));
+    /* convert the whole frame unless the upload narrows it down */
+    gles->dirty.x = 0;
+    gles->dirty.y = 0;
+    gles->dirty.w = GST_VIDEO_SINK_WIDTH (sink);
+    gles->dirty.h = height;
 
-    glClear (GL_COLOR_BUFFER_BIT);
+    if (buf) {
+        gl_watch_stage (sink, &sink->gl_thread.watch, GL_STAGE_UPLOAD);
+        gl_load_texture (sink, slot, buf);
+    }
+    gl_watch_stage (sink, &sink->gl_thread.watch, GL_STAGE_CONVERT);
+
+    /* changed masks have to be applied to the whole frame */
+    if (privacy_update (sink)) {
+        gles->dirty.x = 0;
+        gles->dirty.y = 0;
+        gles->dirty.w = GST_VIDEO_SINK_WIDTH (sink);
+        gles->dirty.h = height;
+    }
+
+    /* nothing changed, the framebuffer still holds the last frame,
+     * which counts as unchanged like a duplicate buffer */
+    if (!gles->dirty.w || !gles->dirty.h) {
+        detect_unchanged (sink, sink->gl_thread.pts);
+        motion_unchanged (sink, sink->gl_thread.pts);
+        return;
+    }
+
+    /* the packed layout only has a fragment conversion */
+    use_compute = compute_pick (sink);
+    if (use_compute && !slot->packed) {
+        GstVideoRectangle rect = gles->dirty;
 
-    glVertexAttribPointer (gles->deinterlace.position_loc, 2,
-                           GL_FLOAT, GL_FALSE, 4 * sizeof (GLfloat),
-                           vVertices);
+        /* the deinterlacer reads up to two lines below each output
+         * line, as in the scissor below */
+        rect.y = MAX (gles->dirty.y - 2, 0);
+        rect.h = gles->dirty.y + gles->dirty.h - rect.y;
 
-    glVertexAttribPointer (gles->deinterlace.texcoord_loc, 2,
-                           GL_FLOAT, GL_FALSE, 4 * sizeof (GLfloat),
-                           &vVertices[2]);
+        compute_timer_begin (sink, GST_GLES_PASS_COMPUTE_CONVERT);
+        compute_convert (sink, slot, &rect);
+        compute_timer_end (sink);
 
-    glEnableVertexAttribArray (gles->deinterlace.position_loc);
-    glEnableVertexAttribArray (gles->deinterlace.texcoord_loc);
+        gl_draw_analysis (sink, TRUE);
+        return;
+    }
+
+    compute_timer_begin (sink, GST_GLES_PASS_FRAGMENT_CONVERT);
+    shader = gl_bind_slot (sink, slot);
+    unmasked = !privacy_bind (sink, shader);
+
+    glViewport(0, 0, GST_VIDEO_SINK_WIDTH (sink), height);
+
+    /* restrict the conversion to the changed part of the frame, the
+     * deinterlacer reads up to two lines below each output line, and
+     * frame rows run top down while the framebuffer runs bottom up */
+    scissor = !unmasked && (gles->dirty.w != GST_VIDEO_SINK_WIDTH (sink) ||
+                            gles->dirty.h != height);
+    if (scissor) {
+        gint y0 = MAX (gles->dirty.y - 2, 0);
+        gint y1 = gles->dirty.y + gles->dirty.h;
+
+        glEnable (GL_SCISSOR_TEST);
+        glScissor (gles->dirty.x, height - y1, gles->dirty.w, y1 - y0);
+    }
+
+    glClear (GL_COLOR_BUFFER_BIT);
 
-    gl_load_texture(sink, buf);
     GLint line_height_loc =
-            glGetUniformLocation(gles->deinterlace.program,
+            glGetUniformLocation(shader->program,
                                  "line_height");
     glUniform1f(line_height_loc, 1.0/sink->video_height);
 
-    glDrawElements (GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, indices);
+    /* a frame the masks cannot be applied to stays black */
+    if (!unmasked)
+        gl_draw_quad (sink, shader, vVertices, indices);
+
+    if (scissor)
+        glDisable (GL_SCISSOR_TEST);
+    compute_timer_end (sink);
+
+    gl_draw_analysis (sink, use_compute);
 }
 
 void
@@ -297,6 +540,9 @@ gl_draw_onscreen (GstGLESSink *sink)
     GstVideoRectangle result;
 
     GstGLESContext *gles = &sink->gl_thread.gles;
+    GstGLESShader *shader;
+    GLuint replay_tex;
+    gint64 submit_time;
 
     /* add cropping to texture coordinates */
     float crop_left = (float)sink->crop_left / sink->video_width;
@@ -304,6 +550,8 @@ gl_draw_onscreen (GstGLESSink *sink)
     float crop_top = (float)sink->crop_top / sink->video_height;
     float crop_bottom = (float)sink->crop_bottom / sink->video_height;
 
+    gl_watch_stage (sink, &sink->gl_thread.watch, GL_STAGE_PRESENT);
+
     vVertices[2] += crop_left;
     vVertices[3] += crop_bottom;
     vVertices[6] -= crop_right;
@@ -325,45 +573,95 @@ gl_draw_onscreen (GstGLESSink *sink)
 
     gst_video_sink_center_rect(src, dst, &result, TRUE);
 
-    glUseProgram (gles->scale.program);
+    gles->drawn_width = sink->x11.width;
+    gles->drawn_height = sink->x11.height;
+    gles->drawn_crop[0] = sink->crop_top;
+    gles->drawn_crop[1] = sink->crop_bottom;
+    gles->drawn_crop[2] = sink->crop_left;
+    gles->drawn_crop[3] = sink->crop_right;
+
     glBindFramebuffer (GL_FRAMEBUFFER, 0);
 
     glViewport (result.x, result.y, result.w, result.h);
 
     glClear (GL_COLOR_BUFFER_BIT);
 
-    glVertexAttribPointer (gles->scale.position_loc, 2, GL_FLOAT,
-        GL_FALSE, 4 * sizeof (GLfloat), vVertices);
+    /* the scale pass draws the motion outlines if they are enabled,
+     * replayed frames are shown without them */
+    replay_tex = replay_texture (sink);
+    shader = replay_tex ? NULL : motion_outline_shader (sink, &result);
+    if (!shader) {
+        shader = &gles->scale;
+        glUseProgram (shader->program);
+        glUniform1i (gles->rgb_tex.loc, 3);
+    }
+
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture (GL_TEXTURE_2D, replay_tex ? replay_tex : gles->rgb_tex.id);
 
-    glVertexAttribPointer (gles->scale.texcoord_loc, 2, GL_FLOAT,
-        GL_FALSE, 4 * sizeof (GLfloat), &vVertices[2]);
+    gl_draw_quad (sink, shader, vVertices, indices);
 
-    glEnableVertexAttribArray (gles->scale.position_loc);
-    glEnableVertexAttribArray (gles->scale.texcoord_loc);
+    scopes_draw_overlay (sink);
+    text_draw (sink);
 
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture (GL_TEXTURE_2D, gles->rgb_tex.id);
-    glUniform1i (gles->rgb_tex.loc, 3);
+    submit_time = g_get_monotonic_time ();
+    if (!eglSwapBuffers (gles->display, gles->surface)) {
+        /* the context has to be rebuilt, whether the driver reports
+         * the loss or only fails the swap */
+        GST_WARNING_OBJECT (sink, "eglSwapBuffers failed: 0x%04x",
+                            eglGetError ());
+        gles->lost = TRUE;
+        return;
+    }
+    present_frame_submitted (sink, sink->gl_thread.pts, submit_time);
+}
+
+/* returns TRUE if the window, the crop or the replayed frame changed
+ * since the last swap */
+static gboolean
+gl_onscreen_changed (GstGLESSink *sink)
+{
+    GstGLESContext *gles = &sink->gl_thread.gles;
 
-    glDrawElements (GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, indices);
-    eglSwapBuffers (gles->display, gles->surface);
+    return gles->drawn_width != sink->x11.width ||
+           gles->drawn_height != sink->x11.height ||
+           gles->drawn_crop[0] != sink->crop_top ||
+           gles->drawn_crop[1] != sink->crop_bottom ||
+           gles->drawn_crop[2] != sink->crop_left ||
+           gles->drawn_crop[3] != sink->crop_right ||
+           replay_changed (sink);
 }
 
 /* EGL implementation */
 
 
+/*
+ * Creates the window surface and a context of the given api and makes it
+ * current, cleaning up after itself on failure. With es31 set a GLES 3.1
+ * context is created instead of a GLES 2.0 one. */
 static gint
-egl_init (GstGLESSink *sink)
+egl_create_context (GstGLESSink *sink, gboolean desktop, gboolean es31)
 {
+    GstGLESContext *gles = &sink->gl_thread.gles;
+
     const EGLint configAttribs[] =
     {
-        EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
-        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_SURFACE_TYPE, gles->headless ? EGL_PBUFFER_BIT : EGL_WINDOW_BIT,
+        EGL_RENDERABLE_TYPE, desktop ? EGL_OPENGL_BIT :
+                             es31 ? EGL_OPENGL_ES3_BIT_KHR :
+                                    EGL_OPENGL_ES2_BIT,
         EGL_DEPTH_SIZE, 16,
         EGL_NONE
     };
 
-    const EGLint contextAttribs[] =
+    const EGLint pbufferAttribs[] =
+    {
+        EGL_WIDTH, sink->x11.width,
+        EGL_HEIGHT, sink->x11.height,
+        EGL_NONE
+    };
+
+    const EGLint esContextAttribs[] =
     {
         EGL_CONTEXT_CLIENT_VERSION, 2,
         EGL_NONE
@@ -371,29 +669,16 @@ egl_init (GstGLESSink *sink)
 
     EGLConfig config;
     EGLint num_configs;
-    EGLint major;
-    EGLint minor;
 
-    GstGLESContext *gles = &sink->gl_thread.gles;
-
-    GST_DEBUG_OBJECT (sink, "egl get display");
-    gles->display = eglGetDisplay((EGLNativeDisplayType)
-                                          sink->x11.display);
-    if (gles->display == EGL_NO_DISPLAY) {
-        GST_ERROR_OBJECT(sink, "Could not get EGL display");
-        return -1;
-    }
-
-    GST_DEBUG_OBJECT (sink, "egl initialize");
-    if (!eglInitialize(gles->display, &major, &minor)) {
-        GST_ERROR_OBJECT(sink, "Could not initialize EGL context");
+    if (!eglBindAPI (desktop ? EGL_OPENGL_API : EGL_OPENGL_ES_API)) {
+        GST_ERROR_OBJECT(sink, "Could not bind the %s api",
+                         desktop ? "OpenGL" : "OpenGL ES");
         return -1;
     }
-    GST_DEBUG_OBJECT (sink, "Have EGL version: %d.%d", major, minor);
 
     GST_DEBUG_OBJECT (sink, "choose config");
     if (!eglChooseConfig(gles->display, configAttribs, &config, 1,
-                        &num_configs)) {
+                        &num_configs) || num_configs < 1) {
         GST_ERROR_OBJECT(sink, "Could not choose EGL config");
         return -1;
     }
@@ -404,18 +689,28 @@ egl_init (GstGLESSink *sink)
     }
 
     GST_DEBUG_OBJECT (sink, "create window surface");
-    gles->surface = eglCreateWindowSurface(gles->display, config,
-                                     sink->x11.window, NULL);
+    if (gles->headless)
+        gles->surface = eglCreatePbufferSurface (gles->display, config,
+                                                 pbufferAttribs);
+    else
+        gles->surface = eglCreateWindowSurface(gles->display, config,
+                                         sink->x11.window, NULL);
     if (gles->surface == EGL_NO_SURFACE) {
         GST_ERROR_OBJECT (sink, "Could not create EGL surface");
+        gles->surface = NULL;
         return -1;
     }
 
     GST_DEBUG_OBJECT (sink, "egl create context");
-    gles->context = eglCreateContext(gles->display, config,
-                                     EGL_NO_CONTEXT, contextAttribs);
+    gles->context = eglCreateContext(gles->display, config, EGL_NO_CONTEXT,
+                                     desktop ? desktop_context_attribs () :
+                                     es31 ? compute_context_attribs () :
+                                            esContextAttribs);
     if (gles->context == EGL_NO_CONTEXT) {
         GST_ERROR_OBJECT(sink, "Could not create EGL context");
+        gles->context = NULL;
+        eglDestroySurface (gles->display, gles->surface);
+        gles->surface = NULL;
         return -1;
     }
 
@@ -423,9 +718,74 @@ egl_init (GstGLESSink *sink)
     if (!eglMakeCurrent(gles->display, gles->surface,
                         gles->surface, gles->context)) {
         GST_ERROR_OBJECT(sink, "Could not set EGL context to current");
+        eglDestroyContext (gles->display, gles->context);
+        gles->context = NULL;
+        eglDestroySurface (gles->display, gles->surface);
+        gles->surface = NULL;
+        return -1;
+    }
+
+    gles->desktop = desktop;
+    gles->es31 = es31;
+    return 0;
+}
+
+static gint
+egl_init (GstGLESSink *sink)
+{
+    EGLint major;
+    EGLint minor;
+
+    GstGLESContext *gles = &sink->gl_thread.gles;
+
+    GST_DEBUG_OBJECT (sink, "egl get display");
+    if (sink->device && *sink->device)
+        gles->display = device_get_display (sink, sink->x11.display,
+                                            sink->device);
+    else
+        gles->display = eglGetDisplay((EGLNativeDisplayType)
+                                              sink->x11.display);
+    if (gles->display == EGL_NO_DISPLAY) {
+        GST_ERROR_OBJECT(sink, "Could not get EGL display");
+        return -1;
+    }
+
+    GST_DEBUG_OBJECT (sink, "egl initialize");
+    if (!eglInitialize(gles->display, &major, &minor)) {
+        GST_ERROR_OBJECT(sink, "Could not initialize EGL context");
         return -1;
     }
+    GST_DEBUG_OBJECT (sink, "Have EGL version: %d.%d", major, minor);
+
+    gles->desktop = FALSE;
+    if (sink->gl_api != GST_GLES_API_GLES) {
+        if (desktop_egl_available (gles->display) &&
+            egl_create_context (sink, TRUE, FALSE) == 0)
+            goto done;
+
+        if (sink->gl_api == GST_GLES_API_OPENGL) {
+            GST_ERROR_OBJECT (sink, "Could not create an OpenGL 3.3 core "
+                              "context");
+            return -1;
+        }
+
+        /* the probe failed, use what every driver here has */
+        GST_INFO_OBJECT (sink, "No OpenGL 3.3 core context, using "
+                         "OpenGL ES");
+    }
+
+    /* compute shaders need GLES 3.1, the fragment path keeps to 2.0 */
+    if ((sink->convert_path != GST_GLES_CONVERT_FRAGMENT || sink->scopes) &&
+        egl_create_context (sink, FALSE, TRUE) == 0)
+        goto done;
+
+    if (egl_create_context (sink, FALSE, FALSE) < 0)
+        return -1;
 
+done:
+    GST_INFO_OBJECT (sink, "Rendering with %s",
+                     gles->desktop ? "OpenGL 3.3 core" :
+                     gles->es31 ? "OpenGL ES 3.1" : "OpenGL ES 2.0");
     GST_DEBUG_OBJECT (sink, "egl init done");
 
     return 0;
@@ -536,18 +896,61 @@ egl_close(GstGLESSink *sink)
     };
 
     const GLuint textures[] = {
-        context->y_tex.id,
-        context->u_tex.id,
-        context->v_tex.id,
         context->rgb_tex.id
     };
+    gint i;
 
     if (context->initialized) {
         glDeleteFramebuffers (G_N_ELEMENTS(framebuffers), framebuffers);
         glDeleteTextures (G_N_ELEMENTS(textures), textures);
         gl_delete_shader (&context->scale);
         gl_delete_shader (&context->deinterlace);
+        if (context->packed)
+            gl_delete_shader (&context->deinterlace_packed);
+        if (context->texture_rg)
+            gl_delete_shader (&context->deinterlace_nv12);
+    }
+    context->packed = FALSE;
+    context->texture_rg = FALSE;
+
+    /* the GPU is done with the held buffers once the context is gone */
+    for (i = 0; i < GST_GLES_MAX_SLOTS; i++) {
+        GstGLESSlot *slot = &context->slots[i];
+
+        if (context->initialized)
+            glDeleteTextures (3, slot->tex);
+        memset (slot->tex, 0, sizeof (slot->tex));
+        if (slot->fence != EGL_NO_SYNC_KHR)
+            context->destroy_sync (context->display, slot->fence);
+        slot->fence = EGL_NO_SYNC_KHR;
+        gst_buffer_replace (&slot->buf, NULL);
+        slot->width = 0;
+        slot->height = 0;
+        slot->state = SLOT_FREE;
+        slot->packed = FALSE;
+        slot->nv12 = FALSE;
+    }
+
+    g_free (context->shadow);
+    context->shadow = NULL;
+    context->shadow_size = 0;
+
+    repack_clear (&context->repack);
+
+    if (context->context) {
+        replay_close (sink);
+        text_close (sink);
+        privacy_close (sink);
+        motion_close (sink);
+        autocrop_close (sink);
+        scopes_close (sink);
+        compute_close (sink);
     }
+    context->es31 = FALSE;
+
+    if (context->desktop)
+        desktop_close (sink);
+    context->desktop = FALSE;
 
     if (context->context) {
         eglDestroyContext (context->display, context->context);
@@ -569,12 +972,131 @@ egl_close(GstGLESSink *sink)
     context->initialized = FALSE;
 }
 
+/*
+ * Look up the geometry of the output the fullscreen window should cover.
+ * The output can be selected by name, otherwise the primary output is
+ * used, or the first output with an active crtc if there is no primary. */
+static void
+x11_get_output_geometry (GstGLESSink *sink, Window root, gint *x, gint *y,
+                         gint *width, gint *height)
+{
+    gint screen = DefaultScreen (sink->x11.display);
+#ifdef HAVE_XRANDR
+    XRRScreenResources *res;
+    RROutput primary;
+    RRCrtc crtc = None;
+    gint event_base, error_base;
+    gint i;
+#endif
+
+    *x = 0;
+    *y = 0;
+    *width = DisplayWidth (sink->x11.display, screen);
+    *height = DisplayHeight (sink->x11.display, screen);
+
+#ifdef HAVE_XRANDR
+    if (!XRRQueryExtension (sink->x11.display, &event_base, &error_base)) {
+        GST_WARNING_OBJECT (sink, "XRandR not available, use screen size");
+        return;
+    }
+
+    res = XRRGetScreenResourcesCurrent (sink->x11.display, root);
+    if (!res) {
+        GST_WARNING_OBJECT (sink, "Could not get XRandR screen resources");
+        return;
+    }
+
+    primary = XRRGetOutputPrimary (sink->x11.display, root);
+
+    for (i = 0; i < res->noutput && crtc == None; i++) {
+        XRROutputInfo *info = XRRGetOutputInfo (sink->x11.display, res,
+                                                res->outputs[i]);
+        if (!info)
+            continue;
+
+        if (info->connection == RR_Connected && info->crtc != None) {
+            if (sink->output) {
+                if (g_str_equal (sink->output, info->name))
+                    crtc = info->crtc;
+            } else if (res->outputs[i] == primary || primary == None) {
+                crtc = info->crtc;
+            }
+
+            if (crtc != None)
+                GST_DEBUG_OBJECT (sink, "Using output %s", info->name);
+        }
+
+        XRRFreeOutputInfo (info);
+    }
+
+    /* the primary output might be disabled, take the first active one */
+    for (i = 0; i < res->noutput && crtc == None && !sink->output; i++) {
+        XRROutputInfo *info = XRRGetOutputInfo (sink->x11.display, res,
+                                                res->outputs[i]);
+        if (!info)
+            continue;
+
+        if (info->connection == RR_Connected && info->crtc != None) {
+            GST_DEBUG_OBJECT (sink, "Using output %s", info->name);
+            crtc = info->crtc;
+        }
+
+        XRRFreeOutputInfo (info);
+    }
+
+    if (crtc != None) {
+        XRRCrtcInfo *info = XRRGetCrtcInfo (sink->x11.display, res, crtc);
+        if (info) {
+            *x = info->x;
+            *y = info->y;
+            *width = info->width;
+            *height = info->height;
+            XRRFreeCrtcInfo (info);
+        }
+    } else if (sink->output) {
+        GST_WARNING_OBJECT (sink, "Output %s not found or not active, "
+                            "use screen size", sink->output);
+    }
+
+    XRRFreeScreenResources (res);
+#endif
+}
+
+/*
+ * Ask the window manager to show the window fullscreen and to unredirect
+ * it, so a compositor can flip our buffers instead of copying them. Both
+ * properties have to be set before the window gets mapped. */
+static void
+x11_set_fullscreen_hints (GstGLESSink *sink)
+{
+    Atom wm_state;
+    Atom wm_fullscreen;
+    Atom bypass_compositor;
+    long bypass = 1;
+
+    wm_state = XInternAtom (sink->x11.display, "_NET_WM_STATE", False);
+    wm_fullscreen = XInternAtom (sink->x11.display,
+                                 "_NET_WM_STATE_FULLSCREEN", False);
+    bypass_compositor = XInternAtom (sink->x11.display,
+                                     "_NET_WM_BYPASS_COMPOSITOR", False);
+
+    XChangeProperty (sink->x11.display, sink->x11.window, wm_state,
+                     XA_ATOM, 32, PropModeReplace,
+                     (unsigned char *) &wm_fullscreen, 1);
+
+    XChangeProperty (sink->x11.display, sink->x11.window, bypass_compositor,
+                     XA_CARDINAL, 32, PropModeReplace,
+                     (unsigned char *) &bypass, 1);
+}
+
 static gint
 x11_init (GstGLESSink *sink, gint width, gint height)
 {
     Window root;
     XSetWindowAttributes swa;
     XWMHints hints;
+    gint x = 0;
+    gint y = 0;
 
     sink->x11.display = XOpenDisplay (NULL);
     if(!sink->x11.display) {
@@ -588,9 +1110,17 @@ x11_init (GstGLESSink *sink, gint width, gint height)
             StructureNotifyMask | ExposureMask | VisibilityChangeMask;
 
     if (!sink->x11.window) {
+        if (sink->fullscreen) {
+            x11_get_output_geometry (sink, root, &x, &y, &width, &height);
+            sink->x11.width = width;
+            sink->x11.height = height;
+            GST_DEBUG_OBJECT (sink, "Fullscreen window %dx%d at %d,%d",
+                              width, height, x, y);
+        }
+
         sink->x11.window = XCreateWindow (
                     sink->x11.display, root,
-                    0, 0, width, height, 0,
+                    x, y, width, height, 0,
                     CopyFromParent, InputOutput,
                     CopyFromParent, CWEventMask,
                     &swa);
@@ -602,7 +1132,11 @@ x11_init (GstGLESSink *sink, gint width, gint height)
         hints.flags = InputHint;
         XSetWMHints(sink->x11.display, sink->x11.window, &hints);
 
-        XMapWindow (sink->x11.display, sink->x11.window);
+        if (sink->fullscreen)
+            x11_set_fullscreen_hints (sink);
+
+        if (!sink->gl_thread.gles.headless)
+            XMapWindow (sink->x11.display, sink->x11.window);
         XStoreName (sink->x11.display, sink->x11.window, "GLESSink");
     } else {
         guint border, depth;
@@ -645,11 +1179,32 @@ x11_close (GstGLESSink *sink)
     }
 }
 
+/* the display lock the gl thread draws under, nothing to lock headless
+ * without an X server */
+static void
+x11_lock (GstGLESSink *sink)
+{
+    if (sink->x11.display)
+        XLockDisplay (sink->x11.display);
+}
+
+static void
+x11_unlock (GstGLESSink *sink)
+{
+    if (sink->x11.display)
+        XUnlockDisplay (sink->x11.display);
+}
+
 static void
 x11_handle_events (gpointer data)
 {
     GstGLESSink *sink = GST_GLES_SINK (data);
 
+    present_handle_events (sink);
+
+    if (!sink->x11.display)
+        return;
+
     XLockDisplay (sink->x11.display);
     while (XPending (sink->x11.display)) {
         XEvent  xev;
@@ -684,130 +1239,714 @@ gl_thread_init (GstGLESSink *sink)
     GstGLESThread *thread = &sink->gl_thread;
     GError *error = NULL;
 
+    /* a thread abandoned by gl_thread_stop still owns the context */
+    if (thread->alive) {
+        GST_ERROR_OBJECT (sink, "Previous render-thread is still stuck");
+        return FALSE;
+    }
+
+    thread->alive = TRUE;
     thread->handle = g_thread_try_new ("gl_thread", gl_thread_proc, sink, &error);
     if (!thread->handle) {
         GST_ERROR_OBJECT (sink, "Can't create render-thread: %s",
                           error ? error->message : "(unknown)");
         g_clear_error (&error);
+        thread->alive = FALSE;
         return FALSE;
     }
     return TRUE;
 }
 
-static void
-gl_thread_stop (GstGLESSink *sink)
-{
-    if (sink->gl_thread.running) {
-        sink->gl_thread.running = FALSE;
-        g_mutex_lock (&sink->gl_thread.data_lock);
-        sink->gl_thread.buf = NULL;
-
-        g_cond_signal (&sink->gl_thread.data_signal);
-        g_mutex_unlock (&sink->gl_thread.data_lock);
-
-        g_thread_join(sink->gl_thread.handle);
-    }
-}
+static const gchar *gl_stage_names[] = {
+    "idle", "upload", "conversion", "presentation", "fence wait",
+    "context recovery"
+};
 
-/* gl thread main function */
-static gpointer
-gl_thread_proc (gpointer data)
+void
+gl_watch_stage (GstGLESSink *sink, GstGLESWatch *watch, GstGLESStage stage)
 {
-    GstGLESSink *sink = GST_GLES_SINK (data);
     GstGLESThread *thread = &sink->gl_thread;
+    gint64 now = g_get_monotonic_time ();
 
-    GST_DEBUG_OBJECT(sink, "Init GL context (no timedwait)");
-    thread->running = setup_gl_context (sink) == 0;
-
-    GST_DEBUG_OBJECT(sink, "Init GL context done, send signal");
-    /* signal gst_gles_sink_render that we are done */
     g_mutex_lock (&thread->render_lock);
-    g_cond_signal (&thread->render_signal);
+    if (watch->stalled)
+        GST_INFO_OBJECT (sink, "Stalled %s took %" G_GINT64_FORMAT " ms",
+                         gl_stage_names[watch->stage],
+                         (now - watch->since) / G_TIME_SPAN_MILLISECOND);
+    watch->stage = stage;
+    watch->since = now;
+    watch->stalled = FALSE;
     g_mutex_unlock (&thread->render_lock);
+}
 
-    while (thread->running) {
-        x11_handle_events (sink);
+/*
+ * Returns the watch that has been in its stage for longer than the
+ * watchdog timeout, otherwise NULL and the time at which to check again.
+ * Must be called with the render_lock held. */
+static GstGLESWatch *
+gl_thread_stalled (GstGLESSink *sink, gint64 *deadline)
+{
+    GstGLESThread *thread = &sink->gl_thread;
+    GstGLESWatch *watches[] = { &thread->watch, &thread->upload_watch };
+    gint64 limit = (gint64) sink->watchdog_timeout * G_TIME_SPAN_MILLISECOND;
+    gint64 now = g_get_monotonic_time ();
+    guint i;
+
+    *deadline = now + limit;
+    for (i = 0; i < G_N_ELEMENTS (watches); i++) {
+        if (watches[i]->stage == GL_STAGE_IDLE)
+            continue;
+        if (now - watches[i]->since >= limit)
+            return watches[i];
+        *deadline = MIN (*deadline, watches[i]->since + limit);
+    }
 
-        g_mutex_lock (&thread->data_lock);
-        /* wait till gst_gles_sink_render has some data for us */
-        while (!thread->buf && thread->running) {
-            g_cond_wait (&thread->data_signal, &thread->data_lock);
-        }
+    return NULL;
+}
 
-        if (thread->buf) {
-            if (!thread->gles.initialized) {
-                /* generate the framebuffer object */
-                gl_gen_framebuffer (sink);
-                thread->gles.initialized = TRUE;
-            }
+static void
+gl_thread_stop (GstGLESSink *sink)
+{
+    GstGLESThread *thread = &sink->gl_thread;
+    GstGLESWatch *stalled = NULL;
+    gint64 deadline;
 
-            XLockDisplay (sink->x11.display);
-            gl_draw_fbo (sink, thread->buf);
-            gl_draw_onscreen (sink);
-            thread->buf = NULL;
-            XUnlockDisplay (sink->x11.display);
-	    thread->render_done = TRUE;
-        }
+    if (thread->running) {
+        thread->running = FALSE;
+        g_mutex_lock (&thread->data_lock);
+        gst_buffer_replace (&thread->buf, NULL);
 
+        g_cond_broadcast (&thread->data_signal);
         g_mutex_unlock (&thread->data_lock);
 
-        /* signal gst_gles_sink_render that we are done */
+        /* release a streaming thread waiting for its frame */
         g_mutex_lock (&thread->render_lock);
-        g_cond_signal (&thread->render_signal);
+        g_cond_broadcast (&thread->render_signal);
+
+        /* a thread wedged in the driver would never be joined and hang
+         * the state change, wait for it only as long as the watchdog */
+        while (sink->watchdog_timeout && thread->alive) {
+            if ((stalled = gl_thread_stalled (sink, &deadline)))
+                break;
+            g_cond_wait_until (&thread->render_signal, &thread->render_lock,
+                               deadline);
+        }
+        if (stalled)
+            GST_WARNING_OBJECT (sink, "%s stuck in %s, leaving it behind",
+                stalled == &thread->watch ? "GL thread" : "Upload thread",
+                gl_stage_names[stalled->stage]);
         g_mutex_unlock (&thread->render_lock);
-    }
 
-    egl_close(sink);
-    x11_close(sink);
-    return 0;
+        if (stalled)
+            g_thread_unref (thread->handle);
+        else
+            g_thread_join (thread->handle);
+        thread->handle = NULL;
+    }
 }
 
-static gint
-setup_gl_context (GstGLESSink *sink)
+/*
+ * Hands a buffer to the gl thread and waits until it has been drawn.
+ * The gl thread holds its own reference, so the wait can be cancelled by
+ * gst_gles_sink_unlock at any time while a swap is still in progress. */
+static GstFlowReturn
+gl_thread_render (GstGLESSink *sink, GstBuffer *buf)
 {
-    GstGLESContext *gles = &sink->gl_thread.gles;
-    gint ret;
+    GstGLESThread *thread = &sink->gl_thread;
+    GstFlowReturn ret = GST_FLOW_OK;
+    GstGLESWatch *stalled = NULL;
+    GstGLESStage stage = GL_STAGE_IDLE;
+    gboolean report = FALSE;
+    gint64 deadline;
+    gint64 elapsed = 0;
+    guint64 frame;
 
-    sink->x11.width = 720;
-    sink->x11.height = 576;
-    if (x11_init (sink, sink->x11.width, sink->x11.height) < 0) {
-        GST_ERROR_OBJECT (sink, "X11 init failed, abort");
-        return -ENOMEM;
+    g_mutex_lock (&thread->data_lock);
+    /* a render that starts after unlock must not queue its buffer, the
+     * gl thread would draw it after the flush */
+    if (thread->flushing) {
+        g_mutex_unlock (&thread->data_lock);
+        return GST_GLES_FLOW_FLUSHING;
+    }
+    gst_buffer_replace (&thread->buf, buf);
+    frame = ++thread->submitted;
+    g_cond_broadcast (&thread->data_signal);
+    g_mutex_unlock (&thread->data_lock);
+
+    g_mutex_lock (&thread->render_lock);
+    while (thread->completed < frame && !thread->flushing &&
+           thread->running) {
+        if (!sink->watchdog_timeout)
+            g_cond_wait (&thread->render_signal, &thread->render_lock);
+        else if ((stalled = gl_thread_stalled (sink, &deadline)))
+            break;
+        else
+            g_cond_wait_until (&thread->render_signal, &thread->render_lock,
+                               deadline);
+    }
+
+    if (stalled) {
+        /* a wedged driver must not hold up the rest of the pipeline,
+         * drop frames until the stage is left */
+        report = !stalled->stalled;
+        stalled->stalled = TRUE;
+        stage = stalled->stage;
+        elapsed = g_get_monotonic_time () - stalled->since;
+    } else if (thread->completed < frame) {
+        ret = GST_GLES_FLOW_FLUSHING;
+    }
+    g_mutex_unlock (&thread->render_lock);
+
+    if (stalled) {
+        GST_OBJECT_LOCK (sink);
+        sink->stats.watchdog_drops++;
+        if (report)
+            sink->stats.stalls++;
+        GST_OBJECT_UNLOCK (sink);
+
+        if (report)
+            GST_ELEMENT_WARNING (sink, RESOURCE, BUSY,
+                ("Rendering stalled, dropping frames"),
+                ("%s stuck in %s for %" G_GINT64_FORMAT " ms",
+                 stalled == &thread->watch ? "GL thread" : "Upload thread",
+                 gl_stage_names[stage], elapsed / G_TIME_SPAN_MILLISECOND));
+    }
+
+    return ret;
+}
+
+/* finishes the statistics of a frame that has been put on screen, the gl
+ * thread has been preempted switches times while drawing it */
+static void
+gl_thread_frame_shown (GstGLESSink *sink, guint64 switches)
+{
+    GST_OBJECT_LOCK (sink);
+    sink->stats.involuntary_switches += switches;
+    if (switches)
+        sink->stats.preempted_frames++;
+    if (GST_CLOCK_TIME_IS_VALID (sink->stats.flush_start)) {
+        sink->stats.flush_latency = gst_util_get_timestamp () -
+                                    sink->stats.flush_start;
+        sink->stats.flush_start = GST_CLOCK_TIME_NONE;
+    }
+    GST_OBJECT_UNLOCK (sink);
+}
+
+/*
+ * Rebuilds the EGL context and everything living in it after it has been
+ * lost, keeping the window and the streaming side untouched. Programs are
+ * relinked from their cached binaries where possible, frames waiting in
+ * the texture sets are dropped and the framebuffer object is regenerated
+ * with the next frame.
+ */
+static void
+gl_thread_recover (GstGLESSink *sink)
+{
+    GstGLESThread *thread = &sink->gl_thread;
+    GstClockTime start = gst_util_get_timestamp ();
+    GstClockTime elapsed;
+    gint ret;
+
+    GST_WARNING_OBJECT (sink, "GL context lost, rebuilding it");
+    gl_watch_stage (sink, &thread->watch, GL_STAGE_RECOVER);
+
+    uploader_stop (sink);
+    gst_buffer_replace (&thread->last_buf, NULL);
+
+    x11_lock (sink);
+    egl_close (sink);
+    thread->gles.lost = FALSE;
+    ret = gl_context_init (sink);
+    x11_unlock (sink);
+
+    if (ret < 0) {
+        GST_ELEMENT_ERROR (sink, RESOURCE, FAILED,
+            ("Could not restore the lost GL context"), (NULL));
+        thread->running = FALSE;
+        return;
     }
 
+    elapsed = gst_util_get_timestamp () - start;
+
+    GST_OBJECT_LOCK (sink);
+    sink->stats.context_losses++;
+    sink->stats.recovery_time = elapsed;
+    GST_OBJECT_UNLOCK (sink);
+
+    GST_ELEMENT_WARNING (sink, RESOURCE, FAILED,
+        ("GL context lost and restored"),
+        ("Restored in %" GST_TIME_FORMAT, GST_TIME_ARGS (elapsed)));
+}
+
+/* converts and shows a buffer uploaded in the gl thread */
+static void
+gl_thread_draw_buffer (GstGLESSink *sink, GstBuffer *buf)
+{
+    GstGLESThread *thread = &sink->gl_thread;
+
+    thread->pts = GST_BUFFER_TIMESTAMP (buf);
+
+    x11_lock (sink);
+    if (gl_buffer_unchanged (thread->last_buf, buf)) {
+        /* the framebuffer still holds this picture, only present
+         * again if the window or the crop changed */
+        if (gl_onscreen_changed (sink))
+            gl_draw_onscreen (sink);
+
+        GST_OBJECT_LOCK (sink);
+        sink->stats.unchanged++;
+        GST_OBJECT_UNLOCK (sink);
+        detect_unchanged (sink, thread->pts);
+        motion_unchanged (sink, thread->pts);
+    } else {
+        GstGLESSlot *slot;
+
+        gl_watch_stage (sink, &thread->watch, GL_STAGE_FENCE);
+        slot = gl_slot_next (sink);
+
+        gl_draw_fbo (sink, slot, buf);
+        gl_draw_onscreen (sink);
+
+        /* keep the buffer until the GPU is done with the set */
+        gl_slot_fence (sink, slot);
+        gst_buffer_replace (&slot->buf, buf);
+        gst_buffer_replace (&thread->last_buf, buf);
+    }
+    x11_unlock (sink);
+}
+
+/* converts and shows a frame prepared by the upload thread */
+static void
+gl_thread_draw_slot (GstGLESSink *sink, GstGLESSlot *slot)
+{
+    GstGLESThread *thread = &sink->gl_thread;
+
+    /* wait for the upload to land */
+    gl_watch_stage (sink, &thread->watch, GL_STAGE_FENCE);
+    gl_slot_wait (sink, slot);
+    thread->pts = slot->pts;
+
+    x11_lock (sink);
+    gl_draw_fbo (sink, slot, NULL);
+    gl_draw_onscreen (sink);
+    x11_unlock (sink);
+
+    /* the next upload to this set has to wait for the conversion */
+    gl_slot_fence (sink, slot);
+
+    g_mutex_lock (&thread->data_lock);
+    slot->state = SLOT_FREE;
+    g_cond_broadcast (&thread->data_signal);
+    g_mutex_unlock (&thread->data_lock);
+}
+
+/* takes the newest uploaded frame and frees the ones it replaces, must
+ * be called with the data_lock held */
+static GstGLESSlot *
+gl_thread_take_slot (GstGLESSink *sink)
+{
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    GstGLESSlot *slot = NULL;
+    gint i;
+
+    for (i = 0; i < gles->n_slots; i++) {
+        if (gles->slots[i].state == SLOT_READY &&
+            (!slot || gles->slots[i].frame > slot->frame))
+            slot = &gles->slots[i];
+    }
+
+    for (i = 0; i < gles->n_slots; i++) {
+        if (gles->slots[i].state == SLOT_READY && &gles->slots[i] != slot)
+            gles->slots[i].state = SLOT_FREE;
+    }
+
+    if (slot)
+        slot->state = SLOT_DRAWING;
+
+    return slot;
+}
+
+/* returns TRUE if a frame is waiting for the gl thread, must be called
+ * with the data_lock held */
+static gboolean
+gl_thread_has_work (GstGLESSink *sink)
+{
+    GstGLESThread *thread = &sink->gl_thread;
+    gint i;
+
+    if (thread->represent)
+        return TRUE;
+
+    if (!thread->uploader.running)
+        return thread->buf != NULL;
+
+    for (i = 0; i < thread->gles.n_slots; i++) {
+        if (thread->gles.slots[i].state == SLOT_READY)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+void
+gl_thread_represent (GstGLESSink *sink)
+{
+    GstGLESThread *thread = &sink->gl_thread;
+
+    g_mutex_lock (&thread->data_lock);
+    thread->represent = TRUE;
+    g_cond_broadcast (&thread->data_signal);
+    g_mutex_unlock (&thread->data_lock);
+}
+
+/* applies the thread scheduling to a repack worker */
+static void
+gl_repack_thread_init (gpointer data)
+{
+    GstGLESSink *sink = GST_GLES_SINK (data);
+
+    sched_apply (GST_ELEMENT (sink), &sink->sched, "repack worker");
+}
+
+/* gl thread main function */
+static gpointer
+gl_thread_proc (gpointer data)
+{
+    GstGLESSink *sink = GST_GLES_SINK (data);
+    GstGLESThread *thread = &sink->gl_thread;
+    GstGLESSlot *slot;
+    GstBuffer *buf;
+    gboolean represent;
+    guint64 frame;
+    guint64 switches;
+
+    sched_apply (GST_ELEMENT (sink), &sink->sched, "gl thread");
+
+    GST_DEBUG_OBJECT(sink, "Init GL context (no timedwait)");
+    thread->running = setup_gl_context (sink) == 0;
+
+    GST_DEBUG_OBJECT(sink, "Init GL context done, send signal");
+    /* signal gst_gles_sink_render that we are done */
+    g_mutex_lock (&thread->render_lock);
+    g_cond_signal (&thread->render_signal);
+    g_mutex_unlock (&thread->render_lock);
+
+    while (thread->running) {
+        x11_handle_events (sink);
+
+        /* a resize may have presented on a lost context as well */
+        if (thread->gles.lost) {
+            gl_thread_recover (sink);
+            continue;
+        }
+
+        gl_watch_stage (sink, &thread->watch, GL_STAGE_IDLE);
+
+        g_mutex_lock (&thread->data_lock);
+        /* wait till gst_gles_sink_render or the upload thread has some
+         * data for us */
+        while (!gl_thread_has_work (sink) && thread->running) {
+            g_cond_wait (&thread->data_signal, &thread->data_lock);
+        }
+
+        /* take the buffer over, so a flush does not have to wait
+         * for the draw to finish */
+        buf = NULL;
+        slot = NULL;
+        if (thread->uploader.running) {
+            slot = gl_thread_take_slot (sink);
+        } else {
+            buf = thread->buf;
+            thread->buf = NULL;
+        }
+        frame = thread->submitted;
+        represent = thread->represent;
+        thread->represent = FALSE;
+        g_mutex_unlock (&thread->data_lock);
+
+        if (!buf && !slot) {
+            if (represent && thread->gles.initialized) {
+                x11_lock (sink);
+                if (gl_onscreen_changed (sink))
+                    gl_draw_onscreen (sink);
+                x11_unlock (sink);
+            }
+            continue;
+        }
+
+        switches = sched_involuntary_switches ();
+
+        if (!thread->gles.initialized) {
+            /* generate the framebuffer object */
+            gl_gen_framebuffer (sink);
+            thread->gles.initialized = TRUE;
+        }
+
+        if (slot) {
+            /* the upload thread already released the streaming thread */
+            gl_thread_draw_slot (sink, slot);
+            if (!thread->gles.lost)
+                gl_thread_frame_shown (sink,
+                        sched_involuntary_switches () - switches);
+            continue;
+        }
+
+        gl_thread_draw_buffer (sink, buf);
+        gst_buffer_unref (buf);
+        if (!thread->gles.lost)
+            gl_thread_frame_shown (sink,
+                    sched_involuntary_switches () - switches);
+
+        /* signal gst_gles_sink_render that we are done */
+        g_mutex_lock (&thread->render_lock);
+        thread->completed = frame;
+        g_cond_broadcast (&thread->render_signal);
+        g_mutex_unlock (&thread->render_lock);
+    }
+
+    uploader_stop (sink);
+    gst_buffer_replace (&thread->last_buf, NULL);
+    gl_watch_stage (sink, &thread->watch, GL_STAGE_IDLE);
+
+    present_close(sink);
+    egl_close(sink);
+    x11_close(sink);
+
+    gl_free_shader_binary (&thread->gles.deinterlace);
+    gl_free_shader_binary (&thread->gles.deinterlace_packed);
+    gl_free_shader_binary (&thread->gles.deinterlace_nv12);
+    gl_free_shader_binary (&thread->gles.scale);
+    gl_free_shader_binary (&thread->gles.compute.convert);
+    gl_free_shader_binary (&thread->gles.compute.convert_nv12);
+    gl_free_shader_binary (&thread->gles.compute.reduce);
+    gl_free_shader_binary (&thread->gles.scopes.accumulate);
+    gl_free_shader_binary (&thread->gles.scopes.render);
+    gl_free_shader_binary (&thread->gles.autocrop.reduce);
+    gl_free_shader_binary (&thread->gles.motion.diff);
+    gl_free_shader_binary (&thread->gles.motion.outline);
+    gl_free_shader_binary (&thread->gles.text.shader);
+
+    g_mutex_lock (&thread->render_lock);
+    thread->alive = FALSE;
+    g_cond_broadcast (&thread->render_signal);
+    g_mutex_unlock (&thread->render_lock);
+    return 0;
+}
+
+/*
+ * Creates the EGL context with the programs and textures the conversion
+ * needs, on the window set up before. Used on start and to rebuild a
+ * lost context, cleans up after itself on failure.
+ */
+static gint
+gl_context_init (GstGLESSink *sink)
+{
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    gint ret;
+
     if (egl_init (sink) < 0) {
         GST_ERROR_OBJECT (sink, "EGL init failed, abort");
-        x11_close (sink);
+        egl_close (sink);
         return -ENOMEM;
     }
 
+    if (gles->desktop) {
+        if (desktop_init (sink) < 0) {
+            egl_close (sink);
+            return -ENOMEM;
+        }
+
+        /* core profiles dropped luminance textures */
+        gles->plane_format = GL_RED_EXT;
+        gles->plane_internal_format = GL_R8_EXT;
+    } else {
+        gles->plane_format = GL_LUMINANCE;
+        gles->plane_internal_format = GL_LUMINANCE;
+    }
+
     ret = gl_init_shader (GST_ELEMENT (sink), &gles->deinterlace,
                           SHADER_DEINT_LINEAR);
     if (ret < 0) {
         GST_ERROR_OBJECT (sink, "Could not initialize shader: %d", ret);
         egl_close (sink);
-        x11_close (sink);
         return -ENOMEM;
     }
-    gles->y_tex.loc = glGetUniformLocation(gles->deinterlace.program,
-                                           "s_ytex");
-    gles->u_tex.loc = glGetUniformLocation(gles->deinterlace.program,
-                                           "s_utex");
-    gles->v_tex.loc = glGetUniformLocation(gles->deinterlace.program,
-                                           "s_vtex");
+
+    /* the shipped binary of the conversion may predate the privacy
+     * masks, the source has them where it can be compiled */
+    if (glGetUniformLocation (gles->deinterlace.program, "masked") < 0) {
+        GST_INFO_OBJECT (sink, "Conversion binary lacks the privacy masks, "
+                         "compiling the source");
+        gl_delete_shader (&gles->deinterlace);
+        gl_free_shader_binary (&gles->deinterlace);
+        gles->deinterlace.source_only = TRUE;
+        ret = gl_init_shader (GST_ELEMENT (sink), &gles->deinterlace,
+                              SHADER_DEINT_LINEAR);
+        gles->deinterlace.source_only = FALSE;
+        if (ret < 0) {
+            GST_WARNING_OBJECT (sink, "Falling back to the binary, frames "
+                                "with privacy masks are blacked out");
+            gl_delete_shader (&gles->deinterlace);
+            ret = gl_init_shader (GST_ELEMENT (sink), &gles->deinterlace,
+                                  SHADER_DEINT_LINEAR);
+        }
+        if (ret < 0) {
+            GST_ERROR_OBJECT (sink, "Could not initialize shader: %d", ret);
+            egl_close (sink);
+            return -ENOMEM;
+        }
+    }
+    gles->plane_loc[0] = glGetUniformLocation(gles->deinterlace.program,
+                                              "s_ytex");
+    gles->plane_loc[1] = glGetUniformLocation(gles->deinterlace.program,
+                                              "s_utex");
+    gles->plane_loc[2] = glGetUniformLocation(gles->deinterlace.program,
+                                              "s_vtex");
 
     ret = gl_init_shader (GST_ELEMENT (sink), &gles->scale, SHADER_COPY);
     if (ret < 0) {
         GST_ERROR_OBJECT (sink, "Could not initialize shader: %d", ret);
         egl_close (sink);
-        x11_close (sink);
         return -ENOMEM;
     }
     gles->rgb_tex.loc = glGetUniformLocation(gles->scale.program, "s_tex");
+
+    gles->packed = FALSE;
+    if (sink->packed_upload) {
+        ret = gl_init_shader (GST_ELEMENT (sink), &gles->deinterlace_packed,
+                              SHADER_DEINT_LINEAR_PACKED);
+        if (ret < 0) {
+            GST_WARNING_OBJECT (sink, "Could not initialize packed shader, "
+                                "uploading planes separately");
+        } else {
+            gles->packed_tex_loc = glGetUniformLocation (
+                    gles->deinterlace_packed.program, "s_tex");
+            gles->packed_size_loc = glGetUniformLocation (
+                    gles->deinterlace_packed.program, "size");
+            gles->packed_tex_size_loc = glGetUniformLocation (
+                    gles->deinterlace_packed.program, "tex_size");
+            gles->packed = TRUE;
+        }
+    }
+
+    /* NV12 chroma can be sampled from an rg texture without repacking */
+    gles->texture_rg = gles->desktop ||
+                       gl_extension_available ("GL_EXT_texture_rg");
+    if (gles->texture_rg) {
+        ret = gl_init_shader (GST_ELEMENT (sink), &gles->deinterlace_nv12,
+                              SHADER_DEINT_LINEAR_NV12);
+        if (ret < 0) {
+            GST_WARNING_OBJECT (sink, "Could not initialize NV12 shader, "
+                                "repacking NV12 frames");
+            gles->texture_rg = FALSE;
+        } else {
+            gles->nv12_loc[0] = glGetUniformLocation (
+                    gles->deinterlace_nv12.program, "s_ytex");
+            gles->nv12_loc[1] = glGetUniformLocation (
+                    gles->deinterlace_nv12.program, "s_uvtex");
+        }
+    }
+
+    if (compute_init (sink))
+        GST_DEBUG_OBJECT (sink, "Compute shaders available");
+    scopes_init (sink);
+    autocrop_init (sink);
+    motion_init (sink);
+    privacy_init (sink);
+    text_init (sink);
+    replay_init (sink);
+
+    /* the upload thread needs a second set to overlap with the draw */
+    gles->n_slots = sink->texture_slots;
+    if (sink->upload_thread)
+        gles->n_slots = MAX (gles->n_slots, 2);
+    gles->next_slot = 0;
     gl_init_textures (sink);
 
+    /* GL_UNPACK_ROW_LENGTH is core in desktop GL */
+    gles->unpack_subimage = gles->desktop ||
+                            gl_extension_available ("GL_EXT_unpack_subimage");
+    GST_DEBUG_OBJECT (sink, "Sub image uploads %ssupported",
+                      gles->unpack_subimage ? "" : "not ");
+
+    egl_init_fences (sink);
+    GST_DEBUG_OBJECT (sink, "Fence syncs %ssupported",
+                      gles->fence_sync ? "" : "not ");
+
+    if (sink->upload_thread && uploader_start (sink) == 0)
+        GST_DEBUG_OBJECT (sink, "Uploading in a separate thread");
+
+    return 0;
+}
+
+/* tells the application which device and renderer the sink ended up
+ * with, so that several sinks can be spread over the GPUs */
+static void
+gl_report_device (GstGLESSink *sink)
+{
+    gchar *device = device_describe (sink->gl_thread.gles.display);
+    gchar *renderer = g_strdup ((const gchar *) glGetString (GL_RENDERER));
+
+    GST_INFO_OBJECT (sink, "Rendering on device %s, renderer %s",
+                     GST_STR_NULL (device), GST_STR_NULL (renderer));
+
+    gst_element_post_message (GST_ELEMENT (sink),
+        gst_message_new_element (GST_OBJECT (sink),
+            gst_structure_new ("glessink-device",
+                "device", G_TYPE_STRING, device,
+                "renderer", G_TYPE_STRING, renderer,
+                "headless", G_TYPE_BOOLEAN, sink->gl_thread.gles.headless,
+                NULL)));
+
+    GST_OBJECT_LOCK (sink);
+    g_free (sink->device_in_use);
+    g_free (sink->renderer);
+    sink->device_in_use = device;
+    sink->renderer = renderer;
+    GST_OBJECT_UNLOCK (sink);
+}
+
+static gint
+setup_gl_context (GstGLESSink *sink)
+{
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    gboolean device;
+
+    GST_OBJECT_LOCK (sink);
+    device = sink->device && *sink->device;
+    GST_OBJECT_UNLOCK (sink);
+
+    /* a device the X11 display cannot render on gets no window and does
+     * not need an X server */
+    gles->headless = device && !device_explicit_available ();
+
+    sink->x11.width = 720;
+    sink->x11.height = 576;
+    if (!gles->headless &&
+        x11_init (sink, sink->x11.width, sink->x11.height) < 0) {
+        if (!device) {
+            GST_ERROR_OBJECT (sink, "X11 init failed, abort");
+            return -ENOMEM;
+        }
+
+        /* the device platform display works without one */
+        GST_INFO_OBJECT (sink, "No X server, rendering headless");
+        gles->headless = TRUE;
+    }
+
+    if (!gles->headless)
+        present_init (sink);
+
+    if (gl_context_init (sink) < 0) {
+        present_close (sink);
+        x11_close (sink);
+        return -ENOMEM;
+    }
+
+    gl_report_device (sink);
+
     /* finally announce the window handle to controling app */
-    if (!sink->x11.external_window)
+    if (!sink->x11.external_window && !gles->headless)
 #if GST_CHECK_VERSION(1, 0, 0)
         gst_video_overlay_got_window_handle (GST_VIDEO_OVERLAY (sink),
                                          sink->x11.window);
@@ -880,12 +2019,291 @@ gst_gles_sink_class_init (GstGLESSinkClass * klass)
 	"first frame is drawn, drop n frames.", 0, G_MAXUINT, 0,
 	  G_PARAM_READWRITE));
 
+  g_object_class_install_property (gobject_class, PROP_FULLSCREEN,
+      g_param_spec_boolean ("fullscreen", "Fullscreen", "Cover the whole "
+        "output and ask the compositor to unredirect the window.", FALSE,
+	  G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_OUTPUT,
+      g_param_spec_string ("output", "Output", "Name of the XRandR output "
+        "used in fullscreen mode, the primary output if not set.", NULL,
+	  G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics", "Rendering and "
+        "presentation statistics.", GST_TYPE_STRUCTURE,
+	  G_PARAM_READABLE));
+
+  g_object_class_install_property (gobject_class, PROP_PROVIDE_CLOCK,
+      g_param_spec_boolean ("provide_clock", "Provide clock", "Provide a "
+        "clock following the display refresh to the pipeline.", FALSE,
+	  G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_DIRTY_TILES,
+      g_param_spec_boolean ("dirty_tiles", "Dirty tiles", "Compare each "
+        "frame with the previous one and upload only the changed tiles.",
+        FALSE, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_UPLOAD_THREAD,
+      g_param_spec_boolean ("upload_thread", "Upload thread", "Upload "
+        "frames from a separate thread with a shared context while the "
+        "previous one is drawn. Disables dirty tile uploads.",
+        FALSE, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_TEXTURE_SLOTS,
+      g_param_spec_uint ("texture_slots", "Texture slots", "Number of "
+        "texture sets uploads rotate through, so an upload does not wait "
+        "for the draw of the previous frame.", 1, GST_GLES_MAX_SLOTS,
+        DEFAULT_TEXTURE_SLOTS, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_PACKED_UPLOAD,
+      g_param_spec_boolean ("packed_upload", "Packed upload", "Upload "
+        "contiguous frames as a single texture instead of one texture per "
+        "plane. Not used with dirty tile uploads.", FALSE,
+        G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_REPACK_THREADS,
+      g_param_spec_uint ("repack_threads", "Repack threads", "Threads "
+        "converting NV12 frames and strides GL cannot upload directly, "
+        "0 for one per cpu up to 4.", 0, 16, 0, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_WATCHDOG_TIMEOUT,
+      g_param_spec_uint ("watchdog_timeout", "Watchdog timeout", "Time in "
+        "ms the gl thread may spend in one stage of a frame before frames "
+        "are dropped instead of waiting for it, 0 to wait forever.",
+        0, G_MAXUINT, 0, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_SCHED_POLICY,
+      g_param_spec_string ("sched_policy", "Scheduling policy", "Policy "
+        "of the gl thread, the upload thread and the repack workers: "
+        "other, fifo or rr. Falls back to other without the privileges "
+        "for real time scheduling.", "other", G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_SCHED_PRIORITY,
+      g_param_spec_uint ("sched_priority", "Scheduling priority", "Real "
+        "time priority used with the fifo and rr policies.", 1, 99,
+        DEFAULT_SCHED_PRIORITY, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_NICE,
+      g_param_spec_int ("nice", "Nice level", "Nice level of the gl "
+        "thread, the upload thread and the repack workers when they are "
+        "not scheduled in real time.", -20, 19, 0, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_CPU_AFFINITY,
+      g_param_spec_uint64 ("cpu_affinity", "CPU affinity", "Mask of the "
+        "cpus the gl thread, the upload thread and the repack workers may "
+        "run on, 0 to keep the inherited mask. Applied when the threads "
+        "start.", 0, G_MAXUINT64, 0, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_GL_API,
+      g_param_spec_string ("gl_api", "GL api", "Render with gles, with "
+        "an opengl 3.3 core context, or auto to use opengl where the "
+        "driver has it. Applied when the window is created.", "gles",
+        G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_DEVICE,
+      g_param_spec_string ("device", "Device", "EGL device to render on: "
+        "a DRM device or render node path, software, or the index of the "
+        "device. Without EGL_EXT_explicit_device or without an X server the "
+        "frames are rendered headless into a pbuffer. The driver picks the "
+        "device if unset.",
+        NULL, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_CONVERT_PATH,
+      g_param_spec_string ("convert_path", "Convert path", "Convert with "
+        "fragment shaders, with GLES 3.1 compute shaders where the driver "
+        "has them, or bench to alternate between both every frame and "
+        "compare their timings in the stats. Applied when the window is "
+        "created.", "fragment", G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_FRAME_METRICS,
+      g_param_spec_boolean ("frame_metrics", "Frame metrics", "Measure "
+        "the luma mean and variance of every converted frame, reported "
+        "in the stats", FALSE, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_SCOPES,
+      g_param_spec_string ("scopes", "Scopes", "Comma separated list of "
+        "the video scopes to compute on the GPU: histogram, waveform and "
+        "vectorscope. Applied when the window is created.", NULL,
+        G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_SCOPE_OVERLAY,
+      g_param_spec_boolean ("scope_overlay", "Scope overlay", "Draw the "
+        "scopes over the bottom left corner of the window", TRUE,
+        G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_SCOPE_INTERVAL,
+      g_param_spec_uint ("scope_interval", "Scope interval", "Update the "
+        "scopes every n converted frames", 1, G_MAXUINT, 1,
+        G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class,
+      PROP_SCOPE_MESSAGE_INTERVAL,
+      g_param_spec_uint ("scope_message_interval", "Scope message interval",
+        "Post the scopes as glessink-scopes element messages at most "
+        "every n ms, 0 for no messages", 0, G_MAXUINT, 0,
+        G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_BLACK_THRESHOLD,
+      g_param_spec_uint ("black_threshold", "Black threshold", "Frames "
+        "whose mean luma and luma deviation are both below this level "
+        "count as black, 0 to disable", 0, 255, 0, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_FREEZE_THRESHOLD,
+      g_param_spec_double ("freeze_threshold", "Freeze threshold", "Frames "
+        "whose mean luma difference from the frame before is below this "
+        "level count as frozen, 0 to disable", 0, 255, 0,
+        G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_DETECT_DURATION,
+      g_param_spec_uint ("detect_duration", "Detect duration", "Time in "
+        "ms black or frozen frames have to last, and their end has to "
+        "last, before glessink-black and glessink-freeze messages are "
+        "posted", 0, G_MAXUINT, DEFAULT_DETECT_DURATION,
+        G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_AUTOCROP,
+      g_param_spec_boolean ("autocrop", "Autocrop", "Detect black borders "
+        "and set the crop properties to remove them, the crop stays "
+        "when this is disabled", FALSE, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_AUTOCROP_THRESHOLD,
+      g_param_spec_uint ("autocrop_threshold", "Autocrop threshold", "Rows "
+        "and columns whose mean luma is not above this level count as "
+        "border", 0, 255, DEFAULT_AUTOCROP_THRESHOLD, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_AUTOCROP_DURATION,
+      g_param_spec_uint ("autocrop_duration", "Autocrop duration", "Time "
+        "in ms detected borders have to be stable before the crop follows "
+        "them, a quarter of it for borders that show more of the picture",
+        0, G_MAXUINT, DEFAULT_AUTOCROP_DURATION, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_MOTION_THRESHOLD,
+      g_param_spec_uint ("motion_threshold", "Motion threshold", "Grid "
+        "cells whose mean luma difference from the frame before is above "
+        "this level count as moving, 0 to disable motion detection", 0, 255,
+        0, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_MOTION_GRID,
+      g_param_spec_string ("motion_grid", "Motion grid", "Cells of the "
+        "motion grid as COLUMNSxROWS, up to 64x64", "16x9",
+        G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_MOTION_ZONES,
+      g_param_spec_string ("motion_zones", "Motion zones", "Zones reported "
+        "separately as x,y,width,height[,area] in fractions of the frame "
+        "from the top left, separated by semicolons, the whole frame if "
+        "empty", NULL, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_MOTION_AREA,
+      g_param_spec_uint ("motion_area", "Motion area", "Percentage of the "
+        "cells of a zone that have to move for motion in the zone, unless "
+        "the zone sets its own", 0, 100, DEFAULT_MOTION_AREA,
+        G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_MOTION_HOLD,
+      g_param_spec_uint ("motion_hold", "Motion hold", "Time in ms motion "
+        "in a zone has to pause before glessink-motion reports it stopped",
+        0, G_MAXUINT, DEFAULT_MOTION_HOLD, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_MOTION_OUTLINE,
+      g_param_spec_boolean ("motion_outline", "Motion outline", "Outline "
+        "the moving cells of the motion grid", FALSE, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_PRIVACY_MASKS,
+      g_param_spec_string ("privacy_masks", "Privacy masks", "Regions the "
+        "conversion hides, separated by semicolons, each x,y,width,height "
+        "or three or more x,y points of a polygon in video pixels, "
+        "optionally prefixed with fill: (default) or pixelate:", NULL,
+        G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_PRIVACY_BLOCK,
+      g_param_spec_uint ("privacy_block", "Privacy block", "Edge in pixels "
+        "of the blocks pixelating masks show", 1, 256, DEFAULT_PRIVACY_BLOCK,
+        G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_TEXT,
+      g_param_spec_string ("text", "Text", "Text drawn over the picture, "
+        "with the fields {running-time}, {pts}, {fps}, {drops}, {frames} "
+        "and {name} replaced for every frame", NULL, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_TEXT_FONT,
+      g_param_spec_string ("text_font", "Text font", "X core font the "
+        "text is drawn with", DEFAULT_TEXT_FONT, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_TEXT_SCALE,
+      g_param_spec_uint ("text_scale", "Text scale", "Screen pixels per "
+        "font pixel", 1, 16, DEFAULT_TEXT_SCALE, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_TEXT_POSITION,
+      g_param_spec_string ("text_position", "Text position", "Corner of the "
+        "window the text is drawn in: top-left, top-right, bottom-left or "
+        "bottom-right", "top-left", G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_REPLAY_FRAMES,
+      g_param_spec_uint ("replay_frames", "Replay frames", "Recent frames "
+        "kept on the GPU for instant replay, 0 to disable", 0,
+        REPLAY_MAX_FRAMES, 0, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_REPLAY_DIVISOR,
+      g_param_spec_uint ("replay_divisor", "Replay divisor", "Width and "
+        "height of the replay frames are the video size divided by this",
+        1, 16, DEFAULT_REPLAY_DIVISOR, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_REPLAY_BUDGET,
+      g_param_spec_uint ("replay_budget", "Replay budget", "MB of texture "
+        "memory the replay frames may take, fewer frames are kept if "
+        "replay_frames do not fit", 1, 4096, DEFAULT_REPLAY_BUDGET,
+        G_PARAM_READWRITE));
+
+  /* shows the newest replay frame instead of the stream */
+  gst_gles_sink_signals[SIGNAL_REPLAY_FREEZE] =
+      g_signal_new ("replay-freeze", G_TYPE_FROM_CLASS (klass),
+          G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+          G_STRUCT_OFFSET (GstGLESSinkClass, replay_freeze), NULL, NULL,
+          g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+
+  /* shows the replay frame before the one shown, freezing first */
+  gst_gles_sink_signals[SIGNAL_REPLAY_STEP_BACK] =
+      g_signal_new ("replay-step-back", G_TYPE_FROM_CLASS (klass),
+          G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+          G_STRUCT_OFFSET (GstGLESSinkClass, replay_step_back), NULL, NULL,
+          g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+
+  /* shows the replay frame after the one shown, up to the newest */
+  gst_gles_sink_signals[SIGNAL_REPLAY_STEP_FORWARD] =
+      g_signal_new ("replay-step-forward", G_TYPE_FROM_CLASS (klass),
+          G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+          G_STRUCT_OFFSET (GstGLESSinkClass, replay_step_forward), NULL,
+          NULL, g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+
+  /* shows the stream again */
+  gst_gles_sink_signals[SIGNAL_REPLAY_LIVE] =
+      g_signal_new ("replay-live", G_TYPE_FROM_CLASS (klass),
+          G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+          G_STRUCT_OFFSET (GstGLESSinkClass, replay_live), NULL, NULL,
+          g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+
+  klass->replay_freeze = replay_freeze;
+  klass->replay_step_back = replay_step_back;
+  klass->replay_step_forward = replay_step_forward;
+  klass->replay_live = replay_live;
+
   /* initialise virtual methods */
   basesink_class->start = GST_DEBUG_FUNCPTR (gst_gles_sink_start);
   basesink_class->stop = GST_DEBUG_FUNCPTR (gst_gles_sink_stop);
+  basesink_class->unlock = GST_DEBUG_FUNCPTR (gst_gles_sink_unlock);
+  basesink_class->unlock_stop = GST_DEBUG_FUNCPTR (gst_gles_sink_unlock_stop);
   basesink_class->render = GST_DEBUG_FUNCPTR (gst_gles_sink_render);
   basesink_class->preroll = GST_DEBUG_FUNCPTR (gst_gles_sink_preroll);
   basesink_class->set_caps = GST_DEBUG_FUNCPTR (gst_gles_sink_set_caps);
+#if GST_CHECK_VERSION(1, 0, 0)
+  basesink_class->propose_allocation =
+      GST_DEBUG_FUNCPTR (gst_gles_sink_propose_allocation);
+#endif
+
+  element_class->provide_clock =
+      GST_DEBUG_FUNCPTR (gst_gles_sink_provide_clock);
 
 #if GST_CHECK_VERSION(1, 0, 0)
   gst_element_class_set_details_simple(element_class,
@@ -918,10 +2336,31 @@ gst_gles_sink_init (GstGLESSink * sink,
     sink->silent = FALSE;
     sink->gl_thread.gles.initialized = FALSE;
 
+    sink->clock = gst_gles_clock_new ("GstGLESClock");
+    sink->provide_clock = FALSE;
+    sink->texture_slots = DEFAULT_TEXTURE_SLOTS;
+    sink->scope_overlay = TRUE;
+    sink->scope_interval = 1;
+    sink->detect_duration = DEFAULT_DETECT_DURATION;
+    sink->autocrop_threshold = DEFAULT_AUTOCROP_THRESHOLD;
+    sink->autocrop_duration = DEFAULT_AUTOCROP_DURATION;
+    sink->motion_columns = DEFAULT_MOTION_COLUMNS;
+    sink->motion_rows = DEFAULT_MOTION_ROWS;
+    sink->motion_area = DEFAULT_MOTION_AREA;
+    sink->motion_hold = DEFAULT_MOTION_HOLD;
+    sink->privacy_block = DEFAULT_PRIVACY_BLOCK;
+    sink->text_font = g_strdup (DEFAULT_TEXT_FONT);
+    sink->text_scale = DEFAULT_TEXT_SCALE;
+    sink->replay_divisor = DEFAULT_REPLAY_DIVISOR;
+    sink->replay_budget = DEFAULT_REPLAY_BUDGET;
+    sink->sched.policy = sched_policy_from_name (NULL);
+    sink->sched.priority = DEFAULT_SCHED_PRIORITY;
+
     g_mutex_init(&thread->data_lock);
     g_mutex_init(&thread->render_lock);
     g_cond_init(&thread->data_signal);
     g_cond_init(&thread->render_signal);
+    repack_init (&thread->gles.repack, gl_repack_thread_init, sink);
 
     ret = XInitThreads();
     if (ret == 0) {
@@ -957,12 +2396,318 @@ gst_gles_sink_set_property (GObject * object, guint prop_id,
     case PROP_DROP_FIRST:
       filter->drop_first = g_value_get_uint (value);
       break;
+    case PROP_FULLSCREEN:
+      filter->fullscreen = g_value_get_boolean (value);
+      break;
+    case PROP_OUTPUT:
+      g_free (filter->output);
+      filter->output = g_value_dup_string (value);
+      break;
+    case PROP_DEVICE:
+      GST_OBJECT_LOCK (filter);
+      g_free (filter->device);
+      filter->device = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_PROVIDE_CLOCK:
+      GST_OBJECT_LOCK (filter);
+      filter->provide_clock = g_value_get_boolean (value);
+#if GST_CHECK_VERSION(1, 0, 0)
+      if (filter->provide_clock)
+        GST_OBJECT_FLAG_SET (filter, GST_ELEMENT_FLAG_PROVIDE_CLOCK);
+      else
+        GST_OBJECT_FLAG_UNSET (filter, GST_ELEMENT_FLAG_PROVIDE_CLOCK);
+#else
+      if (filter->provide_clock)
+        GST_OBJECT_FLAG_SET (filter, GST_ELEMENT_PROVIDE_CLOCK);
+      else
+        GST_OBJECT_FLAG_UNSET (filter, GST_ELEMENT_PROVIDE_CLOCK);
+#endif
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_DIRTY_TILES:
+      filter->dirty_tiles = g_value_get_boolean (value);
+      break;
+    case PROP_UPLOAD_THREAD:
+      filter->upload_thread = g_value_get_boolean (value);
+      break;
+    case PROP_TEXTURE_SLOTS:
+      filter->texture_slots = g_value_get_uint (value);
+      break;
+    case PROP_PACKED_UPLOAD:
+      filter->packed_upload = g_value_get_boolean (value);
+      break;
+    case PROP_REPACK_THREADS:
+      filter->repack_threads = g_value_get_uint (value);
+      break;
+    case PROP_WATCHDOG_TIMEOUT:
+      filter->watchdog_timeout = g_value_get_uint (value);
+      break;
+    case PROP_SCHED_POLICY: {
+      gint policy = sched_policy_from_name (g_value_get_string (value));
+
+      if (policy < 0)
+        GST_WARNING_OBJECT (filter, "Unknown scheduling policy %s",
+                            g_value_get_string (value));
+      else
+        filter->sched.policy = policy;
+      break;
+    }
+    case PROP_SCHED_PRIORITY:
+      filter->sched.priority = g_value_get_uint (value);
+      break;
+    case PROP_NICE:
+      filter->sched.nice = g_value_get_int (value);
+      break;
+    case PROP_CPU_AFFINITY:
+      filter->sched.affinity = g_value_get_uint64 (value);
+      break;
+    case PROP_GL_API: {
+      gint api = desktop_api_from_name (g_value_get_string (value));
+
+      if (api < 0)
+        GST_WARNING_OBJECT (filter, "Unknown GL api %s",
+                            g_value_get_string (value));
+      else
+        filter->gl_api = api;
+      break;
+    }
+    case PROP_CONVERT_PATH: {
+      gint path = compute_path_from_name (g_value_get_string (value));
+
+      if (path < 0)
+        GST_WARNING_OBJECT (filter, "Unknown convert path %s",
+                            g_value_get_string (value));
+      else
+        filter->convert_path = path;
+      break;
+    }
+    case PROP_FRAME_METRICS:
+      filter->frame_metrics = g_value_get_boolean (value);
+      break;
+    case PROP_SCOPES: {
+      gint scopes = scopes_from_string (g_value_get_string (value));
+
+      if (scopes < 0)
+        GST_WARNING_OBJECT (filter, "Unknown scope in %s",
+                            g_value_get_string (value));
+      else
+        filter->scopes = scopes;
+      break;
+    }
+    case PROP_SCOPE_OVERLAY:
+      filter->scope_overlay = g_value_get_boolean (value);
+      break;
+    case PROP_SCOPE_INTERVAL:
+      filter->scope_interval = g_value_get_uint (value);
+      break;
+    case PROP_SCOPE_MESSAGE_INTERVAL:
+      filter->scope_message_interval = g_value_get_uint (value);
+      break;
+    case PROP_BLACK_THRESHOLD:
+      GST_OBJECT_LOCK (filter);
+      filter->black_threshold = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_FREEZE_THRESHOLD:
+      GST_OBJECT_LOCK (filter);
+      filter->freeze_threshold = g_value_get_double (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_DETECT_DURATION:
+      GST_OBJECT_LOCK (filter);
+      filter->detect_duration = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_AUTOCROP:
+      filter->autocrop = g_value_get_boolean (value);
+      break;
+    case PROP_AUTOCROP_THRESHOLD:
+      filter->autocrop_threshold = g_value_get_uint (value);
+      break;
+    case PROP_AUTOCROP_DURATION:
+      GST_OBJECT_LOCK (filter);
+      filter->autocrop_duration = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_MOTION_THRESHOLD:
+      filter->motion_threshold = g_value_get_uint (value);
+      break;
+    case PROP_MOTION_GRID: {
+      guint columns, rows;
+
+      if (!motion_grid_parse (g_value_get_string (value), &columns, &rows)) {
+        GST_WARNING_OBJECT (filter, "Invalid motion grid %s",
+                            g_value_get_string (value));
+        break;
+      }
+      filter->motion_columns = columns;
+      filter->motion_rows = rows;
+      break;
+    }
+    case PROP_MOTION_ZONES: {
+      GstGLESZones zones;
+
+      if (!motion_zones_parse (&zones, g_value_get_string (value))) {
+        GST_WARNING_OBJECT (filter, "Invalid motion zones %s",
+                            g_value_get_string (value));
+        break;
+      }
+      GST_OBJECT_LOCK (filter);
+      g_free (filter->motion_zones.spec);
+      zones.spec = g_value_dup_string (value);
+      filter->motion_zones = zones;
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    }
+    case PROP_MOTION_AREA:
+      GST_OBJECT_LOCK (filter);
+      filter->motion_area = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_MOTION_HOLD:
+      GST_OBJECT_LOCK (filter);
+      filter->motion_hold = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_MOTION_OUTLINE:
+      filter->motion_outline = g_value_get_boolean (value);
+      break;
+    case PROP_PRIVACY_MASKS: {
+      GstGLESPrivacyMasks masks;
+
+      if (!privacy_masks_parse (&masks, g_value_get_string (value))) {
+        GST_WARNING_OBJECT (filter, "Invalid privacy masks %s",
+                            g_value_get_string (value));
+        break;
+      }
+      GST_OBJECT_LOCK (filter);
+      g_free (filter->privacy_masks.spec);
+      masks.spec = g_value_dup_string (value);
+      masks.generation = filter->privacy_masks.generation + 1;
+      filter->privacy_masks = masks;
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    }
+    case PROP_PRIVACY_BLOCK:
+      filter->privacy_block = g_value_get_uint (value);
+      break;
+    case PROP_TEXT:
+      GST_OBJECT_LOCK (filter);
+      g_free (filter->text);
+      filter->text = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_TEXT_FONT:
+      GST_OBJECT_LOCK (filter);
+      g_free (filter->text_font);
+      filter->text_font = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_TEXT_SCALE:
+      GST_OBJECT_LOCK (filter);
+      filter->text_scale = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_TEXT_POSITION: {
+      gint position = text_position_from_name (g_value_get_string (value));
+
+      if (position < 0)
+        GST_WARNING_OBJECT (filter, "Unknown text position %s",
+                            g_value_get_string (value));
+      else
+        filter->text_position = position;
+      break;
+    }
+    case PROP_REPLAY_FRAMES:
+      GST_OBJECT_LOCK (filter);
+      filter->replay_frames = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_REPLAY_DIVISOR:
+      GST_OBJECT_LOCK (filter);
+      filter->replay_divisor = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_REPLAY_BUDGET:
+      GST_OBJECT_LOCK (filter);
+      filter->replay_budget = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
 
+static GstStructure *
+gst_gles_sink_get_stats (GstGLESSink *sink)
+{
+  GstStructure *s;
+
+  GST_OBJECT_LOCK (sink);
+  s = gst_structure_new ("application/x-glessink-stats",
+      "rendered", G_TYPE_UINT64, sink->stats.rendered,
+      "presented", G_TYPE_UINT64, sink->stats.presented,
+      "skipped", G_TYPE_UINT64, sink->stats.skipped,
+      "latency", G_TYPE_UINT64, sink->stats.latency,
+      "average-latency", G_TYPE_UINT64, sink->stats.average_latency,
+      "refresh-interval", G_TYPE_UINT64, sink->stats.refresh_interval,
+      "msc", G_TYPE_UINT64, sink->stats.msc,
+      "last-presented", G_TYPE_UINT64, sink->stats.last_presented,
+      "uploaded-bytes", G_TYPE_UINT64, sink->stats.uploaded_bytes,
+      "skipped-bytes", G_TYPE_UINT64, sink->stats.skipped_bytes,
+      "unchanged", G_TYPE_UINT64, sink->stats.unchanged,
+      "decimated", G_TYPE_UINT64, sink->stats.decimated,
+      "flushes", G_TYPE_UINT64, sink->stats.flushes,
+      "flush-latency", G_TYPE_UINT64, sink->stats.flush_latency,
+      "slot-waits", G_TYPE_UINT64, sink->stats.slot_waits,
+      "repacked", G_TYPE_UINT64, sink->stats.repacked,
+      "involuntary-switches", G_TYPE_UINT64,
+          sink->stats.involuntary_switches,
+      "preempted-frames", G_TYPE_UINT64, sink->stats.preempted_frames,
+      "upload-involuntary-switches", G_TYPE_UINT64,
+          sink->stats.upload_involuntary_switches,
+      "stalls", G_TYPE_UINT64, sink->stats.stalls,
+      "watchdog-drops", G_TYPE_UINT64, sink->stats.watchdog_drops,
+      "context-losses", G_TYPE_UINT64, sink->stats.context_losses,
+      "recovery-time", G_TYPE_UINT64, sink->stats.recovery_time,
+      "device", G_TYPE_STRING, sink->device_in_use,
+      "renderer", G_TYPE_STRING, sink->renderer,
+      "fragment-frames", G_TYPE_UINT64,
+          sink->stats.pass_frames[GST_GLES_PASS_FRAGMENT_CONVERT],
+      "compute-frames", G_TYPE_UINT64,
+          sink->stats.pass_frames[GST_GLES_PASS_COMPUTE_CONVERT],
+      "fragment-convert-time", G_TYPE_UINT64,
+          sink->stats.pass_time[GST_GLES_PASS_FRAGMENT_CONVERT],
+      "compute-convert-time", G_TYPE_UINT64,
+          sink->stats.pass_time[GST_GLES_PASS_COMPUTE_CONVERT],
+      "fragment-reduce-time", G_TYPE_UINT64,
+          sink->stats.pass_time[GST_GLES_PASS_FRAGMENT_REDUCE],
+      "compute-reduce-time", G_TYPE_UINT64,
+          sink->stats.pass_time[GST_GLES_PASS_COMPUTE_REDUCE],
+      "luma-mean", G_TYPE_DOUBLE, sink->stats.luma_mean,
+      "luma-variance", G_TYPE_DOUBLE, sink->stats.luma_variance,
+      "luma-difference", G_TYPE_DOUBLE, sink->stats.luma_difference,
+      "black", G_TYPE_BOOLEAN, sink->stats.black,
+      "frozen", G_TYPE_BOOLEAN, sink->stats.frozen,
+      "black-events", G_TYPE_UINT64, sink->stats.black_events,
+      "freeze-events", G_TYPE_UINT64, sink->stats.freeze_events,
+      "crop-top", G_TYPE_UINT, sink->crop_top,
+      "crop-bottom", G_TYPE_UINT, sink->crop_bottom,
+      "crop-left", G_TYPE_UINT, sink->crop_left,
+      "crop-right", G_TYPE_UINT, sink->crop_right,
+      "autocrop-changes", G_TYPE_UINT64, sink->stats.autocrop_changes,
+      "motion-active", G_TYPE_UINT, sink->stats.motion_active,
+      "motion-events", G_TYPE_UINT64, sink->stats.motion_events,
+      "replay-frames", G_TYPE_UINT, sink->stats.replay_frames,
+      "replay-bytes", G_TYPE_UINT64, sink->stats.replay_bytes,
+      NULL);
+  GST_OBJECT_UNLOCK (sink);
+
+  return s;
+}
+
 static void
 gst_gles_sink_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec)
@@ -988,6 +2733,146 @@ gst_gles_sink_get_property (GObject * object, guint prop_id,
     case PROP_DROP_FIRST:
       g_value_set_uint (value, filter->drop_first);
       break;
+    case PROP_FULLSCREEN:
+      g_value_set_boolean (value, filter->fullscreen);
+      break;
+    case PROP_OUTPUT:
+      g_value_set_string (value, filter->output);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_gles_sink_get_stats (filter));
+      break;
+    case PROP_PROVIDE_CLOCK:
+      g_value_set_boolean (value, filter->provide_clock);
+      break;
+    case PROP_DIRTY_TILES:
+      g_value_set_boolean (value, filter->dirty_tiles);
+      break;
+    case PROP_UPLOAD_THREAD:
+      g_value_set_boolean (value, filter->upload_thread);
+      break;
+    case PROP_TEXTURE_SLOTS:
+      g_value_set_uint (value, filter->texture_slots);
+      break;
+    case PROP_PACKED_UPLOAD:
+      g_value_set_boolean (value, filter->packed_upload);
+      break;
+    case PROP_REPACK_THREADS:
+      g_value_set_uint (value, filter->repack_threads);
+      break;
+    case PROP_WATCHDOG_TIMEOUT:
+      g_value_set_uint (value, filter->watchdog_timeout);
+      break;
+    case PROP_SCHED_POLICY:
+      g_value_set_string (value, sched_policy_name (filter->sched.policy));
+      break;
+    case PROP_SCHED_PRIORITY:
+      g_value_set_uint (value, filter->sched.priority);
+      break;
+    case PROP_NICE:
+      g_value_set_int (value, filter->sched.nice);
+      break;
+    case PROP_CPU_AFFINITY:
+      g_value_set_uint64 (value, filter->sched.affinity);
+      break;
+    case PROP_GL_API:
+      g_value_set_string (value, desktop_api_name (filter->gl_api));
+      break;
+    case PROP_CONVERT_PATH:
+      g_value_set_string (value, compute_path_name (filter->convert_path));
+      break;
+    case PROP_FRAME_METRICS:
+      g_value_set_boolean (value, filter->frame_metrics);
+      break;
+    case PROP_SCOPES:
+      g_value_take_string (value, scopes_to_string (filter->scopes));
+      break;
+    case PROP_SCOPE_OVERLAY:
+      g_value_set_boolean (value, filter->scope_overlay);
+      break;
+    case PROP_SCOPE_INTERVAL:
+      g_value_set_uint (value, filter->scope_interval);
+      break;
+    case PROP_SCOPE_MESSAGE_INTERVAL:
+      g_value_set_uint (value, filter->scope_message_interval);
+      break;
+    case PROP_BLACK_THRESHOLD:
+      g_value_set_uint (value, filter->black_threshold);
+      break;
+    case PROP_FREEZE_THRESHOLD:
+      g_value_set_double (value, filter->freeze_threshold);
+      break;
+    case PROP_DETECT_DURATION:
+      g_value_set_uint (value, filter->detect_duration);
+      break;
+    case PROP_AUTOCROP:
+      g_value_set_boolean (value, filter->autocrop);
+      break;
+    case PROP_AUTOCROP_THRESHOLD:
+      g_value_set_uint (value, filter->autocrop_threshold);
+      break;
+    case PROP_AUTOCROP_DURATION:
+      g_value_set_uint (value, filter->autocrop_duration);
+      break;
+    case PROP_MOTION_THRESHOLD:
+      g_value_set_uint (value, filter->motion_threshold);
+      break;
+    case PROP_MOTION_GRID:
+      g_value_take_string (value, g_strdup_printf ("%ux%u",
+          filter->motion_columns, filter->motion_rows));
+      break;
+    case PROP_MOTION_ZONES:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_string (value, filter->motion_zones.spec);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_MOTION_AREA:
+      g_value_set_uint (value, filter->motion_area);
+      break;
+    case PROP_MOTION_HOLD:
+      g_value_set_uint (value, filter->motion_hold);
+      break;
+    case PROP_MOTION_OUTLINE:
+      g_value_set_boolean (value, filter->motion_outline);
+      break;
+    case PROP_PRIVACY_MASKS:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_string (value, filter->privacy_masks.spec);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_PRIVACY_BLOCK:
+      g_value_set_uint (value, filter->privacy_block);
+      break;
+    case PROP_TEXT:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_string (value, filter->text);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_TEXT_FONT:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_string (value, filter->text_font);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_TEXT_SCALE:
+      g_value_set_uint (value, filter->text_scale);
+      break;
+    case PROP_TEXT_POSITION:
+      g_value_set_string (value, text_position_name (filter->text_position));
+      break;
+    case PROP_REPLAY_FRAMES:
+      g_value_set_uint (value, filter->replay_frames);
+      break;
+    case PROP_REPLAY_DIVISOR:
+      g_value_set_uint (value, filter->replay_divisor);
+      break;
+    case PROP_REPLAY_BUDGET:
+      g_value_set_uint (value, filter->replay_budget);
+      break;
+    case PROP_DEVICE:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_string (value, filter->device);
+      GST_OBJECT_UNLOCK (filter);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1000,6 +2885,19 @@ gst_gles_sink_get_property (GObject * object, guint prop_id,
 static gboolean
 gst_gles_sink_start (GstBaseSink *basesink)
 {
+    GstGLESSink *sink = GST_GLES_SINK (basesink);
+
+    GST_OBJECT_LOCK (sink);
+    memset (&sink->stats, 0, sizeof (sink->stats));
+    sink->stats.flush_start = GST_CLOCK_TIME_NONE;
+    sink->stats.recovery_time = GST_CLOCK_TIME_NONE;
+    sink->replay_frozen = FALSE;
+    sink->replay_offset = 0;
+    GST_OBJECT_UNLOCK (sink);
+    detect_reset (sink);
+
+    sink->last_shown = GST_CLOCK_TIME_NONE;
+
     return TRUE;
 }
 
@@ -1027,8 +2925,11 @@ gst_gles_sink_set_caps (GstBaseSink *basesink, GstCaps *caps)
   guint display_par_d;
   gint par_n;
   gint par_d;
+  gint fps_n;
+  gint fps_d;
   gint w;
   gint h;
+  gint i;
 
 #if GST_CHECK_VERSION(1, 0, 0)
   GstVideoInfo info;
@@ -1043,19 +2944,49 @@ gst_gles_sink_set_caps (GstBaseSink *basesink, GstCaps *caps)
   h = info.height;
   par_n = info.par_n;
   par_d = info.par_d;
+  fps_n = info.fps_n;
+  fps_d = info.fps_d;
 #else
   if (!gst_video_format_parse_caps (caps, &fmt, &w, &h)) {
       GST_WARNING_OBJECT (sink, "pase_caps failed");
       return FALSE;
   }
 
+  if (!gst_video_parse_caps_framerate (caps, &fps_n, &fps_d)) {
+      fps_n = 0;
+      fps_d = 1;
+  }
+
   /* retrieve pixel aspect ratio of encoded video */
   if (!gst_video_parse_caps_pixel_aspect_ratio (caps, &par_n, &par_d)) {
       GST_WARNING_OBJECT (sink, "no pixel aspect ratio");
       return FALSE;
   }
 #endif
-  g_assert ((fmt == GST_VIDEO_FORMAT_I420));
+  if (fmt != GST_VIDEO_FORMAT_I420 && fmt != GST_VIDEO_FORMAT_NV12) {
+      GST_WARNING_OBJECT (sink, "Unsupported video format");
+      return FALSE;
+  }
+  sink->format = fmt;
+
+  /* plane layout of buffers that come without video meta */
+  for (i = 0; i < 3; i++) {
+#if GST_CHECK_VERSION(1, 0, 0)
+      sink->layout.offset[i] = GST_VIDEO_INFO_PLANE_OFFSET (&info, i);
+      sink->layout.stride[i] = GST_VIDEO_INFO_PLANE_STRIDE (&info, i);
+#else
+      sink->layout.offset[i] = gst_video_format_get_component_offset (fmt,
+          i, w, h);
+      sink->layout.stride[i] = gst_video_format_get_row_stride (fmt, i, w);
+#endif
+  }
+
+  /* let the clock advance one frame per refresh if the rates match */
+  if (fps_n > 0 && fps_d > 0)
+      gst_gles_clock_set_frame_duration (GST_GLES_CLOCK (sink->clock),
+          gst_util_uint64_scale_int (GST_SECOND, fps_d, fps_n));
+  else
+      gst_gles_clock_set_frame_duration (GST_GLES_CLOCK (sink->clock), 0);
 
   sink->video_width = w;
   sink->video_height = h;
@@ -1080,6 +3011,79 @@ gst_gles_sink_set_caps (GstBaseSink *basesink, GstCaps *caps)
   return TRUE;
 }
 
+#if GST_CHECK_VERSION(1, 0, 0)
+/*
+ * Offer a pool of buffers whose rows are padded to the unpack alignment,
+ * so every plane uploads with a single call whether or not
+ * EXT_unpack_subimage is available. The buffers carry a video meta
+ * describing the padded layout. */
+static gboolean
+gst_gles_sink_propose_allocation (GstBaseSink *basesink, GstQuery *query)
+{
+  GstGLESSink *sink = GST_GLES_SINK (basesink);
+  GstBufferPool *pool = NULL;
+  GstAllocationParams params;
+  GstVideoAlignment align;
+  GstStructure *config;
+  GstVideoInfo info;
+  GstCaps *caps;
+  gboolean need_pool;
+  guint min_buffers;
+  gint i;
+
+  gst_query_parse_allocation (query, &caps, &need_pool);
+  if (!caps) {
+    GST_DEBUG_OBJECT (sink, "No caps in the allocation query");
+    return FALSE;
+  }
+
+  if (!gst_video_info_from_caps (&info, caps)) {
+    GST_WARNING_OBJECT (sink, "Invalid caps in the allocation query");
+    return FALSE;
+  }
+
+  gst_video_alignment_reset (&align);
+  for (i = 0; i < GST_VIDEO_MAX_PLANES; i++)
+    align.stride_align[i] = GST_GLES_UNPACK_ALIGNMENT - 1;
+  gst_video_info_align (&info, &align);
+
+  /* the texture sets and the last frame keep buffers while the GPU and
+   * the duplicate detection may still need them */
+  min_buffers = sink->texture_slots + 2;
+
+  gst_allocation_params_init (&params);
+  params.align = GST_GLES_UNPACK_ALIGNMENT - 1;
+
+  if (need_pool) {
+    pool = gst_video_buffer_pool_new ();
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_set_params (config, caps, info.size,
+        min_buffers, 0);
+    gst_buffer_pool_config_set_allocator (config, NULL, &params);
+    gst_buffer_pool_config_add_option (config,
+        GST_BUFFER_POOL_OPTION_VIDEO_META);
+    gst_buffer_pool_config_add_option (config,
+        GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT);
+    gst_buffer_pool_config_set_video_alignment (config, &align);
+
+    if (!gst_buffer_pool_set_config (pool, config)) {
+      GST_WARNING_OBJECT (sink, "Could not configure the buffer pool");
+      gst_object_unref (pool);
+      return FALSE;
+    }
+  }
+
+  gst_query_add_allocation_pool (query, pool, info.size, min_buffers, 0);
+  gst_query_add_allocation_param (query, NULL, &params);
+  gst_query_add_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+
+  if (pool)
+    gst_object_unref (pool);
+
+  return TRUE;
+}
+#endif
+
 static GstFlowReturn
 gst_gles_sink_preroll (GstBaseSink * basesink, GstBuffer * buf)
 {
@@ -1101,11 +3105,13 @@ gst_gles_sink_preroll (GstBaseSink * basesink, GstBuffer * buf)
             goto fail;
         }
         GST_DEBUG_OBJECT(sink, "Wait for init GL context");
-	if (!thread->running) {
+        if (!thread->running)
             g_cond_wait (&thread->render_signal, &thread->render_lock);
-            g_mutex_unlock (&thread->render_lock);
-	}
+        g_mutex_unlock (&thread->render_lock);
         GST_DEBUG_OBJECT(sink, "Init completed");
+
+        if (!thread->running)
+            goto fail;
     }
 
     if (sink->dropped < sink->drop_first) {
@@ -1113,17 +3119,7 @@ gst_gles_sink_preroll (GstBaseSink * basesink, GstBuffer * buf)
         goto done;
     }
 
-    g_mutex_lock (&thread->data_lock);
-    thread->render_done = FALSE;
-    thread->buf = buf;
-    g_cond_signal (&thread->data_signal);
-    g_mutex_unlock (&thread->data_lock);
-
-    if (!thread->render_done) {
-        g_mutex_lock (&thread->render_lock);
-        g_cond_wait (&thread->render_signal, &thread->render_lock);
-        g_mutex_unlock (&thread->render_lock);
-    }
+    return gl_thread_render (sink, buf);
 
 done:
     return GST_FLOW_OK;
@@ -1133,11 +3129,67 @@ fail:
     return GST_FLOW_ERROR;
 }
 
+/*
+ * At rates above 1.0 several frames can fall into a single display
+ * refresh and all but the last would be replaced before anyone sees them.
+ * Returns TRUE if the buffer should be skipped before it gets uploaded. */
+static gboolean
+gst_gles_sink_decimate (GstGLESSink *sink, GstBuffer *buf)
+{
+    GstSegment *segment = &GST_BASE_SINK (sink)->segment;
+    GstClockTime timestamp = GST_BUFFER_TIMESTAMP (buf);
+    GstClockTime duration = GST_BUFFER_DURATION (buf);
+    GstClockTime running_time;
+    GstClockTime interval;
+    GstClockTime next_refresh;
+    gdouble rate = ABS (segment->rate);
+
+#if GST_CHECK_VERSION(1, 0, 0)
+    /* only key units are meant to be shown */
+    if ((segment->flags & GST_SEGMENT_FLAG_TRICKMODE_KEY_UNITS) &&
+        GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT))
+        return TRUE;
+#endif
+
+    if (rate <= 1.0 || segment->format != GST_FORMAT_TIME ||
+        !GST_CLOCK_TIME_IS_VALID (timestamp))
+        return FALSE;
+
+    running_time = gst_segment_to_running_time (segment, GST_FORMAT_TIME,
+                                                timestamp);
+    if (!GST_CLOCK_TIME_IS_VALID (running_time))
+        return FALSE;
+
+    GST_OBJECT_LOCK (sink);
+    interval = sink->stats.refresh_interval;
+    GST_OBJECT_UNLOCK (sink);
+
+    if (!interval)
+        interval = DEFAULT_REFRESH_INTERVAL;
+
+    if (GST_CLOCK_TIME_IS_VALID (duration)) {
+        /* the frame is visible only if a refresh happens before the
+         * next one is due */
+        next_refresh = gst_util_uint64_scale_ceil (running_time, 1,
+                                                   interval) * interval;
+        if (next_refresh >= running_time + (GstClockTime) (duration / rate))
+            return TRUE;
+    } else if (GST_CLOCK_TIME_IS_VALID (sink->last_shown) &&
+               running_time >= sink->last_shown &&
+               running_time - sink->last_shown < interval) {
+        /* without durations, keep one frame per refresh */
+        return TRUE;
+    }
+
+    sink->last_shown = running_time;
+    return FALSE;
+}
+
 static GstFlowReturn
 gst_gles_sink_render (GstBaseSink *basesink, GstBuffer *buf)
 {
     GstGLESSink *sink = GST_GLES_SINK (basesink);
-    GstGLESThread *thread = &sink->gl_thread;
+    GstFlowReturn ret = GST_FLOW_OK;
 
     GstClockTime start, stop;
 
@@ -1148,24 +3200,73 @@ gst_gles_sink_render (GstBaseSink *basesink, GstBuffer *buf)
         goto done;
     }
 
-    g_mutex_lock (&thread->data_lock);
-    thread->render_done = FALSE;
-    thread->buf = buf;
-    g_cond_signal (&thread->data_signal);
-    g_mutex_unlock (&thread->data_lock);
-
-    if (!thread->render_done) {
-        g_mutex_lock (&thread->render_lock);
-        g_cond_wait (&thread->render_signal, &thread->render_lock);
-        g_mutex_unlock (&thread->render_lock);
+    if (gst_gles_sink_decimate (sink, buf)) {
+        GST_LOG_OBJECT (sink, "Skip frame %" GST_TIME_FORMAT " at rate %f",
+                        GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buf)),
+                        basesink->segment.rate);
+        GST_OBJECT_LOCK (sink);
+        sink->stats.decimated++;
+        GST_OBJECT_UNLOCK (sink);
+        goto done;
     }
 
+    ret = gl_thread_render (sink, buf);
+
 done:
     stop = gst_util_get_timestamp();
     GST_DEBUG_OBJECT (basesink, "Render took %llu ms",
                         stop/GST_MSECOND - start/GST_MSECOND);
 
-    return GST_FLOW_OK;
+    return ret;
+}
+
+/* cancels a pending handoff to the gl thread, called on flush start */
+static gboolean
+gst_gles_sink_unlock (GstBaseSink *basesink)
+{
+    GstGLESSink *sink = GST_GLES_SINK (basesink);
+    GstGLESThread *thread = &sink->gl_thread;
+    gint i;
+
+    GST_DEBUG_OBJECT (sink, "Unlock, drop pending frame");
+
+    g_mutex_lock (&thread->data_lock);
+    gst_buffer_replace (&thread->buf, NULL);
+    for (i = 0; i < thread->gles.n_slots; i++) {
+        if (thread->gles.slots[i].state == SLOT_READY)
+            thread->gles.slots[i].state = SLOT_FREE;
+    }
+    thread->flush_count++;
+
+    g_mutex_lock (&thread->render_lock);
+    thread->flushing = TRUE;
+    g_cond_broadcast (&thread->render_signal);
+    g_mutex_unlock (&thread->render_lock);
+    g_mutex_unlock (&thread->data_lock);
+
+    GST_OBJECT_LOCK (sink);
+    sink->stats.flushes++;
+    sink->stats.flush_start = gst_util_get_timestamp ();
+    GST_OBJECT_UNLOCK (sink);
+
+    return TRUE;
+}
+
+static gboolean
+gst_gles_sink_unlock_stop (GstBaseSink *basesink)
+{
+    GstGLESSink *sink = GST_GLES_SINK (basesink);
+    GstGLESThread *thread = &sink->gl_thread;
+
+    g_mutex_lock (&thread->data_lock);
+    g_mutex_lock (&thread->render_lock);
+    thread->flushing = FALSE;
+    g_mutex_unlock (&thread->render_lock);
+    g_mutex_unlock (&thread->data_lock);
+
+    sink->last_shown = GST_CLOCK_TIME_NONE;
+
+    return TRUE;
 }
 
 static void
@@ -1174,6 +3275,44 @@ gst_gles_sink_finalize (GObject *gobject)
     GstGLESSink *plugin = (GstGLESSink *)gobject;
 
     gl_thread_stop (plugin);
+
+    g_free (plugin->output);
+    plugin->output = NULL;
+
+    g_free (plugin->device);
+    g_free (plugin->device_in_use);
+    g_free (plugin->renderer);
+    plugin->device = NULL;
+    plugin->device_in_use = NULL;
+    plugin->renderer = NULL;
+
+    g_free (plugin->motion_zones.spec);
+    plugin->motion_zones.spec = NULL;
+    g_free (plugin->privacy_masks.spec);
+    plugin->privacy_masks.spec = NULL;
+    g_free (plugin->text);
+    g_free (plugin->text_font);
+    plugin->text = NULL;
+    plugin->text_font = NULL;
+
+    if (plugin->clock) {
+        gst_object_unref (plugin->clock);
+        plugin->clock = NULL;
+    }
+}
+
+static GstClock *
+gst_gles_sink_provide_clock (GstElement *element)
+{
+    GstGLESSink *sink = GST_GLES_SINK (element);
+    GstClock *clock = NULL;
+
+    GST_OBJECT_LOCK (sink);
+    if (sink->provide_clock)
+        clock = GST_CLOCK_CAST (gst_object_ref (sink->clock));
+    GST_OBJECT_UNLOCK (sink);
+
+    return clock;
 }
 
 /* Overlay Interface implementation */
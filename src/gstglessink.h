@@ -30,9 +30,24 @@
 #include <X11/Xlib.h>
 
 #include <gst/gst.h>
+#include <gst/video/video.h>
 #include <gst/video/gstvideosink.h>
 
 #include "shader.h"
+#include "present.h"
+#include "upload.h"
+#include "repack.h"
+#include "rtsched.h"
+#include "desktop.h"
+#include "egldevice.h"
+#include "compute.h"
+#include "scopes.h"
+#include "detect.h"
+#include "autocrop.h"
+#include "motion.h"
+#include "privacy.h"
+#include "text.h"
+#include "replay.h"
 
 GST_DEBUG_CATEGORY_EXTERN (gst_gles_sink_debug);
 #define GST_CAT_DEFAULT gst_gles_sink_debug
@@ -57,6 +72,19 @@ typedef struct _GstGLESSinkClass   GstGLESSinkClass;
 typedef struct _GstGLESWindow      GstGLESWindow;
 typedef struct _GstGLESContext     GstGLESContext;
 typedef struct _GstGLESThread      GstGLESThread;
+typedef struct _GstGLESStats       GstGLESStats;
+typedef struct _GstGLESWatch       GstGLESWatch;
+typedef enum _GstGLESStage         GstGLESStage;
+
+/* parts of a frame the watchdog times */
+enum _GstGLESStage {
+    GL_STAGE_IDLE = 0,
+    GL_STAGE_UPLOAD,
+    GL_STAGE_CONVERT,
+    GL_STAGE_PRESENT,
+    GL_STAGE_FENCE,
+    GL_STAGE_RECOVER
+};
 
 struct _GstGLESWindow
 {
@@ -71,6 +99,9 @@ struct _GstGLESWindow
     Display *display;
     Window window;
     gboolean external_window;
+
+    /* presentation feedback */
+    GstGLESPresent present;
 };
 
 struct _GstGLESContext
@@ -82,19 +113,111 @@ struct _GstGLESContext
     EGLSurface surface;
     EGLContext context;
 
+    /* set if a selected device renders into a pbuffer instead of the
+     * window */
+    gboolean headless;
+
+    /* set if the context is desktop OpenGL 3.3 core instead of GLES 2.0 */
+    gboolean desktop;
+    GstGLESDesktop desktop_gl;
+
+    /* set if the GLES context is 3.1, asked for when the compute path is
+     * enabled */
+    gboolean es31;
+    GstGLESCompute compute;
+
+    /* video scopes of the converted frames */
+    GstGLESScopes scopes;
+
+    /* black border detection */
+    GstGLESAutocrop autocrop;
+
+    /* motion grid */
+    GstGLESMotion motion;
+
+    /* privacy masks applied by the conversion */
+    GstGLESPrivacy privacy;
+
+    /* text burn-in */
+    GstGLESText text;
+
+    /* instant replay ring */
+    GstGLESReplay replay;
+
+    /* formats of the single channel plane textures, luminance in GLES
+     * and red in desktop GL */
+    GLenum plane_format;
+    GLint plane_internal_format;
+
     /* shader programs */
     GstGLESShader deinterlace;
+    GstGLESShader deinterlace_packed;
+    GstGLESShader deinterlace_nv12;
     GstGLESShader scale;
 
-    /* textures for yuv input planes */
-    GstGLESTexture y_tex;
-    GstGLESTexture u_tex;
-    GstGLESTexture v_tex;
+    /* uniform locations of the packed conversion, packed is set if it
+     * has been loaded */
+    gboolean packed;
+    GLint packed_tex_loc;
+    GLint packed_size_loc;
+    GLint packed_tex_size_loc;
+
+    /* sampler locations of the yuv input planes */
+    GLint plane_loc[3];
+
+    /* NV12 chroma is uploaded into an rg texture if texture_rg is set,
+     * with the sampler locations of the luma and chroma planes */
+    gboolean texture_rg;
+    GLint nv12_loc[2];
+
+    /* ring of texture sets for the yuv input planes and the set the gl
+     * thread uploads to next */
+    GstGLESSlot slots[GST_GLES_MAX_SLOTS];
+    gint n_slots;
+    gint next_slot;
 
     GstGLESTexture rgb_tex;
 
     /* framebuffer object */
     GLuint framebuffer;
+
+    /* copy of the last uploaded frame and the part of the frame that
+     * changed with the last upload, used for dirty tile uploads */
+    guint8 *shadow;
+    gsize shadow_size;
+    GstGLESLayout shadow_layout;
+
+    /* conversion of frames the textures cannot take as they are */
+    GstGLESRepack repack;
+    GstVideoRectangle dirty;
+
+    /* window size and crop the last frame was presented with */
+    gint drawn_width;
+    gint drawn_height;
+    guint drawn_crop[4];
+
+    /* set when a swap failed, the context is rebuilt before the next
+     * frame */
+    gboolean lost;
+
+    /* optional extensions */
+    gboolean unpack_subimage;
+    gboolean fence_sync;
+
+    /* EGL_KHR_fence_sync entry points */
+    PFNEGLCREATESYNCKHRPROC create_sync;
+    PFNEGLDESTROYSYNCKHRPROC destroy_sync;
+    PFNEGLCLIENTWAITSYNCKHRPROC client_wait_sync;
+};
+
+/* stage a thread is in and since when, protected by the render_lock */
+struct _GstGLESWatch
+{
+    GstGLESStage stage;
+    gint64 since;
+
+    /* set once the watchdog reported the stage as stalled */
+    gboolean stalled;
 };
 
 struct _GstGLESThread
@@ -105,13 +228,128 @@ struct _GstGLESThread
     GCond data_signal;
     GMutex render_lock;
     GMutex data_lock;
-    volatile gboolean render_done;
     volatile gboolean running;
 
+    /* set from the start of the thread until it returns, protected by
+     * render_lock. a thread left behind stuck in the driver keeps it */
+    gboolean alive;
+
+    /* set while the sink is flushing, written with the data_lock and
+     * the render_lock held, taken in that order, so either protects
+     * reads */
+    gboolean flushing;
+
+    /* counts the flushes, protected by data_lock. an upload that saw
+     * another count when it took its buffer is dropped */
+    guint flush_count;
+
+    /* set to present the last frame again without a new one, protected
+     * by data_lock */
+    gboolean represent;
+
     GstGLESContext gles;
 
-    /* render data */
+    /* render data, buf and submitted are protected by data_lock,
+     * completed by render_lock */
     GstBuffer *buf;
+    GstClockTime pts;
+    guint64 submitted;
+    guint64 completed;
+
+    /* last converted buffer, only used by the gl thread. holding it
+     * keeps its memory from being reused while it is on screen */
+    GstBuffer *last_buf;
+
+    /* takes buf over from the gl thread while it is running */
+    GstGLESUploader uploader;
+
+    /* stages of the gl and the upload thread */
+    GstGLESWatch watch;
+    GstGLESWatch upload_watch;
+};
+
+struct _GstGLESStats
+{
+    /* frames handed to eglSwapBuffers */
+    guint64 rendered;
+    /* frames the display reported as shown or skipped */
+    guint64 presented;
+    guint64 skipped;
+
+    /* time from eglSwapBuffers to the frame reaching the screen */
+    GstClockTime latency;
+    GstClockTime average_latency;
+
+    /* measured duration of one display refresh */
+    GstClockTime refresh_interval;
+
+    /* vblank counter and monotonic time of the last presentation */
+    guint64 msc;
+    GstClockTime last_presented;
+
+    /* bytes uploaded and left out by the dirty tile upload */
+    guint64 uploaded_bytes;
+    guint64 skipped_bytes;
+
+    /* gap or duplicate frames shown without upload and conversion */
+    guint64 unchanged;
+
+    /* frames not drawn because they would not survive until the next
+     * refresh in trick modes */
+    guint64 decimated;
+
+    /* flushes and the time from the last one to the next shown frame */
+    guint64 flushes;
+    GstClockTime flush_latency;
+    GstClockTime flush_start;
+
+    /* uploads that had to wait for the GPU to release a texture set */
+    guint64 slot_waits;
+
+    /* frames converted on the cpu before the upload */
+    guint64 repacked;
+
+    /* involuntary context switches of the gl thread, frames during
+     * which it was preempted, and switches of the upload thread */
+    guint64 involuntary_switches;
+    guint64 preempted_frames;
+    guint64 upload_involuntary_switches;
+
+    /* stalls reported by the watchdog and the frames it dropped */
+    guint64 stalls;
+    guint64 watchdog_drops;
+
+    /* lost GL contexts and the time the last one took to restore */
+    guint64 context_losses;
+    GstClockTime recovery_time;
+
+    /* frames through the conversion and reduction passes on either path
+     * and the average GPU time of each, 0 without timer queries */
+    guint64 pass_frames[GST_GLES_PASSES];
+    GstClockTime pass_time[GST_GLES_PASSES];
+
+    /* luma of the last measured frame and its difference from the one
+     * before */
+    gdouble luma_mean;
+    gdouble luma_variance;
+    gdouble luma_difference;
+
+    /* detected black and frozen pictures, current state and count */
+    gboolean black;
+    gboolean frozen;
+    guint64 black_events;
+    guint64 freeze_events;
+
+    /* crops applied by the border detection */
+    guint64 autocrop_changes;
+
+    /* motion zones active and motion starts seen */
+    guint motion_active;
+    guint64 motion_events;
+
+    /* frames the replay ring holds and the texture memory it takes */
+    guint replay_frames;
+    guint64 replay_bytes;
 };
 
 struct _GstGLESSink
@@ -127,6 +365,10 @@ struct _GstGLESSink
   gint video_width;
   gint video_height;
 
+  /* format and plane layout of buffers without video meta */
+  GstVideoFormat format;
+  GstGLESLayout layout;
+
   /* properties */
   guint crop_top;
   guint crop_bottom;
@@ -135,17 +377,101 @@ struct _GstGLESSink
 
   gboolean silent;
 
+  gboolean fullscreen;
+  gchar *output;
+
+  /* selected EGL device, the device and renderer in use as reported
+   * after the context was created, protected by the object lock */
+  gchar *device;
+  gchar *device_in_use;
+  gchar *renderer;
+  gboolean dirty_tiles;
+  gboolean upload_thread;
+  guint texture_slots;
+  gboolean packed_upload;
+  guint repack_threads;
+  guint watchdog_timeout;
+  gint gl_api;
+  gint convert_path;
+  gboolean frame_metrics;
+  guint scopes;
+  gboolean scope_overlay;
+  guint scope_interval;
+  guint scope_message_interval;
+  guint black_threshold;
+  gdouble freeze_threshold;
+  guint detect_duration;
+  GstGLESDetect detect;
+  gboolean autocrop;
+  guint autocrop_threshold;
+  guint autocrop_duration;
+  guint motion_threshold;
+  guint motion_columns;
+  guint motion_rows;
+  guint motion_area;
+  guint motion_hold;
+  gboolean motion_outline;
+  GstGLESZones motion_zones;
+  GstGLESPrivacyMasks privacy_masks;
+  guint privacy_block;
+  gchar *text;
+  gchar *text_font;
+  guint text_scale;
+  gint text_position;
+  guint replay_frames;
+  guint replay_divisor;
+  guint replay_budget;
+  /* replay state set by the action signals, protected by the object
+   * lock */
+  gboolean replay_frozen;
+  guint replay_offset;
+  GstGLESSched sched;
+
+  /* clock following the display refresh */
+  GstClock *clock;
+  gboolean provide_clock;
+
   guint drop_first;
   guint dropped;
+
+  /* running time of the last frame drawn in trick mode */
+  GstClockTime last_shown;
+
+  /* protected by the object lock */
+  GstGLESStats stats;
 };
 
 struct _GstGLESSinkClass
 {
   GstVideoSinkClass basesinkclass;
+
+  /* action signals */
+  void (*replay_freeze) (GstGLESSink *sink);
+  void (*replay_step_back) (GstGLESSink *sink);
+  void (*replay_step_forward) (GstGLESSink *sink);
+  void (*replay_live) (GstGLESSink *sink);
 };
 
 GType gst_gles_sink_get_type (void);
 
+/* draws a quad from interleaved position and texture coordinates with
+ * the attributes of shader */
+void gl_draw_quad (GstGLESSink *sink, GstGLESShader *shader,
+                   const GLfloat *vertices, const GLushort *indices);
+
+/* draws n_quads quads in one call, four vertices and six indices each */
+void gl_draw_quads (GstGLESSink *sink, GstGLESShader *shader,
+                    const GLfloat *vertices, const GLushort *indices,
+                    gint n_quads);
+
+/* wakes the gl thread to present the last frame again if the window, the
+ * crop or the replayed frame changed since it was shown */
+void gl_thread_represent (GstGLESSink *sink);
+
+/* moves the watch of the calling thread to the next stage */
+void gl_watch_stage (GstGLESSink *sink, GstGLESWatch *watch,
+                     GstGLESStage stage);
+
 G_END_DECLS
 
 #endif /* _GST_GLES_SINK_H__ */
@@ -0,0 +1,498 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <gst/gst.h>
+
+#include "gstglessink.h"
+#include "shader.h"
+#include "motion.h"
+
+/* parses a fraction of the frame, returns FALSE if it is not one */
+static gboolean
+motion_parse_fraction (const gchar *str, gdouble *value)
+{
+    gchar *end;
+
+    *value = g_ascii_strtod (str, &end);
+    return end != str && !*end && *value >= 0 && *value <= 1;
+}
+
+gboolean
+motion_zones_parse (GstGLESZones *zones, const gchar *spec)
+{
+    gchar **list;
+    gboolean ok = TRUE;
+    guint n = 0;
+    gint i;
+
+    memset (zones->zone, 0, sizeof (zones->zone));
+    zones->n_zones = 0;
+    if (!spec)
+        return TRUE;
+
+    list = g_strsplit (spec, ";", -1);
+    for (i = 0; list[i] && ok; i++) {
+        gchar **fields = g_strsplit (g_strstrip (list[i]), ",", -1);
+        guint n_fields = g_strv_length (fields);
+        GstGLESZone *zone = &zones->zone[n];
+        guint j;
+
+        if (!*list[i]) {
+            g_strfreev (fields);
+            continue;
+        }
+
+        ok = n < MOTION_MAX_ZONES && (n_fields == 4 || n_fields == 5);
+        for (j = 0; ok && j < n_fields; j++)
+            g_strstrip (fields[j]);
+
+        ok = ok && motion_parse_fraction (fields[0], &zone->x) &&
+             motion_parse_fraction (fields[1], &zone->y) &&
+             motion_parse_fraction (fields[2], &zone->width) &&
+             motion_parse_fraction (fields[3], &zone->height) &&
+             zone->width > 0 && zone->height > 0;
+
+        if (ok && n_fields == 5) {
+            gchar *end;
+
+            zone->area = strtoul (fields[4], &end, 10);
+            ok = end != fields[4] && !*end && zone->area <= 100;
+        }
+        g_strfreev (fields);
+        n++;
+    }
+    g_strfreev (list);
+
+    if (!ok) {
+        memset (zones->zone, 0, sizeof (zones->zone));
+        return FALSE;
+    }
+
+    zones->n_zones = n;
+    return TRUE;
+}
+
+gboolean
+motion_grid_parse (const gchar *spec, guint *columns, guint *rows)
+{
+    gchar end;
+
+    return spec && sscanf (spec, "%ux%u%c", columns, rows, &end) == 2 &&
+           *columns > 0 && *columns <= MOTION_MAX_GRID &&
+           *rows > 0 && *rows <= MOTION_MAX_GRID;
+}
+
+static GLuint
+motion_create_texture (void)
+{
+    GLuint tex = 0;
+
+    glGenTextures (1, &tex);
+    glBindTexture (GL_TEXTURE_2D, tex);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    return tex;
+}
+
+void
+motion_init (GstGLESSink *sink)
+{
+    GstGLESMotion *motion = &sink->gl_thread.gles.motion;
+    gint i;
+
+    motion->available = FALSE;
+    motion->columns = 0;
+    motion->rows = 0;
+    motion->history_valid = FALSE;
+    motion->next = 0;
+
+    if (gl_init_shader (GST_ELEMENT (sink), &motion->diff,
+                        SHADER_MOTION_DIFF) < 0 ||
+        gl_init_shader (GST_ELEMENT (sink), &motion->outline,
+                        SHADER_COPY_MOTION) < 0) {
+        GST_WARNING_OBJECT (sink, "Could not initialize the motion "
+                            "shaders, motion is not detected");
+        gl_delete_shader (&motion->diff);
+        gl_delete_shader (&motion->outline);
+        return;
+    }
+
+    motion->diff_tex_loc = glGetUniformLocation (motion->diff.program,
+                                                 "s_tex");
+    motion->diff_history_loc = glGetUniformLocation (motion->diff.program,
+                                                     "s_history");
+    motion->diff_grid_loc = glGetUniformLocation (motion->diff.program,
+                                                  "grid");
+    motion->outline_tex_loc = glGetUniformLocation (motion->outline.program,
+                                                    "s_tex");
+    motion->outline_mask_loc = glGetUniformLocation (motion->outline.program,
+                                                     "s_mask");
+    motion->outline_grid_loc = glGetUniformLocation (motion->outline.program,
+                                                     "grid");
+    motion->outline_edge_loc = glGetUniformLocation (motion->outline.program,
+                                                     "edge");
+
+    motion->history_tex = motion_create_texture ();
+    glGenFramebuffers (1, &motion->history_framebuffer);
+    for (i = 0; i < 2; i++) {
+        motion->grid_tex[i] = motion_create_texture ();
+        motion->grid_pending[i] = FALSE;
+    }
+    glGenFramebuffers (2, motion->grid_framebuffer);
+    motion->mask_tex = motion_create_texture ();
+
+    motion->available = TRUE;
+}
+
+void
+motion_close (GstGLESSink *sink)
+{
+    GstGLESMotion *motion = &sink->gl_thread.gles.motion;
+
+    if (motion->available) {
+        gl_delete_shader (&motion->diff);
+        gl_delete_shader (&motion->outline);
+        glDeleteFramebuffers (1, &motion->history_framebuffer);
+        glDeleteTextures (1, &motion->history_tex);
+        glDeleteFramebuffers (2, motion->grid_framebuffer);
+        glDeleteTextures (2, motion->grid_tex);
+        glDeleteTextures (1, &motion->mask_tex);
+    }
+    motion->available = FALSE;
+
+    g_free (motion->grid);
+    motion->grid = NULL;
+    g_free (motion->mask);
+    motion->mask = NULL;
+}
+
+/* attaches tex, sized width x height, to framebuffer */
+static void
+motion_alloc_target (GLuint framebuffer, GLuint tex, gint width,
+                     gint height)
+{
+    glBindTexture (GL_TEXTURE_2D, tex);
+    glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+                  GL_UNSIGNED_BYTE, NULL);
+
+    glBindFramebuffer (GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D (GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_TEXTURE_2D, tex, 0);
+}
+
+/* sizes the targets for the grid of the motion_grid property, dropping
+ * the history and the pending grids if it changed */
+static void
+motion_alloc (GstGLESSink *sink)
+{
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    GstGLESMotion *motion = &gles->motion;
+    gint columns = sink->motion_columns;
+    gint rows = sink->motion_rows;
+    gint i;
+
+    if (motion->columns == columns && motion->rows == rows)
+        return;
+
+    motion_alloc_target (motion->history_framebuffer, motion->history_tex,
+                         columns * MOTION_SAMPLES, rows * MOTION_SAMPLES);
+    for (i = 0; i < 2; i++) {
+        motion_alloc_target (motion->grid_framebuffer[i], motion->grid_tex[i],
+                             columns, rows);
+        motion->grid_pending[i] = FALSE;
+    }
+
+    g_free (motion->grid);
+    motion->grid = g_malloc ((gsize) columns * rows * 4);
+    g_free (motion->mask);
+    motion->mask = g_malloc0 ((gsize) columns * rows);
+
+    glBindTexture (GL_TEXTURE_2D, motion->mask_tex);
+    glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D (GL_TEXTURE_2D, 0, gles->plane_internal_format, columns,
+                  rows, 0, gles->plane_format, GL_UNSIGNED_BYTE, motion->mask);
+
+    motion->columns = columns;
+    motion->rows = rows;
+    motion->history_valid = FALSE;
+}
+
+static void
+motion_post (GstGLESSink *sink, guint zone, gboolean active,
+             GstClockTime timestamp, gdouble activity)
+{
+    GST_INFO_OBJECT (sink, "Motion in zone %u %s at %" GST_TIME_FORMAT,
+                     zone, active ? "started" : "stopped",
+                     GST_TIME_ARGS (timestamp));
+
+    gst_element_post_message (GST_ELEMENT (sink),
+        gst_message_new_element (GST_OBJECT (sink),
+            gst_structure_new ("glessink-motion",
+                "zone", G_TYPE_UINT, zone,
+                "active", G_TYPE_BOOLEAN, active,
+                "timestamp", G_TYPE_UINT64, timestamp,
+                "activity", G_TYPE_DOUBLE, activity,
+                NULL)));
+}
+
+/* share of the cells with their center in zone that are set in mask,
+ * mask rows run bottom up */
+static gdouble
+motion_zone_activity (const GstGLESZone *zone, const guint8 *mask,
+                      gint columns, gint rows)
+{
+    guint cells = 0;
+    guint moving = 0;
+    gint x, y;
+
+    for (y = 0; y < rows; y++) {
+        gdouble cy = 1.0 - (y + 0.5) / rows;
+
+        if (cy < zone->y || cy >= zone->y + zone->height)
+            continue;
+
+        for (x = 0; x < columns; x++) {
+            gdouble cx = (x + 0.5) / columns;
+
+            if (cx < zone->x || cx >= zone->x + zone->width)
+                continue;
+            cells++;
+            moving += mask[y * columns + x] != 0;
+        }
+    }
+
+    return cells ? (gdouble) moving / cells : 0;
+}
+
+/*
+ * Motion in a zone starts as soon as the share of its moving cells
+ * reaches its area and stops once it stayed below for motion_hold ms, so
+ * short pauses do not end it. Without zones the whole frame is zone 0.
+ * mask is NULL for frames identical to the one before. Posts the changes,
+ * must be called without the object lock.
+ */
+static void
+motion_decide (GstGLESSink *sink, const guint8 *mask, gint columns,
+               gint rows, GstClockTime timestamp)
+{
+    GstGLESZones *zones = &sink->motion_zones;
+    GstGLESZone whole = { 0, 0, 1, 1, 0, FALSE, 0, 0 };
+    gboolean changed[MOTION_MAX_ZONES];
+    gdouble activity[MOTION_MAX_ZONES];
+    gboolean active[MOTION_MAX_ZONES];
+    gint64 now = g_get_monotonic_time ();
+    gint64 hold;
+    guint n, i;
+
+    GST_OBJECT_LOCK (sink);
+    hold = (gint64) sink->motion_hold * G_TIME_SPAN_MILLISECOND;
+
+    /* zone 0 keeps the state of the whole frame when there are no zones */
+    n = MAX (zones->n_zones, 1);
+    if (!zones->n_zones) {
+        whole.active = zones->zone[0].active;
+        whole.last_motion = zones->zone[0].last_motion;
+        zones->zone[0] = whole;
+    }
+
+    sink->stats.motion_active = 0;
+    for (i = 0; i < n; i++) {
+        GstGLESZone *zone = &zones->zone[i];
+        guint area = zone->area ? zone->area : sink->motion_area;
+        gboolean moving;
+
+        zone->activity = mask ?
+            motion_zone_activity (zone, mask, columns, rows) : 0;
+        moving = zone->activity > 0 && zone->activity * 100 >= area;
+        if (moving)
+            zone->last_motion = now;
+
+        changed[i] = FALSE;
+        if (moving && !zone->active) {
+            zone->active = TRUE;
+            changed[i] = TRUE;
+            sink->stats.motion_events++;
+        } else if (!moving && zone->active && now - zone->last_motion >= hold) {
+            zone->active = FALSE;
+            changed[i] = TRUE;
+        }
+
+        activity[i] = zone->activity;
+        active[i] = zone->active;
+        sink->stats.motion_active += zone->active;
+    }
+    GST_OBJECT_UNLOCK (sink);
+
+    for (i = 0; i < n; i++) {
+        if (changed[i])
+            motion_post (sink, i, active[i], timestamp, activity[i]);
+    }
+}
+
+/* thresholds the grid read back into the mask and decides the zones */
+static void
+motion_read_grid (GstGLESSink *sink, gint i)
+{
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    GstGLESMotion *motion = &gles->motion;
+    gint cells = motion->columns * motion->rows;
+    guint threshold = sink->motion_threshold;
+    gint c;
+
+    glBindFramebuffer (GL_FRAMEBUFFER, motion->grid_framebuffer[i]);
+    glReadPixels (0, 0, motion->columns, motion->rows, GL_RGBA,
+                  GL_UNSIGNED_BYTE, motion->grid);
+    motion->grid_pending[i] = FALSE;
+
+    for (c = 0; c < cells; c++)
+        motion->mask[c] = motion->grid[c * 4] > threshold ? 255 : 0;
+
+    if (sink->motion_outline) {
+        glBindTexture (GL_TEXTURE_2D, motion->mask_tex);
+        glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0, motion->columns,
+                         motion->rows, gles->plane_format, GL_UNSIGNED_BYTE,
+                         motion->mask);
+    }
+
+    motion_decide (sink, motion->mask, motion->columns, motion->rows,
+                   motion->grid_pts[i]);
+}
+
+void
+motion_update (GstGLESSink *sink)
+{
+    GLfloat vVertices[] =
+    {
+        -1.0f, -1.0f,
+        0.0f, 0.0f,
+
+        1.0f, -1.0f,
+        1.0f, 0.0f,
+
+        1.0f, 1.0f,
+        1.0f, 1.0f,
+
+        -1.0f, 1.0f,
+        0.0f, 1.0f,
+    };
+    GLushort indices[] = { 0, 1, 2, 0, 2, 3 };
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    GstGLESMotion *motion = &gles->motion;
+    gint i = motion->next;
+
+    if (!sink->motion_threshold || !motion->available)
+        return;
+
+    motion_alloc (sink);
+
+    /* the grid of the frame before is done by now, reading it does not
+     * wait for the current frame */
+    if (motion->grid_pending[!i])
+        motion_read_grid (sink, !i);
+
+    glActiveTexture (GL_TEXTURE3);
+    glBindTexture (GL_TEXTURE_2D, gles->rgb_tex.id);
+
+    if (motion->history_valid) {
+        glBindFramebuffer (GL_FRAMEBUFFER, motion->grid_framebuffer[i]);
+        glViewport (0, 0, motion->columns, motion->rows);
+
+        glUseProgram (motion->diff.program);
+        glActiveTexture (GL_TEXTURE4);
+        glBindTexture (GL_TEXTURE_2D, motion->history_tex);
+        glUniform1i (motion->diff_tex_loc, 3);
+        glUniform1i (motion->diff_history_loc, 4);
+        glUniform2f (motion->diff_grid_loc, motion->columns, motion->rows);
+        gl_draw_quad (sink, &motion->diff, vVertices, indices);
+        glActiveTexture (GL_TEXTURE3);
+
+        motion->grid_pending[i] = TRUE;
+        motion->grid_pts[i] = sink->gl_thread.pts;
+        motion->next = !i;
+    }
+
+    /* the current frame becomes the history of the next one */
+    glBindFramebuffer (GL_FRAMEBUFFER, motion->history_framebuffer);
+    glViewport (0, 0, motion->columns * MOTION_SAMPLES,
+                motion->rows * MOTION_SAMPLES);
+    glUseProgram (gles->scale.program);
+    glUniform1i (gles->rgb_tex.loc, 3);
+    gl_draw_quad (sink, &gles->scale, vVertices, indices);
+    motion->history_valid = TRUE;
+
+    glBindFramebuffer (GL_FRAMEBUFFER, gles->framebuffer);
+}
+
+void
+motion_unchanged (GstGLESSink *sink, GstClockTime timestamp)
+{
+    if (!sink->motion_threshold)
+        return;
+
+    motion_decide (sink, NULL, 0, 0, timestamp);
+}
+
+GstGLESShader *
+motion_outline_shader (GstGLESSink *sink, const GstVideoRectangle *rect)
+{
+    GstGLESMotion *motion = &sink->gl_thread.gles.motion;
+    gint visible_width = sink->video_width - sink->crop_left -
+                         sink->crop_right;
+    gint visible_height = sink->video_height - sink->crop_top -
+                          sink->crop_bottom;
+    gfloat cell_width;
+    gfloat cell_height;
+
+    if (!sink->motion_threshold || !sink->motion_outline ||
+        !motion->available || !motion->columns || visible_width <= 0 ||
+        visible_height <= 0)
+        return NULL;
+
+    /* outlines two pixels wide on screen */
+    cell_width = (gfloat) rect->w * sink->video_width /
+                 (visible_width * motion->columns);
+    cell_height = (gfloat) rect->h * sink->video_height /
+                  (visible_height * motion->rows);
+
+    glUseProgram (motion->outline.program);
+    glActiveTexture (GL_TEXTURE4);
+    glBindTexture (GL_TEXTURE_2D, motion->mask_tex);
+    glUniform1i (motion->outline_tex_loc, 3);
+    glUniform1i (motion->outline_mask_loc, 4);
+    glUniform2f (motion->outline_grid_loc, motion->columns, motion->rows);
+    glUniform2f (motion->outline_edge_loc, 2.0f / MAX (cell_width, 2.0f),
+                 2.0f / MAX (cell_height, 2.0f));
+
+    return &motion->outline;
+}
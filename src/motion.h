@@ -0,0 +1,151 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef _MOTION_H__
+#define _MOTION_H__
+
+#include <glib.h>
+#include <gst/gst.h>
+#include <gst/video/gstvideosink.h>
+
+#include <GLES2/gl2.h>
+
+#include "shader.h"
+
+/* samples per cell edge the difference is taken at */
+#define MOTION_SAMPLES 8
+
+/* largest grid edge and number of zones */
+#define MOTION_MAX_GRID 64
+#define MOTION_MAX_ZONES 16
+
+typedef struct _GstGLESZone        GstGLESZone;
+typedef struct _GstGLESZones       GstGLESZones;
+typedef struct _GstGLESMotion      GstGLESMotion;
+
+/* part of the frame watched for motion, in fractions of the frame from
+ * the top left, and its state */
+struct _GstGLESZone
+{
+    gdouble x;
+    gdouble y;
+    gdouble width;
+    gdouble height;
+
+    /* percentage of the cells of the zone that have to move, 0 to use
+     * the motion_area property */
+    guint area;
+
+    /* motion reported, share of moving cells last measured and the
+     * monotonic time motion was last seen */
+    gboolean active;
+    gdouble activity;
+    gint64 last_motion;
+};
+
+/* zones of the motion_zones property, the whole frame if there are
+ * none, protected by the object lock */
+struct _GstGLESZones
+{
+    gchar *spec;
+    GstGLESZone zone[MOTION_MAX_ZONES];
+    guint n_zones;
+};
+
+/*
+ * Motion grid of the gl thread. Every converted frame is compared with
+ * a copy of the frame before, kept at MOTION_SAMPLES texels per cell, and
+ * reduced to the mean luma difference of each cell. The grid is read
+ * back one frame late from alternating targets.
+ */
+struct _GstGLESMotion
+{
+    /* set if the programs linked */
+    gboolean available;
+    GstGLESShader diff;
+    GLint diff_tex_loc;
+    GLint diff_history_loc;
+    GLint diff_grid_loc;
+
+    /* the scale pass with cell outlines */
+    GstGLESShader outline;
+    GLint outline_tex_loc;
+    GLint outline_mask_loc;
+    GLint outline_grid_loc;
+    GLint outline_edge_loc;
+
+    /* grid size the targets are allocated for */
+    gint columns;
+    gint rows;
+
+    /* the frame before at sample size, unset until it holds one */
+    GLuint history_framebuffer;
+    GLuint history_tex;
+    gboolean history_valid;
+
+    /* difference targets with the timestamp of the frame drawn into
+     * each, read back with the next frame */
+    GLuint grid_framebuffer[2];
+    GLuint grid_tex[2];
+    gboolean grid_pending[2];
+    GstClockTime grid_pts[2];
+    gint next;
+    guint8 *grid;
+
+    /* moving cells of the last grid read, for the outlines */
+    GLuint mask_tex;
+    guint8 *mask;
+};
+
+struct _GstGLESSink;
+
+/* parses zones of the form x,y,width,height[,area] separated by
+ * semicolons, returns FALSE if the spec is malformed */
+gboolean
+motion_zones_parse (GstGLESZones *zones, const gchar *spec);
+
+/* parses a grid of the form COLUMNSxROWS, returns FALSE if it is
+ * malformed or too large */
+gboolean
+motion_grid_parse (const gchar *spec, guint *columns, guint *rows);
+
+/* links the programs in the current context */
+void
+motion_init (struct _GstGLESSink *sink);
+void
+motion_close (struct _GstGLESSink *sink);
+
+/* compares the converted frame with the frame before and reports the
+ * zones whose motion started or stopped on the grid read back */
+void
+motion_update (struct _GstGLESSink *sink);
+
+/* feeds a frame identical to the one before, which shows no motion */
+void
+motion_unchanged (struct _GstGLESSink *sink, GstClockTime timestamp);
+
+/* binds the scale program drawing outlines around moving cells for a
+ * frame shown in rect, returns NULL if no outlines are drawn */
+GstGLESShader *
+motion_outline_shader (struct _GstGLESSink *sink,
+                       const GstVideoRectangle *rect);
+#endif
@@ -0,0 +1,281 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * The time eglSwapBuffers returns says little about when the frame hits
+ * the screen. The X Present extension sends a CompleteNotify event with
+ * the vblank counter (msc) and its monotonic timestamp (ust) for every
+ * presentation on our window, including the ones the EGL driver issues.
+ * The events are matched in submission order to the frames we swapped.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <glib.h>
+
+#define GST_USE_UNSTABLE_API
+#include <gst/gst.h>
+
+#ifdef HAVE_X11_PRESENT
+#include <X11/Xlib-xcb.h>
+#include <xcb/present.h>
+#endif
+
+#include "gstglessink.h"
+#include "gstglesclock.h"
+#include "present.h"
+
+/* swaps we keep track of without getting any completion for them */
+#define PRESENT_MAX_PENDING 8
+
+typedef struct _GstGLESPresentFrame GstGLESPresentFrame;
+
+struct _GstGLESPresentFrame
+{
+    GstClockTime pts;
+    gint64 submit_time;
+};
+
+#ifdef HAVE_X11_PRESENT
+gint
+present_init (GstGLESSink *sink)
+{
+    GstGLESPresent *present = &sink->x11.present;
+    xcb_connection_t *connection;
+    xcb_present_query_version_cookie_t cookie;
+    xcb_present_query_version_reply_t *reply;
+    const xcb_query_extension_reply_t *ext;
+
+    g_queue_init (&present->pending);
+    present->available = FALSE;
+    present->msc = 0;
+    present->ust = 0;
+
+    connection = XGetXCBConnection (sink->x11.display);
+    if (!connection) {
+        GST_WARNING_OBJECT (sink, "No xcb connection for the X display");
+        return -1;
+    }
+
+    ext = xcb_get_extension_data (connection, &xcb_present_id);
+    if (!ext || !ext->present) {
+        GST_INFO_OBJECT (sink, "Present extension not available, "
+                         "presentation times are estimated");
+        return -1;
+    }
+
+    cookie = xcb_present_query_version (connection,
+                                        XCB_PRESENT_MAJOR_VERSION,
+                                        XCB_PRESENT_MINOR_VERSION);
+    reply = xcb_present_query_version_reply (connection, cookie, NULL);
+    if (!reply) {
+        GST_WARNING_OBJECT (sink, "Could not query Present version");
+        return -1;
+    }
+
+    GST_DEBUG_OBJECT (sink, "Have Present version: %u.%u",
+                      reply->major_version, reply->minor_version);
+    free (reply);
+
+    present->eid = xcb_generate_id (connection);
+    present->special_event =
+            xcb_register_for_special_xge (connection, &xcb_present_id,
+                                          present->eid, NULL);
+    xcb_present_select_input (connection, present->eid, sink->x11.window,
+                              XCB_PRESENT_EVENT_MASK_COMPLETE_NOTIFY);
+    xcb_flush (connection);
+
+    present->connection = connection;
+    present->available = TRUE;
+
+    return 0;
+}
+
+void
+present_close (GstGLESSink *sink)
+{
+    GstGLESPresent *present = &sink->x11.present;
+
+    if (present->available) {
+        xcb_present_select_input (present->connection, present->eid,
+                                  sink->x11.window, 0);
+        xcb_unregister_for_special_event (present->connection,
+                                          present->special_event);
+        xcb_flush (present->connection);
+
+        present->special_event = NULL;
+        present->connection = NULL;
+        present->available = FALSE;
+    }
+
+    while (!g_queue_is_empty (&present->pending))
+        g_slice_free (GstGLESPresentFrame,
+                      g_queue_pop_head (&present->pending));
+}
+
+static void
+present_complete (GstGLESSink *sink, xcb_present_complete_notify_event_t *ev)
+{
+    GstGLESPresent *present = &sink->x11.present;
+    GstGLESStats *stats = &sink->stats;
+    GstGLESPresentFrame *frame;
+
+    /* NotifyMSC completions are not tied to any of our frames */
+    if (ev->kind != XCB_PRESENT_COMPLETE_KIND_PIXMAP)
+        return;
+
+    frame = g_queue_pop_head (&present->pending);
+
+    GST_OBJECT_LOCK (sink);
+    if (present->ust && ev->msc > present->msc && ev->ust > present->ust) {
+        GstClockTime interval = (ev->ust - present->ust) * GST_USECOND /
+                                (ev->msc - present->msc);
+
+        if (stats->refresh_interval)
+            stats->refresh_interval =
+                    (stats->refresh_interval * 7 + interval) / 8;
+        else
+            stats->refresh_interval = interval;
+    }
+
+    if (ev->mode == XCB_PRESENT_COMPLETE_MODE_SKIP) {
+        stats->skipped++;
+    } else {
+        stats->presented++;
+        stats->msc = ev->msc;
+        stats->last_presented = ev->ust * GST_USECOND;
+
+        if (frame && ev->ust >= frame->submit_time) {
+            stats->latency = (ev->ust - frame->submit_time) * GST_USECOND;
+            if (stats->average_latency)
+                stats->average_latency =
+                        (stats->average_latency * 7 + stats->latency) / 8;
+            else
+                stats->average_latency = stats->latency;
+        }
+    }
+    GST_OBJECT_UNLOCK (sink);
+
+    if (ev->mode != XCB_PRESENT_COMPLETE_MODE_SKIP)
+        gst_gles_clock_add_vblank (GST_GLES_CLOCK (sink->clock),
+                                   ev->ust * GST_USECOND, ev->msc);
+
+    GST_LOG_OBJECT (sink, "Frame %" GST_TIME_FORMAT " completed, msc %"
+                    G_GUINT64_FORMAT " ust %" G_GUINT64_FORMAT " mode %u",
+                    GST_TIME_ARGS (frame ? frame->pts : GST_CLOCK_TIME_NONE),
+                    (guint64) ev->msc, (guint64) ev->ust, ev->mode);
+
+    present->msc = ev->msc;
+    present->ust = ev->ust;
+
+    if (frame)
+        g_slice_free (GstGLESPresentFrame, frame);
+}
+
+void
+present_handle_events (GstGLESSink *sink)
+{
+    GstGLESPresent *present = &sink->x11.present;
+    xcb_generic_event_t *ev;
+
+    if (!present->available)
+        return;
+
+    while ((ev = xcb_poll_for_special_event (present->connection,
+                                             present->special_event))) {
+        xcb_present_generic_event_t *ge = (xcb_present_generic_event_t *) ev;
+
+        if (ge->evtype == XCB_PRESENT_EVENT_COMPLETE_NOTIFY)
+            present_complete (sink,
+                              (xcb_present_complete_notify_event_t *) ev);
+        free (ev);
+    }
+}
+#else
+gint
+present_init (GstGLESSink *sink)
+{
+    g_queue_init (&sink->x11.present.pending);
+    sink->x11.present.available = FALSE;
+
+    GST_INFO_OBJECT (sink, "Built without Present support, "
+                     "presentation times are estimated");
+    return -1;
+}
+
+void
+present_close (GstGLESSink *sink)
+{
+}
+
+void
+present_handle_events (GstGLESSink *sink)
+{
+}
+#endif
+
+void
+present_frame_submitted (GstGLESSink *sink, GstClockTime pts,
+                         gint64 submit_time)
+{
+    GstGLESPresent *present = &sink->x11.present;
+    GstGLESStats *stats = &sink->stats;
+    GstGLESPresentFrame *frame;
+    gint64 now;
+
+    if (present->available) {
+        frame = g_slice_new (GstGLESPresentFrame);
+        frame->pts = pts;
+        frame->submit_time = submit_time;
+        g_queue_push_tail (&present->pending, frame);
+
+        /* the driver does not present through Present after all */
+        while (g_queue_get_length (&present->pending) > PRESENT_MAX_PENDING)
+            g_slice_free (GstGLESPresentFrame,
+                          g_queue_pop_head (&present->pending));
+
+        GST_OBJECT_LOCK (sink);
+        stats->rendered++;
+        GST_OBJECT_UNLOCK (sink);
+        return;
+    }
+
+    /* without feedback, the return of eglSwapBuffers is all we know */
+    now = g_get_monotonic_time ();
+
+    GST_OBJECT_LOCK (sink);
+    stats->rendered++;
+    stats->presented++;
+    stats->last_presented = now * GST_USECOND;
+    stats->latency = (now - submit_time) * GST_USECOND;
+    if (stats->average_latency)
+        stats->average_latency =
+                (stats->average_latency * 7 + stats->latency) / 8;
+    else
+        stats->average_latency = stats->latency;
+    GST_OBJECT_UNLOCK (sink);
+
+    gst_gles_clock_add_vblank (GST_GLES_CLOCK (sink->clock),
+                               now * GST_USECOND, 0);
+}
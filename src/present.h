@@ -0,0 +1,66 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _PRESENT_H__
+#define _PRESENT_H__
+
+#include <glib.h>
+#include <gst/gst.h>
+
+typedef struct _GstGLESPresent     GstGLESPresent;
+
+struct _GstGLESPresent
+{
+    gboolean available;
+
+    /* xcb connection of the x11 display and the special event queue
+     * the CompleteNotify events are delivered to */
+    gpointer connection;
+    gpointer special_event;
+    guint32 eid;
+
+    /* frames passed to eglSwapBuffers waiting for their completion */
+    GQueue pending;
+
+    /* last completed presentation */
+    guint64 msc;
+    guint64 ust;
+};
+
+struct _GstGLESSink;
+
+/* subscribes to Present CompleteNotify events for the sink window,
+ * returns 0 on success, -1 if the extension is not available */
+gint
+present_init (struct _GstGLESSink *sink);
+void
+present_close (struct _GstGLESSink *sink);
+
+/* remembers a frame handed to eglSwapBuffers at submit_time (monotonic
+ * time in microseconds), must be called right after the swap */
+void
+present_frame_submitted (struct _GstGLESSink *sink, GstClockTime pts,
+                         gint64 submit_time);
+
+/* drains pending completion events and updates the sink statistics */
+void
+present_handle_events (struct _GstGLESSink *sink);
+#endif
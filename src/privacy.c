@@ -0,0 +1,299 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <gst/gst.h>
+
+#include "gstglessink.h"
+#include "shader.h"
+#include "privacy.h"
+
+/* uniform locations in the compute conversions */
+#define PRIVACY_COMPUTE_MASKED_LOC 1
+#define PRIVACY_COMPUTE_BLOCK_LOC 2
+
+/* parses one mask, returns FALSE if it is malformed */
+static gboolean
+privacy_parse_mask (GstGLESPrivacyMask *mask, gchar *str)
+{
+    gchar **fields;
+    gdouble values[2 * PRIVACY_MAX_POINTS];
+    guint n_values;
+    gboolean ok;
+    guint i;
+
+    mask->mode = PRIVACY_FILL;
+    if (g_str_has_prefix (str, "pixelate:")) {
+        mask->mode = PRIVACY_PIXELATE;
+        str += strlen ("pixelate:");
+    } else if (g_str_has_prefix (str, "fill:")) {
+        str += strlen ("fill:");
+    }
+
+    fields = g_strsplit (str, ",", -1);
+    n_values = g_strv_length (fields);
+    ok = n_values == 4 ||
+         (n_values >= 6 && n_values % 2 == 0 &&
+          n_values <= 2 * PRIVACY_MAX_POINTS);
+
+    for (i = 0; ok && i < n_values; i++) {
+        gchar *end;
+
+        values[i] = g_ascii_strtod (g_strstrip (fields[i]), &end);
+        ok = end != fields[i] && !*end;
+    }
+    g_strfreev (fields);
+
+    if (!ok)
+        return FALSE;
+
+    if (n_values == 4) {
+        if (values[2] <= 0 || values[3] <= 0)
+            return FALSE;
+
+        mask->n_points = 4;
+        mask->x[0] = mask->x[3] = values[0];
+        mask->x[1] = mask->x[2] = values[0] + values[2];
+        mask->y[0] = mask->y[1] = values[1];
+        mask->y[2] = mask->y[3] = values[1] + values[3];
+        return TRUE;
+    }
+
+    mask->n_points = n_values / 2;
+    for (i = 0; i < mask->n_points; i++) {
+        mask->x[i] = values[2 * i];
+        mask->y[i] = values[2 * i + 1];
+    }
+    return TRUE;
+}
+
+gboolean
+privacy_masks_parse (GstGLESPrivacyMasks *masks, const gchar *spec)
+{
+    gchar **list;
+    gboolean ok = TRUE;
+    guint n = 0;
+    gint i;
+
+    masks->n_masks = 0;
+    if (!spec)
+        return TRUE;
+
+    list = g_strsplit (spec, ";", -1);
+    for (i = 0; list[i] && ok; i++) {
+        gchar *str = g_strstrip (list[i]);
+
+        if (!*str)
+            continue;
+
+        ok = n < PRIVACY_MAX_MASKS &&
+             privacy_parse_mask (&masks->mask[n], str);
+        n++;
+    }
+    g_strfreev (list);
+
+    if (!ok)
+        return FALSE;
+
+    masks->n_masks = n;
+    return TRUE;
+}
+
+void
+privacy_init (GstGLESSink *sink)
+{
+    GstGLESPrivacy *privacy = &sink->gl_thread.gles.privacy;
+
+    glGenTextures (1, &privacy->tex);
+    glBindTexture (GL_TEXTURE_2D, privacy->tex);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    /* rasterize on the first frame */
+    privacy->width = 0;
+    privacy->height = 0;
+    privacy->masked = FALSE;
+    privacy->warned = FALSE;
+}
+
+void
+privacy_close (GstGLESSink *sink)
+{
+    GstGLESPrivacy *privacy = &sink->gl_thread.gles.privacy;
+
+    glDeleteTextures (1, &privacy->tex);
+    privacy->tex = 0;
+    privacy->masked = FALSE;
+
+    g_free (privacy->raster);
+    privacy->raster = NULL;
+}
+
+static gint
+privacy_compare (gconstpointer a, gconstpointer b)
+{
+    gdouble da = *(const gdouble *) a;
+    gdouble db = *(const gdouble *) b;
+
+    return da < db ? -1 : da > db;
+}
+
+/* sets the pixels of mask, even-odd on the pixel centers */
+static void
+privacy_rasterize (GstGLESPrivacy *privacy, const GstGLESPrivacyMask *mask)
+{
+    guint8 value = mask->mode == PRIVACY_PIXELATE ? PRIVACY_TEXEL_PIXELATE :
+                                                    PRIVACY_TEXEL_FILL;
+    gdouble crossings[PRIVACY_MAX_POINTS];
+    gint row;
+    guint i;
+
+    for (row = 0; row < privacy->height; row++) {
+        gdouble cy = row + 0.5;
+        guint n = 0;
+
+        for (i = 0; i < mask->n_points; i++) {
+            guint j = (i + 1) % mask->n_points;
+            gdouble y0 = mask->y[i];
+            gdouble y1 = mask->y[j];
+
+            if ((y0 <= cy) == (y1 <= cy))
+                continue;
+            crossings[n++] = mask->x[i] + (cy - y0) / (y1 - y0) *
+                             (mask->x[j] - mask->x[i]);
+        }
+        qsort (crossings, n, sizeof (gdouble), privacy_compare);
+
+        for (i = 0; i + 1 < n; i += 2) {
+            gint x0 = CLAMP ((gint) ceil (crossings[i] - 0.5), 0,
+                             privacy->width);
+            gint x1 = CLAMP ((gint) ceil (crossings[i + 1] - 0.5), 0,
+                             privacy->width);
+            guint8 *p = privacy->raster + (gsize) row * privacy->width;
+            gint x;
+
+            for (x = x0; x < x1; x++)
+                p[x] = MAX (p[x], value);
+        }
+    }
+}
+
+gboolean
+privacy_update (GstGLESSink *sink)
+{
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    GstGLESPrivacy *privacy = &gles->privacy;
+    gint width = GST_VIDEO_SINK_WIDTH (sink);
+    gint height = GST_VIDEO_SINK_HEIGHT (sink);
+    GstGLESPrivacyMask mask[PRIVACY_MAX_MASKS];
+    guint generation;
+    guint n_masks;
+    guint i;
+
+    GST_OBJECT_LOCK (sink);
+    generation = sink->privacy_masks.generation;
+    GST_OBJECT_UNLOCK (sink);
+
+    if (privacy->width == width && privacy->height == height &&
+        privacy->generation == generation)
+        return FALSE;
+
+    GST_OBJECT_LOCK (sink);
+    n_masks = sink->privacy_masks.n_masks;
+    memcpy (mask, sink->privacy_masks.mask, n_masks * sizeof (mask[0]));
+    generation = sink->privacy_masks.generation;
+    GST_OBJECT_UNLOCK (sink);
+
+    privacy->width = width;
+    privacy->height = height;
+    privacy->generation = generation;
+    privacy->masked = n_masks > 0;
+
+    g_free (privacy->raster);
+    privacy->raster = NULL;
+    if (!privacy->masked)
+        return TRUE;
+
+    privacy->raster = g_malloc0 ((gsize) width * height);
+    for (i = 0; i < n_masks; i++)
+        privacy_rasterize (privacy, &mask[i]);
+
+    /* rows run top down like the planes */
+    glBindTexture (GL_TEXTURE_2D, privacy->tex);
+    glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D (GL_TEXTURE_2D, 0, gles->plane_internal_format, width,
+                  height, 0, gles->plane_format, GL_UNSIGNED_BYTE,
+                  privacy->raster);
+
+    GST_DEBUG_OBJECT (sink, "Rasterized %u privacy masks", n_masks);
+    return TRUE;
+}
+
+gboolean
+privacy_bind (GstGLESSink *sink, const GstGLESShader *shader)
+{
+    GstGLESPrivacy *privacy = &sink->gl_thread.gles.privacy;
+    gint block = MAX (sink->privacy_block, 1);
+    GLint masked_loc;
+
+    if (privacy->masked) {
+        glActiveTexture (GL_TEXTURE0 + PRIVACY_UNIT);
+        glBindTexture (GL_TEXTURE_2D, privacy->tex);
+    }
+
+    if (shader->compute) {
+        glUniform1f (PRIVACY_COMPUTE_MASKED_LOC, privacy->masked);
+        glUniform1i (PRIVACY_COMPUTE_BLOCK_LOC, block);
+        return TRUE;
+    }
+
+    /* a precompiled binary older than the masks would show the picture
+     * unmasked, it is blacked out instead */
+    masked_loc = glGetUniformLocation (shader->program, "masked");
+    if (masked_loc < 0 && privacy->masked) {
+        if (!privacy->warned) {
+            GST_ELEMENT_WARNING (sink, RESOURCE, FAILED,
+                ("Conversion shader does not support privacy masks"),
+                ("Rebuild the shader binaries, the picture is blacked "
+                 "out"));
+            privacy->warned = TRUE;
+        }
+        return FALSE;
+    }
+
+    glUniform1i (glGetUniformLocation (shader->program, "s_mask"),
+                 PRIVACY_UNIT);
+    glUniform1f (masked_loc, privacy->masked);
+    glUniform2f (glGetUniformLocation (shader->program, "block"),
+                 (gfloat) block / GST_VIDEO_SINK_WIDTH (sink),
+                 (gfloat) block / GST_VIDEO_SINK_HEIGHT (sink));
+    return TRUE;
+}
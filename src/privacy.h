@@ -0,0 +1,112 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef _PRIVACY_H__
+#define _PRIVACY_H__
+
+#include <glib.h>
+
+#include <GLES2/gl2.h>
+
+#include "shader.h"
+
+#define PRIVACY_MAX_MASKS 16
+#define PRIVACY_MAX_POINTS 16
+
+/* how a mask hides the picture, and the value of its pixels in the mask
+ * texture */
+#define PRIVACY_FILL 0
+#define PRIVACY_PIXELATE 1
+#define PRIVACY_TEXEL_FILL 255
+#define PRIVACY_TEXEL_PIXELATE 128
+
+/* texture unit of the mask texture, binding 5 in the compute shaders */
+#define PRIVACY_UNIT 5
+
+typedef struct _GstGLESPrivacyMask  GstGLESPrivacyMask;
+typedef struct _GstGLESPrivacyMasks GstGLESPrivacyMasks;
+typedef struct _GstGLESPrivacy      GstGLESPrivacy;
+
+/* polygon in video pixels, rectangles are stored as four points */
+struct _GstGLESPrivacyMask
+{
+    gint mode;
+    guint n_points;
+    gdouble x[PRIVACY_MAX_POINTS];
+    gdouble y[PRIVACY_MAX_POINTS];
+};
+
+/* masks of the privacy_masks property, protected by the object lock.
+ * generation counts the changes so the gl thread notices them */
+struct _GstGLESPrivacyMasks
+{
+    gchar *spec;
+    GstGLESPrivacyMask mask[PRIVACY_MAX_MASKS];
+    guint n_masks;
+    guint generation;
+};
+
+/*
+ * Masks of the gl thread. They are rasterized on the cpu into a
+ * luminance texture of the frame size whenever they or the frame size
+ * change, and the conversion shaders fill or pixelate where it is set,
+ * so masks change with a texture upload and no program is rebuilt.
+ */
+struct _GstGLESPrivacy
+{
+    GLuint tex;
+    gint width;
+    gint height;
+    guint generation;
+
+    /* set if any mask covers a pixel */
+    gboolean masked;
+    guint8 *raster;
+
+    /* set once a program without the mask uniforms was reported */
+    gboolean warned;
+};
+
+struct _GstGLESSink;
+
+/* parses masks separated by semicolons, each an optional fill: or
+ * pixelate: followed by x,y,width,height for a rectangle or by three or
+ * more x,y points for a polygon. returns FALSE if the spec is malformed */
+gboolean
+privacy_masks_parse (GstGLESPrivacyMasks *masks, const gchar *spec);
+
+void
+privacy_init (struct _GstGLESSink *sink);
+void
+privacy_close (struct _GstGLESSink *sink);
+
+/* updates the mask texture if the masks or the frame size changed,
+ * returns TRUE if it did and the whole frame has to be converted */
+gboolean
+privacy_update (struct _GstGLESSink *sink);
+
+/* sets the mask uniforms of the bound conversion program, returns FALSE
+ * if masks are set but the program cannot apply them, the frame must not
+ * be shown then */
+gboolean
+privacy_bind (struct _GstGLESSink *sink, const GstGLESShader *shader);
+#endif
@@ -0,0 +1,262 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "repack.h"
+
+/* most bands a frame is split into */
+#define REPACK_MAX_BANDS 16
+
+typedef struct _GstGLESRepackBand GstGLESRepackBand;
+
+struct _GstGLESRepackBand
+{
+    GstGLESRepack *repack;
+
+    const guint8 *src;
+    const GstGLESLayout *in;
+    guint8 *dst;
+    const GstGLESLayout *out;
+    gboolean interleaved;
+    gint width;
+
+    /* luma rows of the band, y0 is even */
+    gint y0;
+    gint y1;
+};
+
+/* splits len interleaved chroma pairs into the u and v rows */
+static inline void
+repack_deinterleave_row (guint8 *u, guint8 *v, const guint8 *uv, gint len)
+{
+    gint i = 0;
+
+#if defined(__SSE2__)
+    const __m128i mask = _mm_set1_epi16 (0x00ff);
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i a = _mm_loadu_si128 ((const __m128i *) (uv + 2 * i));
+        __m128i b = _mm_loadu_si128 ((const __m128i *) (uv + 2 * i + 16));
+
+        _mm_storeu_si128 ((__m128i *) (u + i),
+                          _mm_packus_epi16 (_mm_and_si128 (a, mask),
+                                            _mm_and_si128 (b, mask)));
+        _mm_storeu_si128 ((__m128i *) (v + i),
+                          _mm_packus_epi16 (_mm_srli_epi16 (a, 8),
+                                            _mm_srli_epi16 (b, 8)));
+    }
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+    for (; i + 16 <= len; i += 16) {
+        uint8x16x2_t pairs = vld2q_u8 (uv + 2 * i);
+
+        vst1q_u8 (u + i, pairs.val[0]);
+        vst1q_u8 (v + i, pairs.val[1]);
+    }
+#endif
+
+    for (; i < len; i++) {
+        u[i] = uv[2 * i];
+        v[i] = uv[2 * i + 1];
+    }
+}
+
+/* copies the plane rows of one band, memcpy already uses the widest
+ * vector loads the cpu has */
+static void
+repack_band (GstGLESRepackBand *band)
+{
+    const GstGLESLayout *in = band->in;
+    const GstGLESLayout *out = band->out;
+    gint cw = band->width / 2;
+    gint y, i;
+
+    for (y = band->y0; y < band->y1; y++)
+        memcpy (band->dst + out->offset[0] + y * out->stride[0],
+                band->src + in->offset[0] + y * in->stride[0],
+                band->width);
+
+    for (y = band->y0 / 2; y < band->y1 / 2; y++) {
+        guint8 *u = band->dst + out->offset[1] + y * out->stride[1];
+        guint8 *v = band->dst + out->offset[2] + y * out->stride[2];
+
+        if (band->interleaved) {
+            repack_deinterleave_row (u, v, band->src + in->offset[1] +
+                                     y * in->stride[1], cw);
+            continue;
+        }
+
+        for (i = 1; i < 3; i++)
+            memcpy (i == 1 ? u : v,
+                    band->src + in->offset[i] + y * in->stride[i], cw);
+    }
+}
+
+static void
+repack_worker (gpointer data, gpointer user_data)
+{
+    static GPrivate started = G_PRIVATE_INIT (NULL);
+    GstGLESRepackBand *band = data;
+    GstGLESRepack *repack = band->repack;
+
+    if (!g_private_get (&started)) {
+        if (repack->thread_init)
+            repack->thread_init (repack->thread_init_data);
+        g_private_set (&started, GINT_TO_POINTER (1));
+    }
+
+    repack_band (band);
+
+    g_mutex_lock (&repack->lock);
+    if (--repack->pending == 0)
+        g_cond_signal (&repack->done);
+    g_mutex_unlock (&repack->lock);
+}
+
+void
+repack_init (GstGLESRepack *repack, GstGLESRepackThreadInit thread_init,
+             gpointer thread_init_data)
+{
+    repack->thread_init = thread_init;
+    repack->thread_init_data = thread_init_data;
+    repack->pool = NULL;
+    repack->n_threads = 0;
+    repack->pending = 0;
+    repack->staging = NULL;
+    repack->staging_size = 0;
+
+    g_mutex_init (&repack->lock);
+    g_cond_init (&repack->done);
+}
+
+void
+repack_clear (GstGLESRepack *repack)
+{
+    if (repack->pool) {
+        g_thread_pool_free (repack->pool, FALSE, TRUE);
+        repack->pool = NULL;
+    }
+    repack->n_threads = 0;
+
+    g_free (repack->staging);
+    repack->staging = NULL;
+    repack->staging_size = 0;
+}
+
+/* (re)starts the workers, returns the number of bands to use */
+static guint
+repack_start (GstGLESRepack *repack, guint n_threads)
+{
+    n_threads = CLAMP (n_threads, 1, REPACK_MAX_BANDS);
+
+    if (n_threads == repack->n_threads)
+        return n_threads;
+
+    if (n_threads == 1) {
+        if (repack->pool) {
+            g_thread_pool_free (repack->pool, FALSE, TRUE);
+            repack->pool = NULL;
+        }
+        repack->n_threads = 1;
+        return 1;
+    }
+
+    if (!repack->pool) {
+        repack->pool = g_thread_pool_new (repack_worker, NULL,
+                                          n_threads - 1, TRUE, NULL);
+        if (!repack->pool)
+            return 1;
+    } else if (!g_thread_pool_set_max_threads (repack->pool,
+                                               n_threads - 1, NULL)) {
+        return 1;
+    }
+
+    repack->n_threads = n_threads;
+    return n_threads;
+}
+
+const guint8 *
+repack_frame (GstGLESRepack *repack, guint n_threads, gboolean interleaved,
+              gint width, gint height, const guint8 *data,
+              const GstGLESLayout *in, GstGLESLayout *out, gsize *size)
+{
+    GstGLESRepackBand bands[REPACK_MAX_BANDS];
+    guint n_bands;
+    gint rows;
+    guint i;
+
+    out->stride[0] = (width + GST_GLES_UNPACK_ALIGNMENT - 1) &
+                     ~(GST_GLES_UNPACK_ALIGNMENT - 1);
+    out->stride[1] = (width / 2 + GST_GLES_UNPACK_ALIGNMENT - 1) &
+                     ~(GST_GLES_UNPACK_ALIGNMENT - 1);
+    out->stride[2] = out->stride[1];
+    out->offset[0] = 0;
+    out->offset[1] = (gsize) out->stride[0] * height;
+    out->offset[2] = out->offset[1] + (gsize) out->stride[1] * (height / 2);
+    *size = out->offset[2] + (gsize) out->stride[2] * (height / 2);
+
+    if (repack->staging_size != *size) {
+        g_free (repack->staging);
+        repack->staging = g_malloc (*size);
+        repack->staging_size = *size;
+    }
+
+    n_bands = repack_start (repack, n_threads);
+
+    /* bands start on even rows to keep chroma rows in one band */
+    rows = ((height + n_bands - 1) / n_bands + 1) & ~1;
+
+    for (i = 0; i < n_bands; i++) {
+        bands[i].repack = repack;
+        bands[i].src = data;
+        bands[i].in = in;
+        bands[i].dst = repack->staging;
+        bands[i].out = out;
+        bands[i].interleaved = interleaved;
+        bands[i].width = width;
+        bands[i].y0 = MIN (i * rows, height);
+        bands[i].y1 = MIN ((i + 1) * rows, height);
+    }
+
+    /* hand all but the first band to the workers */
+    g_mutex_lock (&repack->lock);
+    repack->pending = n_bands - 1;
+    g_mutex_unlock (&repack->lock);
+
+    for (i = 1; i < n_bands; i++)
+        g_thread_pool_push (repack->pool, &bands[i], NULL);
+
+    repack_band (&bands[0]);
+
+    g_mutex_lock (&repack->lock);
+    while (repack->pending)
+        g_cond_wait (&repack->done, &repack->lock);
+    g_mutex_unlock (&repack->lock);
+
+    return repack->staging;
+}
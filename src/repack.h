@@ -0,0 +1,75 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _REPACK_H__
+#define _REPACK_H__
+
+#include <glib.h>
+
+#include "upload.h"
+
+typedef struct _GstGLESRepack      GstGLESRepack;
+
+typedef void (*GstGLESRepackThreadInit) (gpointer data);
+
+/*
+ * Converts frames the textures cannot take as they are into a tightly
+ * packed I420 staging copy. The frame is split into bands of rows that
+ * a small pool of worker threads and the calling thread convert in
+ * parallel.
+ */
+struct _GstGLESRepack
+{
+    /* workers, one less than the number of bands */
+    GThreadPool *pool;
+    guint n_threads;
+
+    /* called in each worker before it converts its first band */
+    GstGLESRepackThreadInit thread_init;
+    gpointer thread_init_data;
+
+    /* bands still being converted by the workers */
+    GMutex lock;
+    GCond done;
+    guint pending;
+
+    /* staging copy the frame is converted into */
+    guint8 *staging;
+    gsize staging_size;
+};
+
+void
+repack_init (GstGLESRepack *repack, GstGLESRepackThreadInit thread_init,
+             gpointer thread_init_data);
+
+/* stops the workers and frees the staging copy */
+void
+repack_clear (GstGLESRepack *repack);
+
+/* converts a frame with the given plane layout into the staging copy
+ * using n_threads threads, chroma is interleaved in the second plane if
+ * interleaved is set. returns the staging copy, its I420 layout with
+ * rows aligned to GST_GLES_UNPACK_ALIGNMENT in out and its size */
+const guint8 *
+repack_frame (GstGLESRepack *repack, guint n_threads, gboolean interleaved,
+              gint width, gint height, const guint8 *data,
+              const GstGLESLayout *in, GstGLESLayout *out, gsize *size);
+#endif
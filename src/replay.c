@@ -0,0 +1,315 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <glib.h>
+#include <gst/gst.h>
+
+#include "gstglessink.h"
+#include "replay.h"
+
+void
+replay_init (GstGLESSink *sink)
+{
+    GstGLESReplay *replay = &sink->gl_thread.gles.replay;
+
+    replay->frames = NULL;
+    replay->n_frames = 0;
+    replay->head = 0;
+    replay->count = 0;
+    replay->video_width = 0;
+    replay->video_height = 0;
+    replay->requested = 0;
+    replay->shown = -1;
+}
+
+static void
+replay_free (GstGLESSink *sink)
+{
+    GstGLESReplay *replay = &sink->gl_thread.gles.replay;
+    guint i;
+
+    for (i = 0; i < replay->n_frames; i++) {
+        glDeleteFramebuffers (1, &replay->frames[i].framebuffer);
+        glDeleteTextures (1, &replay->frames[i].tex);
+    }
+    g_free (replay->frames);
+    replay->frames = NULL;
+    replay->n_frames = 0;
+    replay->head = 0;
+    replay->count = 0;
+
+    GST_OBJECT_LOCK (sink);
+    sink->stats.replay_frames = 0;
+    sink->stats.replay_bytes = 0;
+    GST_OBJECT_UNLOCK (sink);
+}
+
+void
+replay_close (GstGLESSink *sink)
+{
+    replay_free (sink);
+    sink->gl_thread.gles.replay.shown = -1;
+}
+
+/* sizes the ring for frames of video_width x video_height, as many of
+ * the requested frames as fit into budget MB */
+static void
+replay_alloc (GstGLESSink *sink, guint frames, guint divisor, guint budget,
+              gint video_width, gint video_height)
+{
+    GstGLESReplay *replay = &sink->gl_thread.gles.replay;
+    gint width = MAX (video_width / (gint) divisor, 1);
+    gint height = MAX (video_height / (gint) divisor, 1);
+    guint64 frame_size = (guint64) width * height * 4;
+    guint64 n = MIN (frames, REPLAY_MAX_FRAMES);
+    guint i;
+
+    replay_free (sink);
+
+    replay->requested = frames;
+    replay->divisor = divisor;
+    replay->budget = budget;
+    replay->video_width = video_width;
+    replay->video_height = video_height;
+
+    n = MIN (n, (guint64) budget * 1024 * 1024 / frame_size);
+    if (n < frames)
+        GST_INFO_OBJECT (sink, "Replay budget of %u MB holds %u of %u "
+                         "frames", budget, (guint) n, frames);
+    if (!n)
+        return;
+
+    replay->frames = g_new0 (GstGLESReplayFrame, n);
+    for (i = 0; i < n; i++) {
+        GstGLESReplayFrame *frame = &replay->frames[i];
+
+        glGenTextures (1, &frame->tex);
+        glBindTexture (GL_TEXTURE_2D, frame->tex);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+                      GL_UNSIGNED_BYTE, NULL);
+
+        glGenFramebuffers (1, &frame->framebuffer);
+        glBindFramebuffer (GL_FRAMEBUFFER, frame->framebuffer);
+        glFramebufferTexture2D (GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                GL_TEXTURE_2D, frame->tex, 0);
+        frame->pts = GST_CLOCK_TIME_NONE;
+    }
+    replay->n_frames = n;
+    replay->width = width;
+    replay->height = height;
+
+    GST_DEBUG_OBJECT (sink, "Replay ring of %u frames of %dx%d", (guint) n,
+                      width, height);
+
+    GST_OBJECT_LOCK (sink);
+    sink->stats.replay_bytes = n * frame_size;
+    GST_OBJECT_UNLOCK (sink);
+}
+
+void
+replay_record (GstGLESSink *sink)
+{
+    GLfloat vVertices[] =
+    {
+        -1.0f, -1.0f,
+        0.0f, 0.0f,
+
+        1.0f, -1.0f,
+        1.0f, 0.0f,
+
+        1.0f, 1.0f,
+        1.0f, 1.0f,
+
+        -1.0f, 1.0f,
+        0.0f, 1.0f,
+    };
+    GLushort indices[] = { 0, 1, 2, 0, 2, 3 };
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    GstGLESReplay *replay = &gles->replay;
+    gint video_width = GST_VIDEO_SINK_WIDTH (sink);
+    gint video_height = GST_VIDEO_SINK_HEIGHT (sink);
+    GstGLESReplayFrame *frame;
+    guint frames;
+    guint divisor;
+    guint budget;
+    gboolean frozen;
+
+    GST_OBJECT_LOCK (sink);
+    frames = sink->replay_frames;
+    divisor = sink->replay_divisor;
+    budget = sink->replay_budget;
+    frozen = sink->replay_frozen;
+    GST_OBJECT_UNLOCK (sink);
+
+    /* the frames that can be stepped through stay as they are */
+    if (frozen || video_width <= 0 || video_height <= 0)
+        return;
+
+    if (replay->requested != frames || replay->divisor != divisor ||
+        replay->budget != budget || replay->video_width != video_width ||
+        replay->video_height != video_height)
+        replay_alloc (sink, frames, divisor, budget, video_width,
+                      video_height);
+
+    if (!replay->n_frames)
+        return;
+
+    /* the scaled down draw is the only copy the ring takes */
+    frame = &replay->frames[replay->head];
+    glBindFramebuffer (GL_FRAMEBUFFER, frame->framebuffer);
+    glViewport (0, 0, replay->width, replay->height);
+    glUseProgram (gles->scale.program);
+    glActiveTexture (GL_TEXTURE3);
+    glBindTexture (GL_TEXTURE_2D, gles->rgb_tex.id);
+    glUniform1i (gles->rgb_tex.loc, 3);
+    gl_draw_quad (sink, &gles->scale, vVertices, indices);
+    frame->pts = sink->gl_thread.pts;
+
+    replay->head = (replay->head + 1) % replay->n_frames;
+    if (replay->count < replay->n_frames)
+        replay->count++;
+
+    GST_OBJECT_LOCK (sink);
+    sink->stats.replay_frames = replay->count;
+    GST_OBJECT_UNLOCK (sink);
+
+    glBindFramebuffer (GL_FRAMEBUFFER, gles->framebuffer);
+}
+
+/* frame to show counted back from the newest, -1 for the live picture */
+static gint
+replay_offset (GstGLESSink *sink)
+{
+    GstGLESReplay *replay = &sink->gl_thread.gles.replay;
+    gboolean frozen;
+    guint offset;
+
+    GST_OBJECT_LOCK (sink);
+    frozen = sink->replay_frozen;
+    offset = sink->replay_offset;
+    GST_OBJECT_UNLOCK (sink);
+
+    if (!frozen || !replay->count)
+        return -1;
+
+    return MIN (offset, replay->count - 1);
+}
+
+GLuint
+replay_texture (GstGLESSink *sink)
+{
+    GstGLESReplay *replay = &sink->gl_thread.gles.replay;
+    GstGLESReplayFrame *frame = NULL;
+    gint offset = replay_offset (sink);
+
+    if (offset >= 0)
+        frame = &replay->frames[(replay->head + replay->n_frames - 1 -
+                                 offset) % replay->n_frames];
+
+    if (offset != replay->shown) {
+        GstClockTime timestamp = frame ? frame->pts : sink->gl_thread.pts;
+
+        GST_INFO_OBJECT (sink, "Replay %s at %" GST_TIME_FORMAT,
+                         frame ? "shows a held frame" : "is live",
+                         GST_TIME_ARGS (timestamp));
+
+        gst_element_post_message (GST_ELEMENT (sink),
+            gst_message_new_element (GST_OBJECT (sink),
+                gst_structure_new ("glessink-replay",
+                    "live", G_TYPE_BOOLEAN, frame == NULL,
+                    "offset", G_TYPE_UINT, (guint) MAX (offset, 0),
+                    "timestamp", G_TYPE_UINT64, timestamp,
+                    NULL)));
+        replay->shown = offset;
+    }
+
+    return frame ? frame->tex : 0;
+}
+
+gboolean
+replay_changed (GstGLESSink *sink)
+{
+    return replay_offset (sink) != sink->gl_thread.gles.replay.shown;
+}
+
+void
+replay_freeze (GstGLESSink *sink)
+{
+    GST_DEBUG_OBJECT (sink, "Freezing replay");
+
+    GST_OBJECT_LOCK (sink);
+    if (!sink->replay_frozen) {
+        sink->replay_frozen = TRUE;
+        sink->replay_offset = 0;
+    }
+    GST_OBJECT_UNLOCK (sink);
+
+    gl_thread_represent (sink);
+}
+
+void
+replay_step_back (GstGLESSink *sink)
+{
+    GST_OBJECT_LOCK (sink);
+    if (!sink->replay_frozen) {
+        sink->replay_frozen = TRUE;
+        sink->replay_offset = 0;
+    }
+    /* the ring is not written while frozen, the count stays valid */
+    if (sink->replay_offset + 1 < sink->stats.replay_frames)
+        sink->replay_offset++;
+    GST_OBJECT_UNLOCK (sink);
+
+    gl_thread_represent (sink);
+}
+
+void
+replay_step_forward (GstGLESSink *sink)
+{
+    GST_OBJECT_LOCK (sink);
+    if (sink->replay_frozen && sink->replay_offset > 0)
+        sink->replay_offset--;
+    GST_OBJECT_UNLOCK (sink);
+
+    gl_thread_represent (sink);
+}
+
+void
+replay_live (GstGLESSink *sink)
+{
+    GST_DEBUG_OBJECT (sink, "Replay back to live");
+
+    GST_OBJECT_LOCK (sink);
+    sink->replay_frozen = FALSE;
+    sink->replay_offset = 0;
+    GST_OBJECT_UNLOCK (sink);
+
+    gl_thread_represent (sink);
+}
@@ -0,0 +1,101 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef _REPLAY_H__
+#define _REPLAY_H__
+
+#include <glib.h>
+#include <gst/gst.h>
+
+#include <GLES2/gl2.h>
+
+/* most frames the ring holds, whatever the budget allows */
+#define REPLAY_MAX_FRAMES 1024
+
+typedef struct _GstGLESReplayFrame GstGLESReplayFrame;
+typedef struct _GstGLESReplay      GstGLESReplay;
+
+struct _GstGLESReplayFrame
+{
+    GLuint tex;
+    GLuint framebuffer;
+    GstClockTime pts;
+};
+
+/*
+ * Instant replay. Every converted frame is drawn scaled down into the
+ * next texture of a ring, which stays on the GPU and is never read
+ * back. While frozen the ring is not written and the screen shows one of
+ * its frames instead of the converted one, the stream itself goes on.
+ */
+struct _GstGLESReplay
+{
+    /* ring textures of width x height, the next one written and the
+     * frames held */
+    GstGLESReplayFrame *frames;
+    guint n_frames;
+    gint width;
+    gint height;
+    guint head;
+    guint count;
+
+    /* frame size and properties the ring was allocated for */
+    gint video_width;
+    gint video_height;
+    guint divisor;
+    guint budget;
+    guint requested;
+
+    /* frame on screen counted back from the newest, -1 while live */
+    gint shown;
+};
+
+struct _GstGLESSink;
+
+void
+replay_init (struct _GstGLESSink *sink);
+void
+replay_close (struct _GstGLESSink *sink);
+
+/* keeps the converted frame in the ring unless replay is frozen */
+void
+replay_record (struct _GstGLESSink *sink);
+
+/* returns the ring texture the screen shows, 0 while live */
+GLuint
+replay_texture (struct _GstGLESSink *sink);
+
+/* returns TRUE if the frame to show is not the one on screen */
+gboolean
+replay_changed (struct _GstGLESSink *sink);
+
+/* handlers of the replay action signals, they wake the gl thread to show
+ * the change also without new frames, e.g. while paused */
+void
+replay_freeze (struct _GstGLESSink *sink);
+void
+replay_step_back (struct _GstGLESSink *sink);
+void
+replay_step_forward (struct _GstGLESSink *sink);
+void
+replay_live (struct _GstGLESSink *sink);
+#endif
@@ -0,0 +1,150 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* for the per thread linux interfaces */
+#define _GNU_SOURCE
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include <glib.h>
+#include <gst/gst.h>
+
+#include "gstglessink.h"
+#include "rtsched.h"
+
+gint
+sched_policy_from_name (const gchar *name)
+{
+    if (!name || !strcmp (name, "other"))
+        return SCHED_OTHER;
+    if (!strcmp (name, "fifo"))
+        return SCHED_FIFO;
+    if (!strcmp (name, "rr"))
+        return SCHED_RR;
+
+    return -1;
+}
+
+const gchar *
+sched_policy_name (gint policy)
+{
+    switch (policy) {
+    case SCHED_FIFO:
+        return "fifo";
+    case SCHED_RR:
+        return "rr";
+    default:
+        return "other";
+    }
+}
+
+/* returns TRUE if the thread runs with the real time policy now */
+static gboolean
+sched_set_realtime (GstElement *element, const GstGLESSched *sched,
+                    const gchar *name)
+{
+    struct sched_param param;
+    gint err;
+
+    memset (&param, 0, sizeof (param));
+    param.sched_priority = CLAMP (sched->priority,
+                                  sched_get_priority_min (sched->policy),
+                                  sched_get_priority_max (sched->policy));
+
+    err = pthread_setschedparam (pthread_self (), sched->policy, &param);
+    if (err) {
+        /* usually EPERM without CAP_SYS_NICE or an RLIMIT_RTPRIO */
+        GST_WARNING_OBJECT (element, "Could not schedule the %s with %s "
+                            "priority %d, keeping SCHED_OTHER: %s", name,
+                            sched_policy_name (sched->policy),
+                            param.sched_priority, g_strerror (err));
+        return FALSE;
+    }
+
+    GST_DEBUG_OBJECT (element, "Scheduling the %s with %s priority %d",
+                      name, sched_policy_name (sched->policy),
+                      param.sched_priority);
+    return TRUE;
+}
+
+void
+sched_apply (GstElement *element, const GstGLESSched *sched,
+             const gchar *name)
+{
+    gboolean realtime = FALSE;
+
+    if (sched->policy != SCHED_OTHER)
+        realtime = sched_set_realtime (element, sched, name);
+
+#ifdef __linux__
+    /* the nice level is a per thread attribute on linux, it has no
+     * effect on real time threads */
+    if (!realtime && sched->nice &&
+        setpriority (PRIO_PROCESS, syscall (SYS_gettid), sched->nice) < 0)
+        GST_WARNING_OBJECT (element, "Could not set nice level %d of the "
+                            "%s: %s", sched->nice, name, g_strerror (errno));
+
+    if (sched->affinity) {
+        cpu_set_t set;
+        gint err;
+        gint i;
+
+        CPU_ZERO (&set);
+        for (i = 0; i < 64 && i < CPU_SETSIZE; i++) {
+            if (sched->affinity & (G_GUINT64_CONSTANT (1) << i))
+                CPU_SET (i, &set);
+        }
+
+        err = pthread_setaffinity_np (pthread_self (), sizeof (set), &set);
+        if (err)
+            GST_WARNING_OBJECT (element, "Could not set the cpu mask 0x%"
+                                G_GINT64_MODIFIER "x of the %s: %s",
+                                sched->affinity, name, g_strerror (err));
+    }
+#else
+    if ((!realtime && sched->nice) || sched->affinity)
+        GST_WARNING_OBJECT (element, "Nice level and cpu mask of the %s "
+                            "are not supported on this system", name);
+#endif
+}
+
+guint64
+sched_involuntary_switches (void)
+{
+#ifdef RUSAGE_THREAD
+    struct rusage usage;
+
+    if (getrusage (RUSAGE_THREAD, &usage) == 0)
+        return usage.ru_nivcsw;
+#endif
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _RTSCHED_H__
+#define _RTSCHED_H__
+
+#include <glib.h>
+#include <gst/gst.h>
+
+typedef struct _GstGLESSched       GstGLESSched;
+
+/* scheduling of the threads drawing and uploading frames, applied by
+ * each thread when it starts */
+struct _GstGLESSched
+{
+    /* SCHED_OTHER, SCHED_FIFO or SCHED_RR and the real time priority */
+    gint policy;
+    gint priority;
+
+    /* nice level used with SCHED_OTHER or if real time scheduling is not
+     * permitted */
+    gint nice;
+
+    /* cpus the threads may run on, 0 to keep the inherited mask */
+    guint64 affinity;
+};
+
+/* converts between the policy and its name as used by the sched_policy
+ * property, returns -1 for unknown names */
+gint
+sched_policy_from_name (const gchar *name);
+const gchar *
+sched_policy_name (gint policy);
+
+/* applies the scheduling to the calling thread, failing parts are
+ * logged and skipped */
+void
+sched_apply (GstElement *element, const GstGLESSched *sched,
+             const gchar *name);
+
+/* involuntary context switches of the calling thread so far */
+guint64
+sched_involuntary_switches (void);
+#endif
@@ -0,0 +1,714 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+#include <glib.h>
+#include <gst/gst.h>
+
+#include "gstglessink.h"
+#include "shader.h"
+#include "compute.h"
+#include "scopes.h"
+
+/* work group edge of the accumulation and the render shaders */
+#define SCOPE_GROUP 16
+
+static const gchar *scope_names[] = {
+    "histogram", /* GST_GLES_SCOPE_HISTOGRAM */
+    "waveform", /* GST_GLES_SCOPE_WAVEFORM */
+    "vectorscope" /* GST_GLES_SCOPE_VECTORSCOPE */
+};
+
+/* sizes of the scope images */
+static const gint scope_width[] = {
+    SCOPE_LEVELS, SCOPE_COLUMNS, SCOPE_VECTOR
+};
+static const gint scope_height[] = {
+    SCOPE_HISTOGRAM_HEIGHT, SCOPE_LEVELS, SCOPE_VECTOR
+};
+
+gint
+scopes_from_string (const gchar *names)
+{
+    gchar **list;
+    gint mask = 0;
+    gint i, j;
+
+    if (!names)
+        return 0;
+
+    list = g_strsplit (names, ",", -1);
+    for (i = 0; list[i] && mask >= 0; i++) {
+        gchar *name = g_strstrip (list[i]);
+
+        if (!*name)
+            continue;
+
+        for (j = 0; j < GST_GLES_SCOPES; j++) {
+            if (!strcmp (name, scope_names[j]))
+                break;
+        }
+        mask = j < GST_GLES_SCOPES ? mask | (1 << j) : -1;
+    }
+    g_strfreev (list);
+
+    return mask;
+}
+
+gchar *
+scopes_to_string (guint mask)
+{
+    GString *names = g_string_new (NULL);
+    gint i;
+
+    for (i = 0; i < GST_GLES_SCOPES; i++) {
+        if (!(mask & (1 << i)))
+            continue;
+        if (names->len)
+            g_string_append_c (names, ',');
+        g_string_append (names, scope_names[i]);
+    }
+
+    return g_string_free (names, FALSE);
+}
+
+static GLuint
+scopes_create_texture (void)
+{
+    GLuint tex = 0;
+
+    glGenTextures (1, &tex);
+    glBindTexture (GL_TEXTURE_2D, tex);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    return tex;
+}
+
+/* the accumulation and the images on the GPU, returns FALSE if the
+ * programs do not build */
+static gboolean
+scopes_init_compute (GstGLESSink *sink)
+{
+    GstGLESCompute *compute = &sink->gl_thread.gles.compute;
+    GstGLESScopes *scopes = &sink->gl_thread.gles.scopes;
+    gint i;
+
+    if (gl_init_compute_shader (GST_ELEMENT (sink), &scopes->accumulate,
+                                SHADER_SCOPE_ACCUMULATE) < 0 ||
+        gl_init_compute_shader (GST_ELEMENT (sink), &scopes->render,
+                                SHADER_SCOPE_RENDER) < 0) {
+        gl_delete_shader (&scopes->accumulate);
+        gl_delete_shader (&scopes->render);
+        return FALSE;
+    }
+
+    /* image stores need immutable storage, which the textures cannot
+     * drop again, so they are replaced if it fails */
+    glGetError ();
+    for (i = 0; i < GST_GLES_SCOPES; i++) {
+        glBindTexture (GL_TEXTURE_2D, scopes->tex[i]);
+        compute->tex_storage_2d (GL_TEXTURE_2D, 1, GL_RGBA8_OES,
+                                 scope_width[i], scope_height[i]);
+    }
+    if (glGetError () != GL_NO_ERROR) {
+        GST_WARNING_OBJECT (sink, "Could not allocate the scope images");
+        gl_delete_shader (&scopes->accumulate);
+        gl_delete_shader (&scopes->render);
+        glDeleteTextures (GST_GLES_SCOPES, scopes->tex);
+        for (i = 0; i < GST_GLES_SCOPES; i++)
+            scopes->tex[i] = scopes_create_texture ();
+        return FALSE;
+    }
+
+    glGenBuffers (2, scopes->buf);
+    for (i = 0; i < 2; i++) {
+        glBindBuffer (GL_SHADER_STORAGE_BUFFER, scopes->buf[i]);
+        glBufferData (GL_SHADER_STORAGE_BUFFER, SCOPE_WORDS * 4, NULL,
+                      GL_DYNAMIC_READ);
+    }
+
+    return TRUE;
+}
+
+static void
+scopes_worker (gpointer data, gpointer user_data);
+
+/* byte offset of the image of scope i in the images of the fallback */
+static gsize
+scopes_image_offset (gint i)
+{
+    gsize offset = 0;
+    gint k;
+
+    for (k = 0; k < i; k++)
+        offset += (gsize) scope_width[k] * scope_height[k] * 4;
+
+    return offset;
+}
+
+/* the frame read back at sample size, accumulated on the cpu by a
+ * worker, or by the gl thread if there is none */
+static void
+scopes_init_fallback (GstGLESSink *sink)
+{
+    GstGLESScopes *scopes = &sink->gl_thread.gles.scopes;
+    gint i;
+
+    glGenFramebuffers (2, scopes->sample_framebuffer);
+    for (i = 0; i < 2; i++) {
+        scopes->sample_tex[i] = scopes_create_texture ();
+        glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA, SCOPE_SAMPLE_WIDTH,
+                      SCOPE_SAMPLE_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                      NULL);
+
+        glBindFramebuffer (GL_FRAMEBUFFER, scopes->sample_framebuffer[i]);
+        glFramebufferTexture2D (GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                GL_TEXTURE_2D, scopes->sample_tex[i], 0);
+        scopes->sample_pending[i] = FALSE;
+    }
+    glBindFramebuffer (GL_FRAMEBUFFER, 0);
+
+    scopes->samples = g_malloc (SCOPE_SAMPLE_WIDTH * SCOPE_SAMPLE_HEIGHT * 4);
+    scopes->images = g_malloc0 (scopes_image_offset (GST_GLES_SCOPES));
+
+    g_mutex_init (&scopes->lock);
+    scopes->busy = FALSE;
+    scopes->ready = FALSE;
+    scopes->pool = g_thread_pool_new (scopes_worker, NULL, 1, FALSE, NULL);
+    if (!scopes->pool)
+        GST_DEBUG_OBJECT (sink, "No scopes worker, accumulating in the gl "
+                          "thread");
+}
+
+void
+scopes_init (GstGLESSink *sink)
+{
+    GstGLESScopes *scopes = &sink->gl_thread.gles.scopes;
+    gint i;
+
+    scopes->enabled = sink->scopes;
+    scopes->compute = FALSE;
+    scopes->next = 0;
+    scopes->frames = 0;
+    scopes->last_message = 0;
+    memset (scopes->message_due, 0, sizeof (scopes->message_due));
+
+    if (!scopes->enabled)
+        return;
+
+    for (i = 0; i < GST_GLES_SCOPES; i++)
+        scopes->tex[i] = scopes_create_texture ();
+
+    scopes->data = g_malloc0 (SCOPE_WORDS * 4);
+    scopes->image = g_malloc (SCOPE_COLUMNS * SCOPE_LEVELS * 4);
+
+    if (sink->gl_thread.gles.compute.available)
+        scopes->compute = scopes_init_compute (sink);
+
+    if (!scopes->compute) {
+        for (i = 0; i < GST_GLES_SCOPES; i++) {
+            glBindTexture (GL_TEXTURE_2D, scopes->tex[i]);
+            glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA, scope_width[i],
+                          scope_height[i], 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                          NULL);
+        }
+        scopes_init_fallback (sink);
+    }
+
+    GST_DEBUG_OBJECT (sink, "Scopes accumulate %s",
+                      scopes->compute ? "in compute shaders" : "on the cpu");
+}
+
+void
+scopes_close (GstGLESSink *sink)
+{
+    GstGLESScopes *scopes = &sink->gl_thread.gles.scopes;
+
+    if (!scopes->enabled)
+        return;
+
+    if (scopes->compute) {
+        gl_delete_shader (&scopes->accumulate);
+        gl_delete_shader (&scopes->render);
+        glDeleteBuffers (2, scopes->buf);
+    } else {
+        /* the worker may still be on the last samples */
+        if (scopes->pool)
+            g_thread_pool_free (scopes->pool, FALSE, TRUE);
+        scopes->pool = NULL;
+        g_mutex_clear (&scopes->lock);
+
+        glDeleteFramebuffers (2, scopes->sample_framebuffer);
+        glDeleteTextures (2, scopes->sample_tex);
+    }
+    glDeleteTextures (GST_GLES_SCOPES, scopes->tex);
+
+    g_free (scopes->samples);
+    g_free (scopes->data);
+    g_free (scopes->image);
+    g_free (scopes->images);
+    scopes->samples = NULL;
+    scopes->data = NULL;
+    scopes->image = NULL;
+    scopes->images = NULL;
+    scopes->enabled = 0;
+    scopes->compute = FALSE;
+}
+
+static GstBuffer *
+scopes_buffer (gconstpointer data, gsize size)
+{
+    GstBuffer *buf = gst_buffer_new_and_alloc (size);
+
+#if GST_CHECK_VERSION(1, 0, 0)
+    gst_buffer_fill (buf, 0, data, size);
+#else
+    memcpy (GST_BUFFER_DATA (buf), data, size);
+#endif
+
+    return buf;
+}
+
+/* scales counts to bytes relative to the peak */
+static void
+scopes_normalize (guint8 *out, const guint32 *counts, gint n, guint32 peak)
+{
+    gint i;
+
+    for (i = 0; i < n; i++)
+        out[i] = peak ? (guint64) counts[i] * 255 / peak : 0;
+}
+
+/*
+ * Posts the scopes of a frame as a glessink-scopes element message. The
+ * histograms are four times 256 guint32 counts in native byte order, for
+ * luma, red, green and blue. The waveform holds 256 levels per column for
+ * 256 columns, the vectorscope 128 cb values per cr row, both as bytes
+ * scaled to their peak.
+ */
+static void
+scopes_post_message (GstGLESSink *sink, const guint32 *data,
+                     GstClockTime timestamp)
+{
+    GstGLESScopes *scopes = &sink->gl_thread.gles.scopes;
+    GstStructure *s;
+    GstBuffer *buf;
+
+    s = gst_structure_new ("glessink-scopes",
+                           "timestamp", G_TYPE_UINT64, timestamp,
+                           NULL);
+
+    if (scopes->enabled & GST_GLES_SCOPE_HISTOGRAM) {
+        buf = scopes_buffer (data + SCOPE_HISTOGRAM_OFFSET,
+                             4 * SCOPE_LEVELS * sizeof (guint32));
+        gst_structure_set (s, "histogram", GST_TYPE_BUFFER, buf, NULL);
+        gst_buffer_unref (buf);
+    }
+
+    if (scopes->enabled & GST_GLES_SCOPE_WAVEFORM) {
+        scopes_normalize (scopes->image, data + SCOPE_WAVEFORM_OFFSET,
+                          SCOPE_COLUMNS * SCOPE_LEVELS,
+                          data[SCOPE_PEAK_OFFSET + 1]);
+        buf = scopes_buffer (scopes->image, SCOPE_COLUMNS * SCOPE_LEVELS);
+        gst_structure_set (s, "waveform", GST_TYPE_BUFFER, buf, NULL);
+        gst_buffer_unref (buf);
+    }
+
+    if (scopes->enabled & GST_GLES_SCOPE_VECTORSCOPE) {
+        scopes_normalize (scopes->image, data + SCOPE_VECTOR_OFFSET,
+                          SCOPE_VECTOR * SCOPE_VECTOR,
+                          data[SCOPE_PEAK_OFFSET + 2]);
+        buf = scopes_buffer (scopes->image, SCOPE_VECTOR * SCOPE_VECTOR);
+        gst_structure_set (s, "vectorscope", GST_TYPE_BUFFER, buf, NULL);
+        gst_buffer_unref (buf);
+    }
+
+    gst_element_post_message (GST_ELEMENT (sink),
+        gst_message_new_element (GST_OBJECT (sink), s));
+}
+
+/* returns TRUE if a message is due with this update */
+static gboolean
+scopes_message_due (GstGLESSink *sink)
+{
+    GstGLESScopes *scopes = &sink->gl_thread.gles.scopes;
+    gint64 now;
+
+    if (!sink->scope_message_interval)
+        return FALSE;
+
+    now = g_get_monotonic_time ();
+    if (scopes->last_message &&
+        now - scopes->last_message <
+        (gint64) sink->scope_message_interval * G_TIME_SPAN_MILLISECOND)
+        return FALSE;
+
+    scopes->last_message = now;
+    return TRUE;
+}
+
+/* posts the message of the last update from its buffer, which the GPU
+ * has finished by now */
+static void
+scopes_read_compute (GstGLESSink *sink, gint i)
+{
+    GstGLESCompute *compute = &sink->gl_thread.gles.compute;
+    GstGLESScopes *scopes = &sink->gl_thread.gles.scopes;
+    const guint32 *data;
+
+    scopes->message_due[i] = FALSE;
+
+    glBindBuffer (GL_SHADER_STORAGE_BUFFER, scopes->buf[i]);
+    data = compute->map_buffer_range (GL_SHADER_STORAGE_BUFFER, 0,
+                                      SCOPE_WORDS * 4, GL_MAP_READ_BIT_EXT);
+    if (!data) {
+        GST_DEBUG_OBJECT (sink, "Could not map the scopes buffer");
+        return;
+    }
+
+    scopes_post_message (sink, data, scopes->message_time[i]);
+    compute->unmap_buffer (GL_SHADER_STORAGE_BUFFER);
+}
+
+/*
+ * Every invocation adds its pixel to the scopes, the histograms through
+ * shared memory per work group. A second dispatch draws the images from
+ * the counts, so nothing passes the cpu unless a message is due.
+ */
+static void
+scopes_update_compute (GstGLESSink *sink, gboolean message)
+{
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    GstGLESCompute *compute = &gles->compute;
+    GstGLESScopes *scopes = &gles->scopes;
+    gint width = GST_VIDEO_SINK_WIDTH (sink);
+    gint height = GST_VIDEO_SINK_HEIGHT (sink);
+    gint i = scopes->next;
+    gint k;
+
+    if (scopes->message_due[!i])
+        scopes_read_compute (sink, !i);
+
+    glBindBuffer (GL_SHADER_STORAGE_BUFFER, scopes->buf[i]);
+    glBufferSubData (GL_SHADER_STORAGE_BUFFER, 0, SCOPE_WORDS * 4,
+                     scopes->data);
+    compute->bind_buffer_base (GL_SHADER_STORAGE_BUFFER, 0, scopes->buf[i]);
+
+    glUseProgram (scopes->accumulate.program);
+    glActiveTexture (GL_TEXTURE0);
+    glBindTexture (GL_TEXTURE_2D, gles->rgb_tex.id);
+    compute->dispatch_compute ((width + SCOPE_GROUP - 1) / SCOPE_GROUP,
+                               (height + SCOPE_GROUP - 1) / SCOPE_GROUP, 1);
+    compute->memory_barrier (GL_SHADER_STORAGE_BARRIER_BIT);
+
+    glUseProgram (scopes->render.program);
+    for (k = 0; k < GST_GLES_SCOPES; k++)
+        compute->bind_image_texture (k, scopes->tex[k], 0, GL_FALSE, 0,
+                                     GL_WRITE_ONLY_OES, GL_RGBA8_OES);
+    compute->dispatch_compute (SCOPE_COLUMNS / SCOPE_GROUP,
+                               SCOPE_LEVELS / SCOPE_GROUP, 1);
+    compute->memory_barrier (GL_TEXTURE_FETCH_BARRIER_BIT |
+                             (message ? GL_BUFFER_UPDATE_BARRIER_BIT : 0));
+
+    scopes->message_due[i] = message;
+    scopes->message_time[i] = sink->gl_thread.pts;
+    scopes->next = !i;
+}
+
+/* adds one rgba pixel to the scopes, as the accumulation shader does */
+static inline void
+scopes_add (guint32 *data, const guint8 *p, guint column)
+{
+    gint y = (77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8;
+    gint cb = ((p[2] - y) * 144 + 128 * 256) >> 9;
+    gint cr = ((p[0] - y) * 183 + 128 * 256) >> 9;
+    guint32 *w = &data[SCOPE_WAVEFORM_OFFSET + column * SCOPE_LEVELS + y];
+    guint32 *v;
+
+    cb = CLAMP (cb, 0, SCOPE_VECTOR - 1);
+    cr = CLAMP (cr, 0, SCOPE_VECTOR - 1);
+    v = &data[SCOPE_VECTOR_OFFSET + cr * SCOPE_VECTOR + cb];
+
+    data[SCOPE_HISTOGRAM_OFFSET + y]++;
+    data[SCOPE_HISTOGRAM_OFFSET + SCOPE_LEVELS + p[0]]++;
+    data[SCOPE_HISTOGRAM_OFFSET + 2 * SCOPE_LEVELS + p[1]]++;
+    data[SCOPE_HISTOGRAM_OFFSET + 3 * SCOPE_LEVELS + p[2]]++;
+
+    data[SCOPE_PEAK_OFFSET + 1] = MAX (data[SCOPE_PEAK_OFFSET + 1], ++*w);
+    data[SCOPE_PEAK_OFFSET + 2] = MAX (data[SCOPE_PEAK_OFFSET + 2], ++*v);
+}
+
+/* draws the images from the counts, matching the render shader */
+static void
+scopes_render_images (GstGLESScopes *scopes)
+{
+    const guint32 *data = scopes->data;
+    const guint32 *hist = data + SCOPE_HISTOGRAM_OFFSET;
+    guint32 peak_w = data[SCOPE_PEAK_OFFSET + 1];
+    guint32 peak_v = data[SCOPE_PEAK_OFFSET + 2];
+    guint32 peak = 1;
+    guint8 *p;
+    gint x, y, c;
+
+    for (x = 0; x < 4 * SCOPE_LEVELS; x++)
+        peak = MAX (peak, hist[x]);
+
+    p = scopes->images + scopes_image_offset (0);
+    for (y = 0; y < SCOPE_HISTOGRAM_HEIGHT; y++) {
+        guint32 level = (guint64) peak * (2 * y + 1) /
+                        (2 * SCOPE_HISTOGRAM_HEIGHT);
+
+        for (x = 0; x < SCOPE_LEVELS; x++, p += 4) {
+            gint grey = hist[x] > level ? 204 : 26;
+
+            for (c = 0; c < 3; c++)
+                p[c] = MIN (grey + (hist[(c + 1) * SCOPE_LEVELS + x] > level ?
+                                    128 : 0), 255);
+            p[3] = 255;
+        }
+    }
+
+    p = scopes->images + scopes_image_offset (1);
+    for (y = 0; y < SCOPE_LEVELS; y++) {
+        for (x = 0; x < SCOPE_COLUMNS; x++, p += 4) {
+            guint32 n = data[SCOPE_WAVEFORM_OFFSET + x * SCOPE_LEVELS + y];
+
+            p[0] = p[2] = 26;
+            p[1] = peak_w ? 26 + (guint64) n * 229 / peak_w : 26;
+            p[3] = 255;
+        }
+    }
+
+    p = scopes->images + scopes_image_offset (2);
+    for (y = 0; y < SCOPE_VECTOR * SCOPE_VECTOR; y++, p += 4) {
+        guint32 n = data[SCOPE_VECTOR_OFFSET + y];
+
+        p[0] = p[2] = 26;
+        p[1] = peak_v ? 26 + (guint64) n * 229 / peak_v : 26;
+        p[3] = 255;
+    }
+}
+
+/* uploads the images the worker drew */
+static void
+scopes_upload_images (GstGLESScopes *scopes)
+{
+    gint i;
+
+    for (i = 0; i < GST_GLES_SCOPES; i++) {
+        glBindTexture (GL_TEXTURE_2D, scopes->tex[i]);
+        glTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0, scope_width[i],
+                         scope_height[i], GL_RGBA, GL_UNSIGNED_BYTE,
+                         scopes->images + scopes_image_offset (i));
+    }
+}
+
+/* accumulates the samples read back, off the gl thread */
+static void
+scopes_worker (gpointer data, gpointer user_data)
+{
+    GstGLESSink *sink = data;
+    GstGLESScopes *scopes = &sink->gl_thread.gles.scopes;
+    const guint8 *p = scopes->samples;
+    gint x, y;
+
+    memset (scopes->data, 0, SCOPE_WORDS * 4);
+    for (y = 0; y < SCOPE_SAMPLE_HEIGHT; y++) {
+        for (x = 0; x < SCOPE_SAMPLE_WIDTH; x++, p += 4)
+            scopes_add (scopes->data, p,
+                        x * SCOPE_COLUMNS / SCOPE_SAMPLE_WIDTH);
+    }
+
+    if (scopes->job_overlay)
+        scopes_render_images (scopes);
+
+    if (scopes->job_message)
+        scopes_post_message (sink, scopes->data, scopes->job_time);
+
+    g_mutex_lock (&scopes->lock);
+    scopes->ready = scopes->job_overlay;
+    scopes->busy = FALSE;
+    g_mutex_unlock (&scopes->lock);
+}
+
+/*
+ * Without compute shaders the converted frame is drawn at sample size,
+ * which the GPU filters down. The target drawn with the update before is
+ * read back, which does not wait for the GPU, and handed to the worker,
+ * whose images are uploaded with the next update.
+ */
+static void
+scopes_update_fallback (GstGLESSink *sink, gboolean message)
+{
+    GLfloat vVertices[] =
+    {
+        -1.0f, -1.0f,
+        0.0f, 0.0f,
+
+        1.0f, -1.0f,
+        1.0f, 0.0f,
+
+        1.0f, 1.0f,
+        1.0f, 1.0f,
+
+        -1.0f, 1.0f,
+        0.0f, 1.0f,
+    };
+    GLushort indices[] = { 0, 1, 2, 0, 2, 3 };
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    GstGLESScopes *scopes = &gles->scopes;
+    gint i = scopes->next;
+
+    if (scopes->ready) {
+        scopes_upload_images (scopes);
+        scopes->ready = FALSE;
+    }
+
+    if (scopes->sample_pending[!i]) {
+        glBindFramebuffer (GL_FRAMEBUFFER, scopes->sample_framebuffer[!i]);
+        glReadPixels (0, 0, SCOPE_SAMPLE_WIDTH, SCOPE_SAMPLE_HEIGHT, GL_RGBA,
+                      GL_UNSIGNED_BYTE, scopes->samples);
+        scopes->sample_pending[!i] = FALSE;
+
+        scopes->job_overlay = sink->scope_overlay;
+        scopes->job_message = scopes->message_due[!i];
+        scopes->job_time = scopes->message_time[!i];
+        if (scopes->pool) {
+            g_mutex_lock (&scopes->lock);
+            scopes->busy = TRUE;
+            g_mutex_unlock (&scopes->lock);
+            g_thread_pool_push (scopes->pool, sink, NULL);
+        } else {
+            scopes_worker (sink, NULL);
+            if (scopes->ready) {
+                scopes_upload_images (scopes);
+                scopes->ready = FALSE;
+            }
+        }
+    }
+
+    glBindFramebuffer (GL_FRAMEBUFFER, scopes->sample_framebuffer[i]);
+    glViewport (0, 0, SCOPE_SAMPLE_WIDTH, SCOPE_SAMPLE_HEIGHT);
+
+    glUseProgram (gles->scale.program);
+    glActiveTexture (GL_TEXTURE3);
+    glBindTexture (GL_TEXTURE_2D, gles->rgb_tex.id);
+    glUniform1i (gles->rgb_tex.loc, 3);
+    gl_draw_quad (sink, &gles->scale, vVertices, indices);
+    glBindFramebuffer (GL_FRAMEBUFFER, gles->framebuffer);
+
+    scopes->sample_pending[i] = TRUE;
+    scopes->message_due[i] = message;
+    scopes->message_time[i] = sink->gl_thread.pts;
+    scopes->next = !i;
+}
+
+/* returns TRUE while the worker of the fallback accumulates */
+static gboolean
+scopes_busy (GstGLESScopes *scopes)
+{
+    gboolean busy;
+
+    g_mutex_lock (&scopes->lock);
+    busy = scopes->busy;
+    g_mutex_unlock (&scopes->lock);
+
+    return busy;
+}
+
+void
+scopes_update (GstGLESSink *sink)
+{
+    GstGLESScopes *scopes = &sink->gl_thread.gles.scopes;
+    gboolean message;
+
+    if (!scopes->enabled ||
+        (!sink->scope_overlay && !sink->scope_message_interval))
+        return;
+
+    if (scopes->frames++ % MAX (sink->scope_interval, 1))
+        return;
+
+    /* updates coming while the worker is still on an earlier frame are
+     * skipped */
+    if (!scopes->compute && scopes_busy (scopes))
+        return;
+
+    message = scopes_message_due (sink);
+    if (scopes->compute)
+        scopes_update_compute (sink, message);
+    else
+        scopes_update_fallback (sink, message);
+}
+
+void
+scopes_draw_overlay (GstGLESSink *sink)
+{
+    GLfloat vVertices[] =
+    {
+        -1.0f, -1.0f,
+        0.0f, 0.0f,
+
+        1.0f, -1.0f,
+        1.0f, 0.0f,
+
+        1.0f, 1.0f,
+        1.0f, 1.0f,
+
+        -1.0f, 1.0f,
+        0.0f, 1.0f,
+    };
+    GLushort indices[] = { 0, 1, 2, 0, 2, 3 };
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    GstGLESScopes *scopes = &gles->scopes;
+    gint height = MAX (sink->x11.height / 4, 64);
+    gint x = 8;
+    gint i;
+
+    if (!scopes->enabled || !sink->scope_overlay)
+        return;
+
+    glUseProgram (gles->scale.program);
+    glActiveTexture (GL_TEXTURE3);
+    glUniform1i (gles->rgb_tex.loc, 3);
+
+    /* panels left to right, the vectorscope square, the others twice as
+     * wide as high */
+    for (i = 0; i < GST_GLES_SCOPES; i++) {
+        gint width = i == 2 ? height : 2 * height;
+
+        if (!(scopes->enabled & (1 << i)))
+            continue;
+
+        glViewport (x, 8, width, height);
+        glBindTexture (GL_TEXTURE_2D, scopes->tex[i]);
+        gl_draw_quad (sink, &gles->scale, vVertices, indices);
+        x += width + 8;
+    }
+}
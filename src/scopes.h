@@ -0,0 +1,139 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef _SCOPES_H__
+#define _SCOPES_H__
+
+#include <glib.h>
+
+#include <GLES2/gl2.h>
+
+#include "shader.h"
+
+/* scopes selected by the scopes property */
+#define GST_GLES_SCOPE_HISTOGRAM   (1 << 0)
+#define GST_GLES_SCOPE_WAVEFORM    (1 << 1)
+#define GST_GLES_SCOPE_VECTORSCOPE (1 << 2)
+#define GST_GLES_SCOPES            3
+
+/* levels of the histogram and the waveform, columns of the waveform */
+#define SCOPE_LEVELS 256
+#define SCOPE_COLUMNS 256
+/* edge length of the vectorscope */
+#define SCOPE_VECTOR 128
+/* height of the histogram image */
+#define SCOPE_HISTOGRAM_HEIGHT 128
+
+/* frame size the fragment fallback samples the scopes from */
+#define SCOPE_SAMPLE_WIDTH 256
+#define SCOPE_SAMPLE_HEIGHT 144
+
+/*
+ * Word layout of the accumulated scopes, shared by the shader storage
+ * buffer of the compute path and the cpu copy of the fallback: the luma,
+ * red, green and blue histograms, the luma waveform by column, the
+ * vectorscope by cr row and the peak bin of each of the three scopes.
+ */
+#define SCOPE_HISTOGRAM_OFFSET 0
+#define SCOPE_WAVEFORM_OFFSET (SCOPE_HISTOGRAM_OFFSET + 4 * SCOPE_LEVELS)
+#define SCOPE_VECTOR_OFFSET (SCOPE_WAVEFORM_OFFSET + \
+                             SCOPE_COLUMNS * SCOPE_LEVELS)
+#define SCOPE_PEAK_OFFSET (SCOPE_VECTOR_OFFSET + SCOPE_VECTOR * SCOPE_VECTOR)
+#define SCOPE_WORDS (SCOPE_PEAK_OFFSET + GST_GLES_SCOPES)
+
+typedef struct _GstGLESScopes      GstGLESScopes;
+
+struct _GstGLESScopes
+{
+    /* scopes computed, from the scopes property when the context was
+     * created, 0 if none are */
+    guint enabled;
+
+    /* set if the scopes accumulate with compute shaders */
+    gboolean compute;
+    GstGLESShader accumulate;
+    GstGLESShader render;
+
+    /* storage buffers updates alternate between, with the running time
+     * a message is due for once the GPU is done with the buffer */
+    GLuint buf[2];
+    gint next;
+    gboolean message_due[2];
+    GstClockTime message_time[2];
+
+    /* rgba images of the histogram, the waveform and the vectorscope */
+    GLuint tex[GST_GLES_SCOPES];
+
+    /* fallback: the frame drawn at sample size into targets updates
+     * alternate between, each read back with the next update once the
+     * GPU is done with it. on the compute path data stays zeroed and
+     * clears the buffers, image is scratch for the messages */
+    GLuint sample_framebuffer[2];
+    GLuint sample_tex[2];
+    gboolean sample_pending[2];
+    guint8 *samples;
+    guint32 *data;
+    guint8 *image;
+
+    /* worker accumulating the samples read back into data and drawing
+     * the three scope images into images, which the gl thread uploads
+     * with a later update. busy and ready are protected by lock, the
+     * job fields are set before the worker is started */
+    GThreadPool *pool;
+    GMutex lock;
+    gboolean busy;
+    gboolean ready;
+    guint8 *images;
+    gboolean job_overlay;
+    gboolean job_message;
+    GstClockTime job_time;
+
+    /* frames seen and the time of the last message */
+    guint64 frames;
+    gint64 last_message;
+};
+
+struct _GstGLESSink;
+
+/* parses a comma separated list of scope names, returns -1 if one is
+ * unknown */
+gint
+scopes_from_string (const gchar *names);
+/* returns the names of the scopes in the mask, to be freed */
+gchar *
+scopes_to_string (guint mask);
+
+/* sets up the enabled scopes in the current context, on the compute
+ * path if it is available */
+void
+scopes_init (struct _GstGLESSink *sink);
+void
+scopes_close (struct _GstGLESSink *sink);
+
+/* updates the scopes from the converted frame if one is due */
+void
+scopes_update (struct _GstGLESSink *sink);
+
+/* draws the scope images over the bottom left corner of the window */
+void
+scopes_draw_overlay (struct _GstGLESSink *sink);
+#endif
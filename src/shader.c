@@ -27,6 +27,8 @@
 #define GST_USE_UNSTABLE_API
 #include <gst/gst.h>
 #include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <EGL/egl.h>
 
 #include "shader.h"
 #include "gstglessink.h"
@@ -39,7 +41,18 @@ GST_DEBUG_CATEGORY_EXTERN (gst_gles_sink_debug);
 
 static const gchar* shader_basenames[] = {
     "deint_linear", /* SHADER_DEINT_LINEAR */
-    "copy" /* SHADER_COPY, simple linear scaled copy shader */
+    "copy", /* SHADER_COPY, simple linear scaled copy shader */
+    "deint_linear_packed", /* SHADER_DEINT_LINEAR_PACKED, single texture */
+    "deint_linear_nv12", /* SHADER_DEINT_LINEAR_NV12, luma and rg chroma */
+    "convert_compute", /* SHADER_CONVERT_COMPUTE, GLES 3.1 */
+    "convert_compute_nv12", /* SHADER_CONVERT_COMPUTE_NV12, GLES 3.1 */
+    "reduce_compute", /* SHADER_REDUCE_COMPUTE, luma statistics */
+    "scope_accumulate", /* SHADER_SCOPE_ACCUMULATE, video scopes */
+    "scope_render", /* SHADER_SCOPE_RENDER, scope images */
+    "autocrop", /* SHADER_AUTOCROP, row and column luma means */
+    "motion_diff", /* SHADER_MOTION_DIFF, motion grid */
+    "copy_motion", /* SHADER_COPY_MOTION, copy with motion outlines */
+    "text" /* SHADER_TEXT, glyphs from the atlas */
 };
 
 #ifndef DATA_DIR
@@ -51,10 +64,42 @@ static const gchar* shader_basenames[] = {
 
 #define VERTEX_SHADER_BASENAME "vertex"
 
-static gboolean gl_extension_available(const gchar *extension)
+typedef const GLubyte *(GL_APIENTRYP PFNGLGETSTRINGIPROC) (GLenum name,
+                                                          GLuint index);
+
+#ifndef GL_NUM_EXTENSIONS
+#define GL_NUM_EXTENSIONS 0x821D
+#endif
+
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+
+gboolean gl_extension_available(const gchar *extension)
 {
     const gchar *gl_extensions = (gchar*)glGetString(GL_EXTENSIONS);
-    return (g_strstr_len(gl_extensions, -1, extension) != NULL);
+    PFNGLGETSTRINGIPROC get_stringi;
+    GLint n = 0;
+    GLint i;
+
+    if (gl_extensions)
+        return (g_strstr_len(gl_extensions, -1, extension) != NULL);
+
+    /* core desktop contexts only list extensions one by one, and flag
+     * the query above as an error */
+    glGetError ();
+    get_stringi = (PFNGLGETSTRINGIPROC) eglGetProcAddress ("glGetStringi");
+    if (!get_stringi)
+        return FALSE;
+
+    glGetIntegerv (GL_NUM_EXTENSIONS, &n);
+    for (i = 0; i < n; i++) {
+        if (!g_strcmp0 ((const gchar *) get_stringi (GL_EXTENSIONS, i),
+                        extension))
+            return TRUE;
+    }
+
+    return FALSE;
 }
 
 static GLuint
@@ -137,6 +182,13 @@ gl_load_source_shader (GstElement *sink, const char *shader_filename,
         return 0;
     }
 
+    if (GST_GLES_SINK (sink)->gl_thread.gles.desktop) {
+        gchar *desktop_src = desktop_shader_source (shader_src, type);
+
+        g_free (shader_src);
+        shader_src = desktop_src;
+    }
+
     /* load source into shader object */
     src_len = strlen (shader_src);
     glShaderSource (shader, 1, (const GLchar**) &shader_src,
@@ -178,7 +230,8 @@ gl_load_source_shader (GstElement *sink, const char *shader_filename,
  * If no binary is found the source file is taken and compiled at
  * runtime. */
 static GLuint
-gl_load_shader (GstElement *sink, const gchar *basename, const GLenum type)
+gl_load_shader (GstElement *sink, const gchar *basename, const GLenum type,
+                gboolean source_only)
 {
     GstGLESSink *el = GST_GLES_SINK (sink);
     gchar *filename;
@@ -188,7 +241,10 @@ gl_load_shader (GstElement *sink, const gchar *basename, const GLenum type)
                                 SHADER_EXT_BINARY);
     GST_DEBUG_OBJECT (el, "Load binary shader from %s", filename);
 
-    shader = gl_load_binary_shader (sink, filename, type);
+    /* the binaries are built for GLES */
+    shader = 0;
+    if (!el->gl_thread.gles.desktop && !source_only)
+        shader = gl_load_binary_shader (sink, filename, type);
     if (!shader) {
         g_free (filename);
         filename = g_strdup_printf ("%s/%s%s", DATA_DIR,
@@ -212,19 +268,82 @@ gl_load_shaders (GstElement *sink, GstGLESShader *shader,
                  GstGLESShaderTypes process_type)
 {
     shader->vertex_shader = gl_load_shader (sink, VERTEX_SHADER_BASENAME,
-                                          GL_VERTEX_SHADER);
+                                          GL_VERTEX_SHADER,
+                                          shader->source_only);
     if (!shader->vertex_shader)
         return -EINVAL;
 
     shader->fragment_shader = gl_load_shader (sink,
                                             shader_basenames[process_type],
-                                            GL_FRAGMENT_SHADER);
+                                            GL_FRAGMENT_SHADER,
+                                            shader->source_only);
     if (!shader->fragment_shader)
         return -EINVAL;
 
     return 0;
 }
 
+/*
+ * Links the program from the cached binary of an earlier context,
+ * returns TRUE on success. The driver may reject a binary, e.g. after an
+ * update, in which case the cache is dropped and the sources are used.
+ */
+static gboolean
+gl_load_program_binary (GstElement *sink, GstGLESShader *shader)
+{
+    PFNGLPROGRAMBINARYOESPROC program_binary;
+    gint linked = 0;
+
+    if (!shader->binary ||
+        !gl_extension_available ("GL_OES_get_program_binary"))
+        return FALSE;
+
+    program_binary = (PFNGLPROGRAMBINARYOESPROC)
+        eglGetProcAddress ("glProgramBinaryOES");
+    if (!program_binary)
+        return FALSE;
+
+    program_binary (shader->program, shader->binary_format, shader->binary,
+                    shader->binary_length);
+    glGetProgramiv (shader->program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        GST_DEBUG_OBJECT (sink, "Cached program binary rejected");
+        gl_free_shader_binary (shader);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* keeps the binary of the freshly linked program for the next context */
+static void
+gl_save_program_binary (GstElement *sink, GstGLESShader *shader)
+{
+    PFNGLGETPROGRAMBINARYOESPROC get_program_binary;
+    GLint length = 0;
+
+    if (shader->binary ||
+        !gl_extension_available ("GL_OES_get_program_binary"))
+        return;
+
+    get_program_binary = (PFNGLGETPROGRAMBINARYOESPROC)
+        eglGetProcAddress ("glGetProgramBinaryOES");
+    if (!get_program_binary)
+        return;
+
+    glGetProgramiv (shader->program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+    if (length <= 0)
+        return;
+
+    shader->binary = g_malloc (length);
+    get_program_binary (shader->program, length, &shader->binary_length,
+                        &shader->binary_format, shader->binary);
+    if (glGetError () != GL_NO_ERROR) {
+        GST_DEBUG_OBJECT (sink, "Could not retrieve the program binary");
+        gl_free_shader_binary (shader);
+    }
+}
+
 gint
 gl_init_shader (GstElement *sink, GstGLESShader *shader,
                 GstGLESShaderTypes process_type)
@@ -233,12 +352,16 @@ gl_init_shader (GstElement *sink, GstGLESShader *shader,
     GLint err;
     gint ret;
 
+    shader->compute = FALSE;
     shader->program = glCreateProgram();
     if(!shader->program) {
         GST_ERROR_OBJECT(sink, "Could not create GL program");
         return -ENOMEM;
     }
 
+    if (gl_load_program_binary (sink, shader))
+        goto use_program;
+
     /* load the shaders */
     ret = gl_load_shaders(sink, shader, process_type);
     if(ret < 0) {
@@ -280,6 +403,9 @@ gl_init_shader (GstElement *sink, GstGLESShader *shader,
         return -EINVAL;
     }
 
+    gl_save_program_binary (sink, shader);
+
+use_program:
     glUseProgram(shader->program);
 
     shader->position_loc = glGetAttribLocation(shader->program, "vPosition");
@@ -290,6 +416,64 @@ gl_init_shader (GstElement *sink, GstGLESShader *shader,
     return 0;
 }
 
+/*
+ * Compute programs consist of a single shader. They are only loaded from
+ * source, the platform binaries predate GLES 3.1. */
+gint
+gl_init_compute_shader (GstElement *sink, GstGLESShader *shader,
+                        GstGLESShaderTypes process_type)
+{
+    gchar *filename;
+    gint linked = 0;
+
+    shader->compute = TRUE;
+    shader->program = glCreateProgram ();
+    if (!shader->program) {
+        GST_ERROR_OBJECT (sink, "Could not create GL program");
+        return -ENOMEM;
+    }
+
+    if (gl_load_program_binary (sink, shader))
+        return 0;
+
+    filename = g_strdup_printf ("%s/%s%s", DATA_DIR,
+                                shader_basenames[process_type],
+                                SHADER_EXT_SOURCE);
+    GST_DEBUG_OBJECT (sink, "Load compute shader from %s", filename);
+    shader->compute_shader = gl_load_source_shader (sink, filename,
+                                                    GL_COMPUTE_SHADER);
+    g_free (filename);
+    if (!shader->compute_shader) {
+        glDeleteProgram (shader->program);
+        shader->program = 0;
+        return -EINVAL;
+    }
+
+    glAttachShader (shader->program, shader->compute_shader);
+    glLinkProgram (shader->program);
+
+    glGetProgramiv (shader->program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        GLint info_len = 0;
+
+        glGetProgramiv (shader->program, GL_INFO_LOG_LENGTH, &info_len);
+        if (info_len > 1) {
+            char *info_log = malloc (sizeof(char) * info_len);
+            glGetProgramInfoLog (shader->program, info_len, NULL, info_log);
+
+            GST_ERROR_OBJECT (sink, "Failed to link compute program: %s",
+                              info_log);
+            free (info_log);
+        }
+
+        gl_delete_shader (shader);
+        return -EINVAL;
+    }
+
+    gl_save_program_binary (sink, shader);
+    return 0;
+}
+
 void
 gl_delete_shader(GstGLESShader *shader)
 {
@@ -299,6 +483,18 @@ gl_delete_shader(GstGLESShader *shader)
     glDeleteShader (shader->fragment_shader);
     shader->fragment_shader = 0;
 
+    glDeleteShader (shader->compute_shader);
+    shader->compute_shader = 0;
+
     glDeleteProgram (shader->program);
     shader->program = 0;
 }
+
+void
+gl_free_shader_binary (GstGLESShader *shader)
+{
+    g_free (shader->binary);
+    shader->binary = NULL;
+    shader->binary_length = 0;
+    shader->binary_format = 0;
+}
@@ -28,7 +28,18 @@ typedef struct _GstGLESShader      GstGLESShader;
 
 enum _GstGLESShaderTypes {
     SHADER_DEINT_LINEAR = 0,
-    SHADER_COPY
+    SHADER_COPY,
+    SHADER_DEINT_LINEAR_PACKED,
+    SHADER_DEINT_LINEAR_NV12,
+    SHADER_CONVERT_COMPUTE,
+    SHADER_CONVERT_COMPUTE_NV12,
+    SHADER_REDUCE_COMPUTE,
+    SHADER_SCOPE_ACCUMULATE,
+    SHADER_SCOPE_RENDER,
+    SHADER_AUTOCROP,
+    SHADER_MOTION_DIFF,
+    SHADER_COPY_MOTION,
+    SHADER_TEXT
 };
 
 struct _GstGLESShader
@@ -36,10 +47,25 @@ struct _GstGLESShader
     gint program;
     GLuint vertex_shader;
     GLuint fragment_shader;
+    GLuint compute_shader;
+
+    /* set for compute programs, also when relinked from the binary
+     * without a compute_shader */
+    gboolean compute;
+
+    /* set to compile the sources even where precompiled binaries are
+     * shipped */
+    gboolean source_only;
 
     /* standard locations, used in most shaders */
     GLint position_loc;
     GLint texcoord_loc;
+
+    /* linked program as returned by GL_OES_get_program_binary, kept
+     * across contexts so a lost context relinks without compiling */
+    gpointer binary;
+    GLint binary_length;
+    GLenum binary_format;
 };
 
 struct _GstGLESTexture
@@ -55,4 +81,17 @@ gl_init_shader (GstElement *sink, GstGLESShader *shader,
                 GstGLESShaderTypes process_type);
 void
 gl_delete_shader (GstGLESShader *shader);
+
+/* initialises a GLES 3.1 compute program, returns 0 on success */
+gint
+gl_init_compute_shader (GstElement *sink, GstGLESShader *shader,
+                        GstGLESShaderTypes process_type);
+
+/* drops the cached program binary, gl_delete_shader keeps it */
+void
+gl_free_shader_binary (GstGLESShader *shader);
+
+/* checks the GL_EXTENSIONS string of the current context */
+gboolean
+gl_extension_available (const gchar *extension);
 #endif
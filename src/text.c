@@ -0,0 +1,475 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+#include <glib.h>
+#include <gst/gst.h>
+#include <X11/Xlib.h>
+
+#include "gstglessink.h"
+#include "shader.h"
+#include "text.h"
+
+/* distance of the text from the window edges in pixels */
+#define TEXT_MARGIN 8
+
+static const gchar *text_position_names[] = {
+    "top-left", /* GST_GLES_TEXT_TOP_LEFT */
+    "top-right", /* GST_GLES_TEXT_TOP_RIGHT */
+    "bottom-left", /* GST_GLES_TEXT_BOTTOM_LEFT */
+    "bottom-right" /* GST_GLES_TEXT_BOTTOM_RIGHT */
+};
+
+gint
+text_position_from_name (const gchar *name)
+{
+    guint i;
+
+    if (!name)
+        return GST_GLES_TEXT_TOP_LEFT;
+
+    for (i = 0; i < G_N_ELEMENTS (text_position_names); i++) {
+        if (!strcmp (name, text_position_names[i]))
+            return i;
+    }
+
+    return -1;
+}
+
+const gchar *
+text_position_name (gint position)
+{
+    return text_position_names[position];
+}
+
+void
+text_init (GstGLESSink *sink)
+{
+    GstGLESText *text = &sink->gl_thread.gles.text;
+    gint i;
+
+    text->available = FALSE;
+    text->atlas = 0;
+    text->n_glyphs = 0;
+    text->layout_width = 0;
+    text->fps_start = 0;
+    text->fps_frames = 0;
+    text->fps = 0;
+
+    if (gl_init_shader (GST_ELEMENT (sink), &text->shader, SHADER_TEXT) < 0) {
+        GST_WARNING_OBJECT (sink, "Could not initialize the text shader, "
+                            "no text is drawn");
+        return;
+    }
+    text->tex_loc = glGetUniformLocation (text->shader.program, "s_tex");
+    text->color_loc = glGetUniformLocation (text->shader.program, "color");
+
+    for (i = 0; i < TEXT_MAX_GLYPHS; i++) {
+        GLushort *index = &text->indices[6 * i];
+
+        index[0] = index[3] = 4 * i;
+        index[1] = 4 * i + 1;
+        index[2] = index[4] = 4 * i + 2;
+        index[5] = 4 * i + 3;
+    }
+
+    text->available = TRUE;
+}
+
+void
+text_close (GstGLESSink *sink)
+{
+    GstGLESText *text = &sink->gl_thread.gles.text;
+
+    if (text->available)
+        gl_delete_shader (&text->shader);
+    text->available = FALSE;
+
+    if (text->atlas)
+        glDeleteTextures (1, &text->atlas);
+    text->atlas = 0;
+
+    g_free (text->font);
+    text->font = NULL;
+}
+
+/*
+ * Rasterizes the printable ascii glyphs of the X core font name into the
+ * atlas, in cells wide enough for the widest glyph. The gl thread holds
+ * the display lock while it draws, headless without an X server there is
+ * no display and no atlas.
+ */
+static void
+text_build_atlas (GstGLESSink *sink, const gchar *name)
+{
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    GstGLESText *text = &gles->text;
+    Display *display = sink->x11.display;
+    gint n = TEXT_LAST_GLYPH - TEXT_FIRST_GLYPH + 1;
+    gint rows = (n + TEXT_ATLAS_COLUMNS - 1) / TEXT_ATLAS_COLUMNS;
+    unsigned long black;
+    gint screen;
+    XFontStruct *font;
+    XImage *image;
+    Pixmap pixmap;
+    guint8 *data;
+    gint origin;
+    GC gc;
+    gint x, y, i;
+
+    g_free (text->font);
+    text->font = g_strdup (name);
+    if (text->atlas)
+        glDeleteTextures (1, &text->atlas);
+    text->atlas = 0;
+    text->layout_width = 0;
+
+    /* the fonts come from the X server, headless there may be none */
+    if (!display) {
+        GST_WARNING_OBJECT (sink, "No X display to load font %s from, "
+                            "the text is not drawn", name);
+        return;
+    }
+    screen = DefaultScreen (display);
+    black = BlackPixel (display, screen);
+
+    font = XLoadQueryFont (display, name);
+    if (!font) {
+        GST_WARNING_OBJECT (sink, "Could not load font %s", name);
+        return;
+    }
+
+    /* glyphs reaching left of their origin are moved right */
+    origin = -MIN (font->min_bounds.lbearing, 0);
+    text->cell_width = MAX (font->max_bounds.width,
+                            font->max_bounds.rbearing + origin);
+    text->cell_height = font->ascent + font->descent;
+    text->atlas_width = text->cell_width * TEXT_ATLAS_COLUMNS;
+    text->atlas_height = text->cell_height * rows;
+
+    pixmap = XCreatePixmap (display, DefaultRootWindow (display),
+                            text->atlas_width, text->atlas_height,
+                            DefaultDepth (display, screen));
+    gc = XCreateGC (display, pixmap, 0, NULL);
+    XSetFont (display, gc, font->fid);
+    XSetForeground (display, gc, black);
+    XFillRectangle (display, pixmap, gc, 0, 0, text->atlas_width,
+                    text->atlas_height);
+    XSetForeground (display, gc, WhitePixel (display, screen));
+
+    for (i = 0; i < n; i++) {
+        char c = TEXT_FIRST_GLYPH + i;
+
+        XDrawString (display, pixmap, gc,
+                     (i % TEXT_ATLAS_COLUMNS) * text->cell_width + origin,
+                     (i / TEXT_ATLAS_COLUMNS) * text->cell_height +
+                     font->ascent, &c, 1);
+    }
+
+    image = XGetImage (display, pixmap, 0, 0, text->atlas_width,
+                       text->atlas_height, AllPlanes, ZPixmap);
+    XFreeGC (display, gc);
+    XFreePixmap (display, pixmap);
+    XFreeFont (display, font);
+    if (!image) {
+        GST_WARNING_OBJECT (sink, "Could not read back font %s", name);
+        return;
+    }
+
+    data = g_malloc ((gsize) text->atlas_width * text->atlas_height);
+    for (y = 0; y < text->atlas_height; y++) {
+        for (x = 0; x < text->atlas_width; x++)
+            data[y * text->atlas_width + x] =
+                XGetPixel (image, x, y) != black ? 255 : 0;
+    }
+    XDestroyImage (image);
+
+    glGenTextures (1, &text->atlas);
+    glBindTexture (GL_TEXTURE_2D, text->atlas);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D (GL_TEXTURE_2D, 0, gles->plane_internal_format,
+                  text->atlas_width, text->atlas_height, 0,
+                  gles->plane_format, GL_UNSIGNED_BYTE, data);
+    g_free (data);
+
+    GST_DEBUG_OBJECT (sink, "Built glyph atlas of %s, %dx%d cells", name,
+                      text->cell_width, text->cell_height);
+}
+
+static void
+text_append_time (GString *out, GstClockTime time)
+{
+    if (!GST_CLOCK_TIME_IS_VALID (time)) {
+        g_string_append (out, "-:--:--.---");
+        return;
+    }
+
+    g_string_append_printf (out, "%u:%02u:%02u.%03u",
+                            (guint) (time / (GST_SECOND * 60 * 60)),
+                            (guint) ((time / (GST_SECOND * 60)) % 60),
+                            (guint) ((time / GST_SECOND) % 60),
+                            (guint) ((time / GST_MSECOND) % 1000));
+}
+
+/*
+ * Replaces the fields of the template: {running-time} and {pts} of the
+ * frame shown, {fps} drawn, {drops} the display skipped or the watchdog
+ * dropped, {frames} rendered and the element {name}. Unknown fields stay
+ * as they are.
+ */
+static void
+text_expand (GstGLESSink *sink, const gchar *template, GString *out)
+{
+    GstGLESText *text = &sink->gl_thread.gles.text;
+    GstClockTime pts = sink->gl_thread.pts;
+    GstClockTime running_time = GST_CLOCK_TIME_NONE;
+    GstSegment *segment = &GST_BASE_SINK (sink)->segment;
+    const gchar *p = template;
+    guint64 frames;
+    guint64 drops;
+    gchar *name;
+
+    GST_OBJECT_LOCK (sink);
+    if (segment->format == GST_FORMAT_TIME && GST_CLOCK_TIME_IS_VALID (pts))
+        running_time = gst_segment_to_running_time (segment, GST_FORMAT_TIME,
+                                                    pts);
+    frames = sink->stats.rendered;
+    drops = sink->stats.skipped + sink->stats.watchdog_drops;
+    name = g_strdup (GST_OBJECT_NAME (sink));
+    GST_OBJECT_UNLOCK (sink);
+
+    while (*p) {
+        const gchar *end = p[0] == '{' ? strchr (p, '}') : NULL;
+        gsize len = end ? end - p - 1 : 0;
+
+        if (!end) {
+            g_string_append_c (out, *p++);
+            continue;
+        }
+
+        if (len == 12 && !strncmp (p + 1, "running-time", len))
+            text_append_time (out, running_time);
+        else if (len == 3 && !strncmp (p + 1, "pts", len))
+            text_append_time (out, pts);
+        else if (len == 3 && !strncmp (p + 1, "fps", len))
+            g_string_append_printf (out, "%.2f", text->fps);
+        else if (len == 5 && !strncmp (p + 1, "drops", len))
+            g_string_append_printf (out, "%" G_GUINT64_FORMAT, drops);
+        else if (len == 6 && !strncmp (p + 1, "frames", len))
+            g_string_append_printf (out, "%" G_GUINT64_FORMAT, frames);
+        else if (len == 4 && !strncmp (p + 1, "name", len))
+            g_string_append (out, name);
+        else
+            g_string_append_len (out, p, len + 2);
+        p = end + 1;
+    }
+
+    g_free (name);
+}
+
+/* writes the quad of glyph i */
+static void
+text_glyph_quad (GstGLESSink *sink, gint i, gint x0, gint y0, gint scale)
+{
+    GstGLESText *text = &sink->gl_thread.gles.text;
+    GLfloat *v = &text->vertices[16 * i];
+    gint cell = (guchar) text->glyph[i] - TEXT_FIRST_GLYPH;
+    gfloat width = text->layout_width;
+    gfloat height = text->layout_height;
+    gint x1, y1;
+    gfloat s0, s1, t0, t1;
+
+    x0 += text->column[i] * text->cell_width * scale;
+    y0 += text->line[i] * text->cell_height * scale;
+    x1 = x0 + text->cell_width * scale;
+    y1 = y0 + text->cell_height * scale;
+
+    s0 = (gfloat) (cell % TEXT_ATLAS_COLUMNS) * text->cell_width /
+         text->atlas_width;
+    s1 = s0 + (gfloat) text->cell_width / text->atlas_width;
+    t0 = (gfloat) (cell / TEXT_ATLAS_COLUMNS) * text->cell_height /
+         text->atlas_height;
+    t1 = t0 + (gfloat) text->cell_height / text->atlas_height;
+
+    /* window pixels run top down, the atlas rows as uploaded */
+    v[0] = 2 * x0 / width - 1;  v[1] = 1 - 2 * y1 / height;
+    v[2] = s0;                  v[3] = t1;
+    v[4] = 2 * x1 / width - 1;  v[5] = 1 - 2 * y1 / height;
+    v[6] = s1;                  v[7] = t1;
+    v[8] = 2 * x1 / width - 1;  v[9] = 1 - 2 * y0 / height;
+    v[10] = s1;                 v[11] = t0;
+    v[12] = 2 * x0 / width - 1; v[13] = 1 - 2 * y0 / height;
+    v[14] = s0;                 v[15] = t0;
+}
+
+/*
+ * Lays str out on the glyph grid. Only glyphs whose character or place
+ * changed get a new quad, unless the window, the scale, the corner or
+ * the size of the text block changed and all of them move.
+ */
+static void
+text_layout (GstGLESSink *sink, const gchar *str, gint scale, gint position)
+{
+    GstGLESText *text = &sink->gl_thread.gles.text;
+    gint width = sink->x11.width;
+    gint height = sink->x11.height;
+    gboolean all;
+    gint lines = 1;
+    gint columns = 0;
+    gint line = 0;
+    gint column = 0;
+    gint n = 0;
+    gboolean dirty[TEXT_MAX_GLYPHS];
+    gint x0, y0;
+    gint i;
+
+    for (; *str && n < TEXT_MAX_GLYPHS; str++) {
+        gchar c = *str;
+
+        if (c == '\n') {
+            line = lines++;
+            column = 0;
+            continue;
+        }
+        if ((guchar) c < TEXT_FIRST_GLYPH || (guchar) c > TEXT_LAST_GLYPH)
+            c = '?';
+
+        dirty[n] = n >= text->n_glyphs || text->glyph[n] != c ||
+                   text->line[n] != line || text->column[n] != column;
+        text->glyph[n] = c;
+        text->line[n] = line;
+        text->column[n] = column;
+
+        columns = MAX (columns, ++column);
+        n++;
+    }
+
+    all = text->layout_width != width || text->layout_height != height ||
+          text->layout_scale != scale || text->layout_position != position ||
+          text->layout_lines != lines || text->layout_columns != columns;
+    text->layout_width = width;
+    text->layout_height = height;
+    text->layout_scale = scale;
+    text->layout_position = position;
+    text->layout_lines = lines;
+    text->layout_columns = columns;
+    text->n_glyphs = n;
+
+    x0 = TEXT_MARGIN;
+    if (position == GST_GLES_TEXT_TOP_RIGHT ||
+        position == GST_GLES_TEXT_BOTTOM_RIGHT)
+        x0 = width - TEXT_MARGIN - columns * text->cell_width * scale;
+    y0 = TEXT_MARGIN;
+    if (position == GST_GLES_TEXT_BOTTOM_LEFT ||
+        position == GST_GLES_TEXT_BOTTOM_RIGHT)
+        y0 = height - TEXT_MARGIN - lines * text->cell_height * scale;
+
+    for (i = 0; i < n; i++) {
+        if (all || dirty[i])
+            text_glyph_quad (sink, i, x0, y0, scale);
+    }
+}
+
+/* counts the frames drawn and updates the rate once a second */
+static void
+text_count_frame (GstGLESText *text)
+{
+    gint64 now = g_get_monotonic_time ();
+
+    if (!text->fps_start)
+        text->fps_start = now;
+    text->fps_frames++;
+
+    if (now - text->fps_start >= G_USEC_PER_SEC) {
+        text->fps = (gdouble) text->fps_frames * G_USEC_PER_SEC /
+                    (now - text->fps_start);
+        text->fps_start = now;
+        text->fps_frames = 0;
+    }
+}
+
+void
+text_draw (GstGLESSink *sink)
+{
+    GstGLESText *text = &sink->gl_thread.gles.text;
+    GString *str;
+    gchar *template;
+    gchar *font;
+    gint scale;
+
+    text_count_frame (text);
+
+    GST_OBJECT_LOCK (sink);
+    template = g_strdup (sink->text);
+    font = g_strdup (sink->text_font);
+    scale = sink->text_scale;
+    GST_OBJECT_UNLOCK (sink);
+
+    if (!template || !*template || !font || !text->available)
+        goto done;
+
+    if (g_strcmp0 (font, text->font))
+        text_build_atlas (sink, font);
+    if (!text->atlas)
+        goto done;
+
+    str = g_string_new (NULL);
+    text_expand (sink, template, str);
+    text_layout (sink, str->str, scale, sink->text_position);
+    g_string_free (str, TRUE);
+
+    if (!text->n_glyphs)
+        goto done;
+
+    glUseProgram (text->shader.program);
+    glActiveTexture (GL_TEXTURE3);
+    glBindTexture (GL_TEXTURE_2D, text->atlas);
+    glUniform1i (text->tex_loc, 3);
+
+    glEnable (GL_BLEND);
+    glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    /* a shadow keeps the text readable on bright pictures */
+    glViewport (scale, -scale, sink->x11.width, sink->x11.height);
+    glUniform4f (text->color_loc, 0.0f, 0.0f, 0.0f, 0.8f);
+    gl_draw_quads (sink, &text->shader, text->vertices, text->indices,
+                   text->n_glyphs);
+
+    glViewport (0, 0, sink->x11.width, sink->x11.height);
+    glUniform4f (text->color_loc, 1.0f, 1.0f, 1.0f, 1.0f);
+    gl_draw_quads (sink, &text->shader, text->vertices, text->indices,
+                   text->n_glyphs);
+
+    glDisable (GL_BLEND);
+
+done:
+    g_free (template);
+    g_free (font);
+}
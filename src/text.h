@@ -0,0 +1,111 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef _TEXT_H__
+#define _TEXT_H__
+
+#include <glib.h>
+
+#include <GLES2/gl2.h>
+
+#include "shader.h"
+
+/* printable ascii the atlas holds, in rows of TEXT_ATLAS_COLUMNS */
+#define TEXT_FIRST_GLYPH 32
+#define TEXT_LAST_GLYPH 126
+#define TEXT_ATLAS_COLUMNS 16
+
+/* most glyphs drawn, the indices have to fit a GLushort */
+#define TEXT_MAX_GLYPHS 512
+
+/* corners of the window the text_position property selects */
+#define GST_GLES_TEXT_TOP_LEFT     0
+#define GST_GLES_TEXT_TOP_RIGHT    1
+#define GST_GLES_TEXT_BOTTOM_LEFT  2
+#define GST_GLES_TEXT_BOTTOM_RIGHT 3
+
+typedef struct _GstGLESText        GstGLESText;
+
+/*
+ * Text burn-in. The glyphs of an X core font are rasterized once into an
+ * atlas texture, strings are drawn from it as one batch of quads in the
+ * onscreen pass. Glyphs are laid out on a fixed grid, so a changed
+ * character only rewrites its own quad.
+ */
+struct _GstGLESText
+{
+    /* set if the program linked */
+    gboolean available;
+    GstGLESShader shader;
+    GLint tex_loc;
+    GLint color_loc;
+
+    /* atlas of the font named font, cell_width x cell_height texels per
+     * glyph, 0 if it could not be built */
+    GLuint atlas;
+    gchar *font;
+    gint cell_width;
+    gint cell_height;
+    gint atlas_width;
+    gint atlas_height;
+
+    /* glyphs laid out, with their line and column and the window size,
+     * scale, corner and block size the quads were laid out for */
+    gchar glyph[TEXT_MAX_GLYPHS];
+    gint line[TEXT_MAX_GLYPHS];
+    gint column[TEXT_MAX_GLYPHS];
+    gint n_glyphs;
+    gint layout_width;
+    gint layout_height;
+    gint layout_scale;
+    gint layout_position;
+    gint layout_lines;
+    gint layout_columns;
+
+    GLfloat vertices[TEXT_MAX_GLYPHS * 16];
+    GLushort indices[TEXT_MAX_GLYPHS * 6];
+
+    /* frames drawn since fps_start and the last measured rate */
+    gint64 fps_start;
+    guint fps_frames;
+    gdouble fps;
+};
+
+struct _GstGLESSink;
+
+/* converts between the corner and its name as used by the text_position
+ * property, returns -1 for unknown names */
+gint
+text_position_from_name (const gchar *name);
+const gchar *
+text_position_name (gint position);
+
+void
+text_init (struct _GstGLESSink *sink);
+void
+text_close (struct _GstGLESSink *sink);
+
+/* expands the text template for the frame shown and draws it over the
+ * window */
+void
+text_draw (struct _GstGLESSink *sink);
+#endif
@@ -0,0 +1,83 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "tiles.h"
+
+/* compares len bytes, 16 at a time where the cpu allows it */
+static inline gboolean
+tiles_row_equal (const guint8 *a, const guint8 *b, gint len)
+{
+    gint i = 0;
+
+#if defined(__SSE2__)
+    for (; i + 16 <= len; i += 16) {
+        __m128i eq = _mm_cmpeq_epi8 (
+                _mm_loadu_si128 ((const __m128i *) (a + i)),
+                _mm_loadu_si128 ((const __m128i *) (b + i)));
+        if (_mm_movemask_epi8 (eq) != 0xffff)
+            return FALSE;
+    }
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+    for (; i + 16 <= len; i += 16) {
+        uint64x2_t eq = vreinterpretq_u64_u8 (
+                vceqq_u8 (vld1q_u8 (a + i), vld1q_u8 (b + i)));
+        if ((vgetq_lane_u64 (eq, 0) & vgetq_lane_u64 (eq, 1)) !=
+            G_GUINT64_CONSTANT (0xffffffffffffffff))
+            return FALSE;
+    }
+#endif
+
+    return i >= len || memcmp (a + i, b + i, len - i) == 0;
+}
+
+gboolean
+tiles_update_rect (guint8 *shadow, const guint8 *data, gint stride,
+                   gint x, gint y, gint width, gint height)
+{
+    gsize offset = (gsize) y * stride + x;
+    gint row;
+
+    if (width <= 0 || height <= 0)
+        return FALSE;
+
+    for (row = 0; row < height; row++, offset += stride) {
+        if (!tiles_row_equal (shadow + offset, data + offset, width))
+            break;
+    }
+
+    if (row == height)
+        return FALSE;
+
+    /* the rows compared so far are equal, copy the remaining ones */
+    for (; row < height; row++, offset += stride)
+        memcpy (shadow + offset, data + offset, width);
+
+    return TRUE;
+}
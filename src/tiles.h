@@ -0,0 +1,36 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _TILES_H__
+#define _TILES_H__
+
+#include <glib.h>
+
+/* edge length of a luma tile, chroma tiles are half the size */
+#define TILE_SIZE 32
+
+/* compares a rectangle of a plane with its shadow copy, both using the
+ * same stride, and copies the new contents over if they differ.
+ * returns TRUE if the rectangle has changed */
+gboolean
+tiles_update_rect (guint8 *shadow, const guint8 *data, gint stride,
+                   gint x, gint y, gint width, gint height);
+#endif
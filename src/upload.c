@@ -0,0 +1,886 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Texture uploads go to a ring of texture sets. Without the upload
+ * thread, the gl thread uploads each frame into the next set the GPU is
+ * done with right before converting it, instead of rewriting textures a
+ * pending draw still reads. With the upload thread, a second context
+ * sharing the textures with the render context uploads the next frame
+ * into a free set while the gl thread draws the current one. Ownership
+ * of a set is passed through its state under the data_lock. An EGL fence
+ * behind the last commands using a set keeps either side from touching
+ * its textures, and the buffer it was uploaded from, before the GPU is
+ * done with them.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+#include <glib.h>
+
+#define GST_USE_UNSTABLE_API
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#if GST_CHECK_VERSION(1, 0, 0)
+#include <gst/video/gstvideometa.h>
+#endif
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include "gstglessink.h"
+#include "repack.h"
+#include "tiles.h"
+#include "upload.h"
+
+/* repack threads used if not set, at most one per cpu */
+#define DEFAULT_REPACK_THREADS 4
+
+static gpointer uploader_proc (gpointer data);
+
+gboolean
+egl_init_fences (GstGLESSink *sink)
+{
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    const gchar *extensions = eglQueryString (gles->display, EGL_EXTENSIONS);
+
+    gles->fence_sync = FALSE;
+
+    if (!extensions || !g_strstr_len (extensions, -1, "EGL_KHR_fence_sync"))
+        return FALSE;
+
+    gles->create_sync = (PFNEGLCREATESYNCKHRPROC)
+            eglGetProcAddress ("eglCreateSyncKHR");
+    gles->destroy_sync = (PFNEGLDESTROYSYNCKHRPROC)
+            eglGetProcAddress ("eglDestroySyncKHR");
+    gles->client_wait_sync = (PFNEGLCLIENTWAITSYNCKHRPROC)
+            eglGetProcAddress ("eglClientWaitSyncKHR");
+
+    gles->fence_sync = gles->create_sync && gles->destroy_sync &&
+                       gles->client_wait_sync;
+    return gles->fence_sync;
+}
+
+/*
+ * Returns TRUE if the buffer shows the same picture as the last one that
+ * has been uploaded: gap buffers, the same buffer pushed again or
+ * another buffer wrapping the same memory. As we keep a reference on the
+ * last buffer, its memory cannot have been written in the meantime. */
+gboolean
+gl_buffer_unchanged (GstBuffer *last, GstBuffer *buf)
+{
+    if (!last)
+        return FALSE;
+
+    if (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_GAP) || buf == last)
+        return TRUE;
+
+#if GST_CHECK_VERSION(1, 0, 0)
+    return gst_buffer_n_memory (buf) == 1 && gst_buffer_n_memory (last) == 1 &&
+           gst_buffer_peek_memory (buf, 0) == gst_buffer_peek_memory (last, 0) &&
+           gst_buffer_get_size (buf) == gst_buffer_get_size (last);
+#else
+    return GST_BUFFER_DATA (buf) == GST_BUFFER_DATA (last) &&
+           GST_BUFFER_SIZE (buf) == GST_BUFFER_SIZE (last);
+#endif
+}
+
+/* returns the GL_UNPACK_ALIGNMENT that pads rows of width bytes to
+ * stride, 0 if there is none */
+static gint
+gl_unpack_alignment (gint width, gint stride)
+{
+    gint align;
+
+    for (align = 8; align >= 1; align /= 2) {
+        if (stride == ((width + align - 1) & ~(align - 1)))
+            return align;
+    }
+
+    return 0;
+}
+
+/*
+ * Uploads a rectangle of a plane with bpp bytes per texel into the bound
+ * texture. Without EXT_unpack_subimage, GL only knows the row padding
+ * implied by GL_UNPACK_ALIGNMENT, so whole rows are uploaded and strides
+ * it cannot express are uploaded row by row. */
+static void
+gl_load_rect (GstGLESSink *sink, GLenum format, gint bpp,
+              const guint8 *plane, gint stride, gint plane_width,
+              gint x, gint y, gint width, gint height)
+{
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    gint align = gl_unpack_alignment (plane_width * bpp, stride);
+    gint row;
+
+    if (align && (!gles->unpack_subimage ||
+                  (x == 0 && width == plane_width))) {
+        glPixelStorei (GL_UNPACK_ALIGNMENT, align);
+        glTexSubImage2D (GL_TEXTURE_2D, 0, 0, y, plane_width, height,
+                         format, GL_UNSIGNED_BYTE,
+                         plane + y * stride);
+    } else if (gles->unpack_subimage && stride % bpp == 0) {
+        glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+        glPixelStorei (GL_UNPACK_ROW_LENGTH_EXT, stride / bpp);
+        glTexSubImage2D (GL_TEXTURE_2D, 0, x, y, width, height,
+                         format, GL_UNSIGNED_BYTE,
+                         plane + y * stride + x * bpp);
+        glPixelStorei (GL_UNPACK_ROW_LENGTH_EXT, 0);
+    } else {
+        glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+        for (row = y; row < y + height; row++)
+            glTexSubImage2D (GL_TEXTURE_2D, 0, 0, row, plane_width, 1,
+                             format, GL_UNSIGNED_BYTE,
+                             plane + row * stride);
+    }
+}
+
+/*
+ * (Re)allocates a plane texture and leaves it bound. Immutable storage
+ * cannot be respecified, so with texture storage a new texture replaces
+ * the old one. */
+static void
+gl_alloc_plane (GstGLESSink *sink, GLuint *tex, GLint internal_format,
+                GLenum format, gint width, gint height)
+{
+    if (sink->gl_thread.gles.desktop_gl.tex_storage) {
+        glDeleteTextures (1, tex);
+        glGenTextures (1, tex);
+        glBindTexture (GL_TEXTURE_2D, *tex);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        if (desktop_tex_storage (sink, internal_format, width, height))
+            return;
+    }
+
+    glTexImage2D (GL_TEXTURE_2D, 0, internal_format, width, height, 0,
+                  format, GL_UNSIGNED_BYTE, NULL);
+}
+
+/* planes of the formats we accept */
+static guint
+gl_format_planes (GstVideoFormat format)
+{
+    return format == GST_VIDEO_FORMAT_NV12 ? 2 : 3;
+}
+
+/*
+ * Returns TRUE if the frame has to be converted on the cpu before it can
+ * be uploaded: the interleaved chroma of NV12 unless it goes into an rg
+ * texture, or strides that neither GL_UNPACK_ALIGNMENT nor
+ * EXT_unpack_subimage can express and would have to be uploaded row by
+ * row. */
+static gboolean
+gl_repack_needed (GstGLESSink *sink, const GstGLESLayout *layout,
+                  gboolean nv12)
+{
+    gint width = GST_VIDEO_SINK_WIDTH (sink);
+    gint i;
+
+    if (sink->format == GST_VIDEO_FORMAT_NV12 && !nv12)
+        return TRUE;
+
+    if (sink->gl_thread.gles.unpack_subimage)
+        return FALSE;
+
+    for (i = 0; i < gl_format_planes (sink->format); i++) {
+        /* a row of interleaved chroma has as many bytes as a luma row */
+        if (!gl_unpack_alignment (i && !nv12 ? width/2 : width,
+                                  layout->stride[i]))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* offsets and strides of the planes in buf, from its video meta if it
+ * has one, otherwise the default layout of the caps */
+static void
+gl_buffer_layout (GstGLESSink *sink, GstBuffer *buf, GstGLESLayout *layout)
+{
+#if GST_CHECK_VERSION(1, 0, 0)
+    GstVideoMeta *meta = gst_buffer_get_video_meta (buf);
+    gint i;
+
+    if (meta && meta->n_planes == gl_format_planes (sink->format)) {
+        for (i = 0; i < meta->n_planes; i++) {
+            layout->offset[i] = meta->offset[i];
+            layout->stride[i] = meta->stride[i];
+        }
+        return;
+    }
+#endif
+
+    *layout = sink->layout;
+}
+
+/* uploads a complete frame, reallocating the textures if needed. with
+ * nv12 set the chroma goes into the second texture as rg texels */
+static void
+gl_load_planes (GstGLESSink *sink, GstGLESSlot *slot, const guint8 *data,
+                const GstGLESLayout *layout, gboolean nv12)
+{
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    gint width = GST_VIDEO_SINK_WIDTH (sink);
+    gint height = GST_VIDEO_SINK_HEIGHT (sink);
+    gboolean realloc = slot->width != width || slot->height != height ||
+                       slot->packed || slot->nv12 != nv12;
+    gint i;
+
+    for (i = 0; i < (nv12 ? 2 : 3); i++) {
+        gint w = i ? width/2 : width;
+        gint h = i ? height/2 : height;
+        gboolean rg = nv12 && i == 1;
+        GLenum format = rg ? GL_RG_EXT : gles->plane_format;
+
+        glActiveTexture (GL_TEXTURE0 + i);
+        glBindTexture (GL_TEXTURE_2D, slot->tex[i]);
+
+        if (realloc)
+            gl_alloc_plane (sink, &slot->tex[i],
+                            rg ? (gles->desktop ? GL_RG8_EXT : GL_RG_EXT) :
+                                 gles->plane_internal_format,
+                            format, w, h);
+
+        gl_load_rect (sink, format, rg ? 2 : 1, data + layout->offset[i],
+                      layout->stride[i], w, 0, 0, w, h);
+    }
+
+    slot->width = width;
+    slot->height = height;
+    slot->packed = FALSE;
+    slot->nv12 = nv12;
+}
+
+/* returns TRUE if the planes follow each other without gaps, so that the
+ * chroma planes continue the luma rows with two chroma rows each */
+static gboolean
+gl_layout_packed (const GstGLESLayout *layout, gint height)
+{
+    return height % 4 == 0 &&
+           layout->offset[0] == 0 &&
+           layout->stride[1] * 2 == layout->stride[0] &&
+           layout->stride[2] == layout->stride[1] &&
+           layout->offset[1] == (gsize) layout->stride[0] * height &&
+           layout->offset[2] == layout->offset[1] +
+                                (gsize) layout->stride[1] * height / 2;
+}
+
+/*
+ * Uploads the whole frame with a single call into the first texture, as
+ * a luminance image one stride wide and 1.5 times the frame height. The
+ * packed conversion shader computes the y, u and v coordinates from that
+ * layout. */
+static void
+gl_load_packed (GstGLESSink *sink, GstGLESSlot *slot, const guint8 *data,
+                const GstGLESLayout *layout)
+{
+    gint width = GST_VIDEO_SINK_WIDTH (sink);
+    gint height = GST_VIDEO_SINK_HEIGHT (sink);
+    gint tex_width = layout->stride[0];
+    gint tex_height = height * 3 / 2;
+
+    glActiveTexture (GL_TEXTURE0);
+    glBindTexture (GL_TEXTURE_2D, slot->tex[0]);
+    glPixelStorei (GL_UNPACK_ALIGNMENT,
+                   gl_unpack_alignment (tex_width, tex_width));
+
+    if (!slot->packed || slot->packed_width != tex_width ||
+        slot->width != width || slot->height != height)
+        gl_alloc_plane (sink, &slot->tex[0],
+                        sink->gl_thread.gles.plane_internal_format,
+                        sink->gl_thread.gles.plane_format,
+                        tex_width, tex_height);
+
+    glTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0, tex_width, tex_height,
+                     sink->gl_thread.gles.plane_format, GL_UNSIGNED_BYTE,
+                     data);
+
+    slot->width = width;
+    slot->height = height;
+    slot->packed = TRUE;
+    slot->nv12 = FALSE;
+    slot->packed_width = tex_width;
+}
+
+/*
+ * Compares the frame with the previous one in tiles and uploads only
+ * the bands of tiles that changed. The bounding box of all changes is
+ * kept in gles->dirty to restrict the conversion pass. */
+static void
+gl_load_dirty_tiles (GstGLESSink *sink, GstGLESSlot *slot,
+                     const guint8 *data, const GstGLESLayout *layout)
+{
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    gint width = GST_VIDEO_SINK_WIDTH (sink);
+    gint height = GST_VIDEO_SINK_HEIGHT (sink);
+    gint rows = (height + TILE_SIZE - 1) / TILE_SIZE;
+    gint cols = (width + TILE_SIZE - 1) / TILE_SIZE;
+    gint span_x[4096 / TILE_SIZE];
+    gint span_w[4096 / TILE_SIZE];
+    const guint8 *planes[3];
+    guint8 *shadows[3];
+    const gint *strides = layout->stride;
+    gint x0 = width, x1 = 0, y0 = height, y1 = 0;
+    gsize uploaded = 0;
+    gint row, col, i;
+
+    for (i = 0; i < 3; i++) {
+        planes[i] = data + layout->offset[i];
+        shadows[i] = gles->shadow + layout->offset[i];
+    }
+
+    for (row = 0; row < rows; row++) {
+        gint ty = row * TILE_SIZE;
+        gint th = MIN (TILE_SIZE, height - ty);
+        gint first = -1, last = -1;
+
+        for (col = 0; col < cols; col++) {
+            gint tx = col * TILE_SIZE;
+            gint tw = MIN (TILE_SIZE, width - tx);
+            gboolean changed;
+
+            changed = tiles_update_rect (shadows[0], planes[0], strides[0],
+                                         tx, ty, tw, th);
+            for (i = 1; i < 3; i++) {
+                changed |= tiles_update_rect (shadows[i], planes[i],
+                                              strides[i], tx/2, ty/2,
+                                              MIN (tw/2, width/2 - tx/2),
+                                              MIN (th/2, height/2 - ty/2));
+            }
+
+            if (changed) {
+                if (first < 0)
+                    first = col;
+                last = col;
+            }
+        }
+
+        span_w[row] = 0;
+        if (first < 0)
+            continue;
+
+        if (gles->unpack_subimage) {
+            span_x[row] = first * TILE_SIZE;
+            span_w[row] = MIN ((last + 1) * TILE_SIZE, width) - span_x[row];
+        } else {
+            span_x[row] = 0;
+            span_w[row] = width;
+        }
+
+        x0 = MIN (x0, span_x[row]);
+        x1 = MAX (x1, span_x[row] + span_w[row]);
+        y0 = MIN (y0, ty);
+        y1 = MAX (y1, ty + th);
+        uploaded += span_w[row] * th + 2 * (span_w[row]/2 * th/2);
+    }
+
+    for (i = 0; i < 3; i++) {
+        gint shift = i ? 1 : 0;
+
+        glActiveTexture (GL_TEXTURE0 + i);
+        glBindTexture (GL_TEXTURE_2D, slot->tex[i]);
+
+        for (row = 0; row < rows; row++) {
+            gint ty = row * TILE_SIZE;
+
+            if (!span_w[row])
+                continue;
+
+            gl_load_rect (sink, gles->plane_format, 1, planes[i],
+                          strides[i], width >> shift,
+                          span_x[row] >> shift, ty >> shift,
+                          span_w[row] >> shift,
+                          MIN (TILE_SIZE, height - ty) >> shift);
+        }
+    }
+
+    gles->dirty.x = x0;
+    gles->dirty.y = y0;
+    gles->dirty.w = MAX (x1 - x0, 0);
+    gles->dirty.h = MAX (y1 - y0, 0);
+
+    GST_OBJECT_LOCK (sink);
+    sink->stats.uploaded_bytes += uploaded;
+    sink->stats.skipped_bytes += width * height + 2 * (width/2 * height/2) -
+                                 uploaded;
+    GST_OBJECT_UNLOCK (sink);
+}
+
+void
+gl_load_texture (GstGLESSink *sink, GstGLESSlot *slot, GstBuffer *buf)
+{
+#if GST_CHECK_VERSION(1, 0, 0)
+    GstMapInfo bufmap;
+    guint8 *data;
+    gsize size;
+
+    if (G_UNLIKELY(!gst_buffer_map (buf, &bufmap, GST_MAP_READ))) {
+	GST_WARNING_OBJECT (sink, "%s: Failed to map buffer data", __func__);
+	return;
+    }
+
+    data = bufmap.data;
+    size = bufmap.size;
+#else
+    guint8 *data = GST_BUFFER_DATA (buf);
+    gsize size = GST_BUFFER_SIZE (buf);
+#endif
+
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    gint width = GST_VIDEO_SINK_WIDTH (sink);
+    gint height = GST_VIDEO_SINK_HEIGHT (sink);
+    GstGLESLayout layout;
+    /* the shadow copy only matches the textures of a single set */
+    gboolean dirty_tiles = sink->dirty_tiles &&
+                           !sink->gl_thread.uploader.running;
+    /* the tiles compare luminance planes only */
+    gboolean nv12 = sink->format == GST_VIDEO_FORMAT_NV12 &&
+                    gles->texture_rg && !dirty_tiles;
+    const guint8 *base;
+
+    gl_buffer_layout (sink, buf, &layout);
+
+    if (gl_repack_needed (sink, &layout, nv12)) {
+        GstGLESLayout in = layout;
+        guint n_threads = sink->repack_threads;
+
+        if (!n_threads)
+            n_threads = MIN (g_get_num_processors (), DEFAULT_REPACK_THREADS);
+
+        data = (guint8 *) repack_frame (&gles->repack, n_threads,
+                                        sink->format ==
+                                        GST_VIDEO_FORMAT_NV12,
+                                        width, height, data, &in, &layout,
+                                        &size);
+
+        /* the repacked copy is planar */
+        nv12 = FALSE;
+
+        GST_OBJECT_LOCK (sink);
+        sink->stats.repacked++;
+        GST_OBJECT_UNLOCK (sink);
+    }
+
+    if (dirty_tiles && gles->shadow && gles->shadow_size == size &&
+        !memcmp (&gles->shadow_layout, &layout, sizeof (layout)) &&
+        slot->width == width && slot->height == height && !slot->packed &&
+        !slot->nv12) {
+        gl_load_dirty_tiles (sink, slot, data, &layout);
+    } else {
+        /* desktop GL copies the frame into a pixel buffer, the texture
+         * uploads then read from GPU visible memory */
+        base = data;
+        if (gles->desktop && !dirty_tiles)
+            desktop_stage_frame (sink, data, size, &base);
+
+        if (gles->packed && !dirty_tiles && !nv12 &&
+            gl_layout_packed (&layout, height))
+            gl_load_packed (sink, slot, base, &layout);
+        else
+            gl_load_planes (sink, slot, base, &layout, nv12);
+
+        if (base != data)
+            desktop_unstage_frame (sink);
+
+        if (dirty_tiles) {
+            /* start over with a fresh copy of the frame */
+            if (gles->shadow_size != size) {
+                g_free (gles->shadow);
+                gles->shadow = g_malloc (size);
+                gles->shadow_size = size;
+            }
+            memcpy (gles->shadow, data, size);
+            gles->shadow_layout = layout;
+        } else if (gles->shadow) {
+            g_free (gles->shadow);
+            gles->shadow = NULL;
+            gles->shadow_size = 0;
+        }
+
+        GST_OBJECT_LOCK (sink);
+        sink->stats.uploaded_bytes += width * height +
+                                      2 * (width/2 * height/2);
+        GST_OBJECT_UNLOCK (sink);
+    }
+
+#if GST_CHECK_VERSION(1, 0, 0)
+    gst_buffer_unmap(buf, &bufmap);
+#endif
+}
+
+void
+gl_slot_fence (GstGLESSink *sink, GstGLESSlot *slot)
+{
+    GstGLESContext *gles = &sink->gl_thread.gles;
+
+    if (!gles->fence_sync)
+        return;
+
+    if (slot->fence != EGL_NO_SYNC_KHR)
+        gles->destroy_sync (gles->display, slot->fence);
+
+    slot->fence = gles->create_sync (gles->display, EGL_SYNC_FENCE_KHR,
+                                     NULL);
+    if (slot->fence == EGL_NO_SYNC_KHR)
+        GST_WARNING_OBJECT (sink, "Could not create fence: 0x%x",
+                            eglGetError ());
+
+    /* the other context waits on the fence, it must reach the GPU */
+    glFlush ();
+}
+
+/* waits up to timeout nanoseconds for the fence of the slot, releases
+ * the fence and the buffer of the slot and returns TRUE if it signalled */
+static gboolean
+gl_slot_release (GstGLESSink *sink, GstGLESSlot *slot, EGLTimeKHR timeout)
+{
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    EGLint status;
+
+    if (slot->fence != EGL_NO_SYNC_KHR) {
+        status = gles->client_wait_sync (gles->display, slot->fence, 0,
+                                         timeout);
+        if (status == EGL_TIMEOUT_EXPIRED_KHR)
+            return FALSE;
+
+        if (status == EGL_FALSE)
+            GST_WARNING_OBJECT (sink, "Could not wait for fence: 0x%x",
+                                eglGetError ());
+
+        gles->destroy_sync (gles->display, slot->fence);
+        slot->fence = EGL_NO_SYNC_KHR;
+    }
+
+    gst_buffer_replace (&slot->buf, NULL);
+    return TRUE;
+}
+
+void
+gl_slot_wait (GstGLESSink *sink, GstGLESSlot *slot)
+{
+    gl_slot_release (sink, slot, EGL_FOREVER_KHR);
+}
+
+/*
+ * Rotates through the sets of the ring, so an upload does not have to
+ * wait for the conversion of the previous frame. Dirty tile uploads
+ * depend on the textures holding the previous frame and stay on the
+ * first set. */
+GstGLESSlot *
+gl_slot_next (GstGLESSink *sink)
+{
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    GstGLESSlot *slot;
+    gint i;
+
+    if (gles->n_slots == 1 || sink->dirty_tiles)
+        return &gles->slots[0];
+
+    /* release whatever the GPU is done with */
+    for (i = 0; i < gles->n_slots; i++)
+        gl_slot_release (sink, &gles->slots[i], 0);
+
+    for (i = 0; i < gles->n_slots; i++) {
+        slot = &gles->slots[(gles->next_slot + i) % gles->n_slots];
+
+        if (slot->fence == EGL_NO_SYNC_KHR) {
+            gles->next_slot = (slot - gles->slots + 1) % gles->n_slots;
+            return slot;
+        }
+    }
+
+    /* all sets are still in use, wait for the oldest one */
+    slot = &gles->slots[gles->next_slot];
+    gles->next_slot = (gles->next_slot + 1) % gles->n_slots;
+    gl_slot_wait (sink, slot);
+
+    GST_OBJECT_LOCK (sink);
+    sink->stats.slot_waits++;
+    GST_OBJECT_UNLOCK (sink);
+
+    return slot;
+}
+
+gint
+uploader_start (GstGLESSink *sink)
+{
+    GstGLESContext *gles = &sink->gl_thread.gles;
+
+    const EGLint configAttribs[] =
+    {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE,
+        gles->desktop ? EGL_OPENGL_BIT :
+        gles->es31 ? EGL_OPENGL_ES3_BIT_KHR : EGL_OPENGL_ES2_BIT,
+        EGL_NONE
+    };
+
+    const EGLint esContextAttribs[] =
+    {
+        EGL_CONTEXT_CLIENT_VERSION, 2,
+        EGL_NONE
+    };
+
+    const EGLint surfaceAttribs[] =
+    {
+        EGL_WIDTH, 1,
+        EGL_HEIGHT, 1,
+        EGL_NONE
+    };
+
+    GstGLESUploader *up = &sink->gl_thread.uploader;
+    GError *error = NULL;
+    EGLConfig config;
+    EGLint num_configs;
+
+    if (!gles->fence_sync) {
+        GST_WARNING_OBJECT (sink, "EGL_KHR_fence_sync not available, "
+                            "uploading in the gl thread");
+        return -1;
+    }
+
+    if (!eglChooseConfig (gles->display, configAttribs, &config, 1,
+                          &num_configs) || num_configs < 1) {
+        GST_WARNING_OBJECT (sink, "No pbuffer config for the upload "
+                            "context");
+        return -1;
+    }
+
+    up->surface = eglCreatePbufferSurface (gles->display, config,
+                                           surfaceAttribs);
+    if (up->surface == EGL_NO_SURFACE) {
+        GST_WARNING_OBJECT (sink, "Could not create upload surface");
+        return -1;
+    }
+
+    up->context = eglCreateContext (gles->display, config, gles->context,
+                                    gles->desktop ?
+                                    desktop_context_attribs () :
+                                    gles->es31 ?
+                                    compute_context_attribs () :
+                                    esContextAttribs);
+    if (up->context == EGL_NO_CONTEXT) {
+        GST_WARNING_OBJECT (sink, "Could not create shared upload context");
+        uploader_stop (sink);
+        return -1;
+    }
+
+    up->running = TRUE;
+    up->handle = g_thread_try_new ("upload_thread", uploader_proc, sink,
+                                   &error);
+    if (!up->handle) {
+        GST_WARNING_OBJECT (sink, "Can't create upload thread: %s",
+                            error ? error->message : "(unknown)");
+        g_clear_error (&error);
+        up->running = FALSE;
+        uploader_stop (sink);
+        return -1;
+    }
+
+    return 0;
+}
+
+void
+uploader_stop (GstGLESSink *sink)
+{
+    GstGLESThread *thread = &sink->gl_thread;
+    GstGLESContext *gles = &thread->gles;
+    GstGLESUploader *up = &thread->uploader;
+
+    if (up->handle) {
+        g_mutex_lock (&thread->data_lock);
+        up->running = FALSE;
+        g_cond_broadcast (&thread->data_signal);
+        g_mutex_unlock (&thread->data_lock);
+
+        g_thread_join (up->handle);
+        up->handle = NULL;
+    }
+
+    if (up->context) {
+        eglDestroyContext (gles->display, up->context);
+        up->context = NULL;
+    }
+
+    if (up->surface) {
+        eglDestroySurface (gles->display, up->surface);
+        up->surface = NULL;
+    }
+}
+
+/* picks the set to upload the next frame to, a free one or the oldest
+ * one still waiting to be drawn. must be called with the data_lock held */
+static GstGLESSlot *
+uploader_get_slot (GstGLESSink *sink)
+{
+    GstGLESContext *gles = &sink->gl_thread.gles;
+    GstGLESSlot *slot = NULL;
+    gint i;
+
+    for (i = 0; i < gles->n_slots; i++) {
+        if (gles->slots[i].state == SLOT_FREE)
+            return &gles->slots[i];
+
+        if (gles->slots[i].state == SLOT_READY &&
+            (!slot || gles->slots[i].frame < slot->frame))
+            slot = &gles->slots[i];
+    }
+
+    /* replaced before the gl thread got to it */
+    if (slot)
+        GST_LOG_OBJECT (sink, "Replace frame %" G_GUINT64_FORMAT,
+                        slot->frame);
+
+    return slot;
+}
+
+/* upload thread main function */
+static gpointer
+uploader_proc (gpointer data)
+{
+    GstGLESSink *sink = GST_GLES_SINK (data);
+    GstGLESThread *thread = &sink->gl_thread;
+    GstGLESContext *gles = &thread->gles;
+    GstGLESUploader *up = &thread->uploader;
+    GstGLESSlot *slot;
+    GstBuffer *buf;
+    guint64 frame;
+    guint64 switches;
+    guint flush_count;
+    gboolean flushed;
+
+    sched_apply (GST_ELEMENT (sink), &sink->sched, "upload thread");
+
+    /* the api is bound per thread */
+    eglBindAPI (gles->desktop ? EGL_OPENGL_API : EGL_OPENGL_ES_API);
+
+    if (!eglMakeCurrent (gles->display, up->surface, up->surface,
+                         up->context)) {
+        GST_WARNING_OBJECT (sink, "Could not make upload context current, "
+                            "uploading in the gl thread");
+        g_mutex_lock (&thread->data_lock);
+        up->running = FALSE;
+        g_cond_broadcast (&thread->data_signal);
+        g_mutex_unlock (&thread->data_lock);
+        return NULL;
+    }
+
+    GST_DEBUG_OBJECT (sink, "Upload thread running");
+
+    while (up->running) {
+        g_mutex_lock (&thread->data_lock);
+        while (!thread->buf && up->running)
+            g_cond_wait (&thread->data_signal, &thread->data_lock);
+
+        buf = thread->buf;
+        thread->buf = NULL;
+        frame = thread->submitted;
+        flush_count = thread->flush_count;
+
+        slot = NULL;
+        if (buf && !gl_buffer_unchanged (up->last_buf, buf)) {
+            while (!(slot = uploader_get_slot (sink)) && up->running)
+                g_cond_wait (&thread->data_signal, &thread->data_lock);
+            if (slot)
+                slot->state = SLOT_UPLOADING;
+        }
+        g_mutex_unlock (&thread->data_lock);
+
+        if (!buf)
+            continue;
+
+        if (slot) {
+            switches = sched_involuntary_switches ();
+
+            /* the draws reading the textures have to be done */
+            gl_watch_stage (sink, &thread->upload_watch, GL_STAGE_FENCE);
+            gl_slot_wait (sink, slot);
+            gl_watch_stage (sink, &thread->upload_watch, GL_STAGE_UPLOAD);
+            gl_load_texture (sink, slot, buf);
+            gl_slot_fence (sink, slot);
+            gl_watch_stage (sink, &thread->upload_watch, GL_STAGE_IDLE);
+
+            GST_OBJECT_LOCK (sink);
+            sink->stats.upload_involuntary_switches +=
+                sched_involuntary_switches () - switches;
+            GST_OBJECT_UNLOCK (sink);
+            gst_buffer_replace (&slot->buf, buf);
+
+            /* a frame from before a flush that came during the upload
+             * must not be drawn after it */
+            g_mutex_lock (&thread->data_lock);
+            flushed = flush_count != thread->flush_count;
+            if (flushed) {
+                slot->state = SLOT_FREE;
+            } else {
+                slot->frame = frame;
+                slot->pts = GST_BUFFER_TIMESTAMP (buf);
+                slot->state = SLOT_READY;
+            }
+            g_cond_broadcast (&thread->data_signal);
+            g_mutex_unlock (&thread->data_lock);
+
+            if (flushed)
+                GST_DEBUG_OBJECT (sink, "Dropped a frame uploaded during "
+                                  "a flush");
+            gst_buffer_replace (&up->last_buf, flushed ? NULL : buf);
+        } else if (up->running) {
+            /* the last upload still holds this picture */
+            GST_OBJECT_LOCK (sink);
+            sink->stats.unchanged++;
+            GST_OBJECT_UNLOCK (sink);
+            detect_unchanged (sink, GST_BUFFER_TIMESTAMP (buf));
+            motion_unchanged (sink, GST_BUFFER_TIMESTAMP (buf));
+
+            /* the gl thread shows the picture again if the window or
+             * the crop changed, as without the upload thread */
+            gl_thread_represent (sink);
+        }
+
+        gst_buffer_unref (buf);
+
+        /* the streaming thread can go on once the frame is on the GPU */
+        g_mutex_lock (&thread->render_lock);
+        thread->completed = frame;
+        g_cond_broadcast (&thread->render_signal);
+        g_mutex_unlock (&thread->render_lock);
+    }
+
+    gst_buffer_replace (&up->last_buf, NULL);
+    gl_watch_stage (sink, &thread->upload_watch, GL_STAGE_IDLE);
+
+    glFinish ();
+    eglMakeCurrent (gles->display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                    EGL_NO_CONTEXT);
+
+    GST_DEBUG_OBJECT (sink, "Upload thread stopped");
+    return NULL;
+}
@@ -0,0 +1,144 @@
+/*
+ * GStreamer
+ * Copyright (C) 2011 Julian Scheel <julian@jusst.de>
+ * Copyright (C) 2011 Soeren Grunewald <soeren.grunewald@avionic-design.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _UPLOAD_H__
+#define _UPLOAD_H__
+
+#include <glib.h>
+#include <gst/gst.h>
+
+#include <GLES2/gl2.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+/* most texture sets the ring can hold */
+#define GST_GLES_MAX_SLOTS 8
+
+/* row alignment of the buffers we allocate, matching the largest
+ * GL_UNPACK_ALIGNMENT so planes upload in one call without
+ * EXT_unpack_subimage */
+#define GST_GLES_UNPACK_ALIGNMENT 8
+
+typedef enum _GstGLESSlotState     GstGLESSlotState;
+typedef struct _GstGLESSlot        GstGLESSlot;
+typedef struct _GstGLESUploader    GstGLESUploader;
+typedef struct _GstGLESLayout      GstGLESLayout;
+
+enum _GstGLESSlotState {
+    SLOT_FREE = 0,
+    SLOT_UPLOADING,
+    SLOT_READY,
+    SLOT_DRAWING
+};
+
+/* offsets and strides of the y, u and v planes in a buffer */
+struct _GstGLESLayout
+{
+    gsize offset[3];
+    gint stride[3];
+};
+
+struct _GstGLESSlot
+{
+    /* y, u and v plane textures */
+    GLuint tex[3];
+
+    /* size the textures have been allocated with */
+    gint width;
+    gint height;
+
+    /* set if the frame went to the first texture as one packed image of
+     * packed_width x 1.5 height texels */
+    gboolean packed;
+    gint packed_width;
+
+    /* set if the second texture holds interleaved NV12 chroma */
+    gboolean nv12;
+
+    /* signals when the last commands using the textures have completed,
+     * EGL_NO_SYNC_KHR if there are none */
+    EGLSyncKHR fence;
+
+    /* buffer the textures were uploaded from, held until the fence has
+     * signalled */
+    GstBuffer *buf;
+
+    /* state, frame number and timestamp of the uploaded frame, protected
+     * by the data_lock of the gl thread */
+    GstGLESSlotState state;
+    guint64 frame;
+    GstClockTime pts;
+};
+
+struct _GstGLESUploader
+{
+    /* thread context */
+    GThread *handle;
+    volatile gboolean running;
+
+    /* context sharing its objects with the render context, current on
+     * a pbuffer surface in the upload thread */
+    EGLContext context;
+    EGLSurface surface;
+
+    /* last uploaded buffer, only used by the upload thread */
+    GstBuffer *last_buf;
+};
+
+struct _GstGLESSink;
+
+/* probes EGL_KHR_fence_sync and resolves its entry points, returns
+ * TRUE if fences are available */
+gboolean
+egl_init_fences (struct _GstGLESSink *sink);
+
+/* returns TRUE if buf shows the same picture as last */
+gboolean
+gl_buffer_unchanged (GstBuffer *last, GstBuffer *buf);
+
+/* uploads the planes of buf into the slot textures in the current
+ * context, using dirty tiles if enabled and possible */
+void
+gl_load_texture (struct _GstGLESSink *sink, GstGLESSlot *slot,
+                 GstBuffer *buf);
+
+/* replaces the fence of the slot with one behind the commands issued so
+ * far in the current context and flushes them */
+void
+gl_slot_fence (struct _GstGLESSink *sink, GstGLESSlot *slot);
+
+/* blocks until the fence of the slot has signalled and releases it
+ * along with the buffer of the slot */
+void
+gl_slot_wait (struct _GstGLESSink *sink, GstGLESSlot *slot);
+
+/* picks the set the gl thread uploads the next frame to, preferring
+ * sets the GPU is done with over waiting for one */
+GstGLESSlot *
+gl_slot_next (struct _GstGLESSink *sink);
+
+/* creates the shared upload context and starts the upload thread,
+ * returns 0 on success, -1 if uploads stay in the gl thread */
+gint
+uploader_start (struct _GstGLESSink *sink);
+void
+uploader_stop (struct _GstGLESSink *sink);
+#endif